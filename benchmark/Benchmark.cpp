@@ -0,0 +1,603 @@
+//=============================================================================
+//
+// Benchmark.cpp
+//
+// Times the tokenizer, parser and generators over a corpus of shaders and
+// reports the results as JSON, so that they can be compared between versions.
+//
+//=============================================================================
+
+#include "Engine/Allocator.h"
+#include "Engine/File.h"
+#include "Engine/Log.h"
+#include "Engine/String.h"
+#include "Engine/Time.h"
+
+#include "CodeWriter.h"
+#include "GLSLGenerator.h"
+#include "HLSLCompactTree.h"
+#include "HLSLGenerator.h"
+#include "HLSLParser.h"
+#include "HLSLTokenizer.h"
+#include "HLSLTree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace M4;
+
+// Version of the JSON output; increment when the meaning of a field changes.
+static const int _outputVersion = 1;
+
+typedef void (*GenerateFunction)(CodeWriter& writer);
+
+struct CorpusEntry
+{
+    const char*         name;
+    const char*         fileName;       // In the corpus directory, or NULL if generated.
+    GenerateFunction    generate;
+    const char*         entryName;      // Pixel shader entry point.
+};
+
+enum Stage
+{
+    Stage_Tokenize,
+    Stage_Parse,
+    Stage_Load,             // Read a compact tree in place, as Load does, and expand it.
+    Stage_GenerateGLSL,
+    Stage_GenerateHLSL,
+    Stage_Count
+};
+
+static const char* const _stageName[Stage_Count] =
+    {
+        "tokenize",
+        "parse",
+        "load",
+        "generateGLSL",
+        "generateHLSL",
+    };
+
+struct StageResult
+{
+    bool                succeeded;
+    int                 numIterations;
+    double              minSeconds;
+    double              meanSeconds;
+    size_t              numAllocations; // Per iteration.
+    size_t              peakBytes;
+};
+
+struct Source
+{
+    const char*         name;
+    const char*         fileName;
+    const char*         entryName;
+    char*               text;           // NULL if the file couldn't be read.
+    size_t              length;
+    bool                fromFile;
+    bool                loaded;         // Read and parsed, so every stage can run.
+    int                 numLines;
+    int                 numTokens;
+    HLSLTree*           tree;           // Parsed once for the generator stages.
+    char*               serialized;     // Compact tree for the load stage.
+    size_t              serializedSize;
+    StageResult         result[Stage_Count];
+};
+
+/** Simple deterministic random numbers so the generated shaders are always the same. */
+class Random
+{
+public:
+    explicit Random(unsigned int seed) : m_state(seed) {}
+    int Next(int range)
+    {
+        m_state = m_state * 1103515245 + 12345;
+        return static_cast<int>((m_state >> 16) % static_cast<unsigned int>(range));
+    }
+private:
+    unsigned int m_state;
+};
+
+static void WritePixelShaderHeader(CodeWriter& writer)
+{
+    writer.WriteLine(0, "float4x4  worldViewProj;");
+    writer.WriteLine(0, "float4    lightDir;");
+    writer.WriteLine(0, "sampler2D diffuseMap;");
+}
+
+/** About 10,000 lines of functions in the style of a generated uber-shader. */
+static void GenerateUberShader(CodeWriter& writer)
+{
+    static const int numFunctions = 800;
+    Random random(1);
+    WritePixelShaderHeader(writer);
+    for (int i = 0; i < numFunctions; ++i)
+    {
+        writer.WriteLine(0, "float4 func%d(float4 a, float2 uv, float k)", i);
+        writer.WriteLine(0, "{");
+        writer.WriteLine(1, "float4 r = a * k + float4(0.5, 0.25, 1.0, 2.0);");
+        for (int j = 0; j < 8; ++j)
+        {
+            switch (random.Next(5))
+            {
+            case 0:
+                writer.WriteLine(1, "if (r.x > 0.%d) { r = saturate(r); } else { r += tex2D(diffuseMap, uv); }", random.Next(1000));
+                break;
+            case 1:
+                writer.WriteLine(1, "for (int i = 0; i < 4; ++i) { r.x += sin(r.y * i); }");
+                break;
+            case 2:
+                writer.WriteLine(1, "r = lerp(r, a, dot(r.xyz, lightDir.xyz));");
+                break;
+            case 3:
+                writer.WriteLine(1, "r.xy = r.yx * uv + %d;", random.Next(10));
+                break;
+            default:
+                writer.WriteLine(1, "r = r * 0.%d + a;", random.Next(1000));
+                break;
+            }
+        }
+        writer.WriteLine(1, "return mul(worldViewProj, r);");
+        writer.WriteLine(0, "}");
+    }
+    writer.WriteLine(0, "float4 psMain(float2 uv : TEXCOORD0) : SV_TARGET0");
+    writer.WriteLine(0, "{");
+    writer.WriteLine(1, "float4 r = float4(uv, 0.0, 1.0);");
+    for (int i = 0; i < numFunctions; i += 4)
+    {
+        writer.WriteLine(1, "r = func%d(r, uv, %d.5);", i, i % 7);
+    }
+    writer.WriteLine(1, "return r;");
+    writer.WriteLine(0, "}");
+}
+
+/** Tables and expressions made up mostly of float literals. */
+static void GenerateLiteralShader(CodeWriter& writer)
+{
+    static const int numTables = 200;
+    static const int tableSize = 16;
+    Random random(2);
+    WritePixelShaderHeader(writer);
+    for (int i = 0; i < numTables; ++i)
+    {
+        writer.BeginLine(0);
+        writer.Write("const float table%d[%d] = {", i, tableSize);
+        for (int j = 0; j < tableSize; ++j)
+        {
+            // A mix of short literals and ones which use every digit.
+            writer.Write((j % 2) ? " %d.%d," : " %d.%04de-3,", random.Next(100), random.Next(10000));
+        }
+        writer.EndLine(" };");
+    }
+    writer.WriteLine(0, "float4 psMain(float2 uv : TEXCOORD0) : SV_TARGET0");
+    writer.WriteLine(0, "{");
+    writer.WriteLine(1, "float4 r = float4(uv, 0.0, 1.0);");
+    for (int i = 0; i < numTables; ++i)
+    {
+        writer.WriteLine(1, "r = r * float4(%d.%d, 0.%03d, %de-%d, 1.0) + table%d[%d] * 0.%d;",
+            random.Next(10), random.Next(10), random.Next(1000), random.Next(10), random.Next(8),
+            i, random.Next(tableSize), random.Next(100));
+    }
+    writer.WriteLine(1, "return r;");
+    writer.WriteLine(0, "}");
+}
+
+/** Deeply nested expressions and blocks. */
+static void GenerateNestedShader(CodeWriter& writer)
+{
+    static const int numStatements = 200;
+    static const int expressionDepth = 48;
+    static const int blockDepth = 24;
+    Random random(3);
+    WritePixelShaderHeader(writer);
+    writer.WriteLine(0, "float4 psMain(float2 uv : TEXCOORD0) : SV_TARGET0");
+    writer.WriteLine(0, "{");
+    writer.WriteLine(1, "float4 r = float4(uv, 0.0, 1.0);");
+    for (int i = 0; i < numStatements; ++i)
+    {
+        writer.BeginLine(1);
+        writer.Write("r.%c = ", "xyzw"[i % 4]);
+        for (int j = 0; j < expressionDepth; ++j)
+        {
+            writer.Write("(");
+        }
+        writer.Write("r.x");
+        for (int j = 0; j < expressionDepth; ++j)
+        {
+            static const char* const op[] = { " + ", " * ", " - ", " / " };
+            writer.Write("%sr.%c)", op[random.Next(4)], "xyzw"[random.Next(4)]);
+        }
+        writer.EndLine(";");
+    }
+    for (int i = 0; i < blockDepth; ++i)
+    {
+        writer.WriteLine(i + 1, "if (r.%c > %d.0)", "xyzw"[i % 4], i);
+        writer.WriteLine(i + 1, "{");
+        writer.WriteLine(i + 2, "r = saturate(r * dot(r, lightDir));");
+    }
+    for (int i = blockDepth - 1; i >= 0; --i)
+    {
+        writer.WriteLine(i + 1, "}");
+    }
+    writer.WriteLine(1, "return r;");
+    writer.WriteLine(0, "}");
+}
+
+static const CorpusEntry _corpus[] =
+    {
+        { "small",      "small.hlsl",       NULL,                   "psMain" },
+        { "lighting",   "lighting.hlsl",    NULL,                   "psMain" },
+        { "uber",       NULL,               GenerateUberShader,     "psMain" },
+        { "literals",   NULL,               GenerateLiteralShader,  "psMain" },
+        { "nested",     NULL,               GenerateNestedShader,   "psMain" },
+    };
+
+static const int _numCorpusEntries = sizeof(_corpus) / sizeof(_corpus[0]);
+
+static bool RunStage(Stage stage, Source& source, Allocator* allocator)
+{
+    switch (stage)
+    {
+    case Stage_Tokenize:
+        {
+            HLSLTokenizer tokenizer(source.fileName, source.text, source.length);
+            int numTokens = 0;
+            while (tokenizer.GetToken() != HLSLToken_EndOfStream)
+            {
+                tokenizer.Next();
+                ++numTokens;
+            }
+            source.numTokens = numTokens;
+            return true;
+        }
+    case Stage_Parse:
+        {
+            HLSLParser parser(allocator, source.fileName, source.text, source.length);
+            HLSLTree tree(allocator, HLSLTree::GetCapacityEstimate(source.length));
+            return parser.Parse(&tree);
+        }
+    case Stage_Load:
+        {
+            HLSLCompactTree compactTree(allocator);
+            if (!compactTree.DeserializeInPlace(source.serialized, source.serializedSize))
+            {
+                return false;
+            }
+            HLSLTree tree(allocator, compactTree.GetMemorySize() * 3);
+            compactTree.Expand(&tree);
+            return true;
+        }
+    case Stage_GenerateGLSL:
+        {
+            GLSLGenerator generator(allocator);
+            return generator.Generate(source.tree, GLSLGenerator::Target_FragmentShader, source.entryName);
+        }
+    case Stage_GenerateHLSL:
+        {
+            HLSLGenerator generator(allocator);
+            return generator.Generate(source.tree, HLSLGenerator::Target_PixelShader, source.entryName, false);
+        }
+    default:
+        return false;
+    }
+}
+
+/** Runs the stage repeatedly for at least minSeconds (and at least 3 times). */
+static StageResult MeasureStage(Stage stage, Source& source, double minSeconds)
+{
+    StageResult result;
+    result.succeeded        = true;
+    result.numIterations    = 0;
+    result.minSeconds       = 0;
+    result.meanSeconds      = 0;
+    result.numAllocations   = 0;
+    result.peakBytes        = 0;
+
+    HeapAllocator allocator;
+    double totalSeconds = 0;
+    while (result.numIterations < 3 || totalSeconds < minSeconds)
+    {
+        allocator.ResetStats();
+        uint64_t start = Time_GetNanoseconds();
+        if (!RunStage(stage, source, &allocator))
+        {
+            Log_Error("Stage '%s' failed for '%s'", _stageName[stage], source.name);
+            result.succeeded = false;
+            break;
+        }
+        double seconds = (Time_GetNanoseconds() - start) * 1e-9;
+
+        const AllocatorStats& stats = allocator.GetStats();
+        result.numAllocations = stats.numAllocations;
+        if (stats.peakBytesAllocated > result.peakBytes)
+        {
+            result.peakBytes = stats.peakBytesAllocated;
+        }
+        if (result.numIterations == 0 || seconds < result.minSeconds)
+        {
+            result.minSeconds = seconds;
+        }
+        totalSeconds += seconds;
+        ++result.numIterations;
+    }
+    if (result.numIterations > 0)
+    {
+        result.meanSeconds = totalSeconds / result.numIterations;
+    }
+    return result;
+}
+
+static int CountLines(const char* text, size_t length)
+{
+    int numLines = (length > 0) ? 1 : 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (text[i] == '\n' && i + 1 < length)
+        {
+            ++numLines;
+        }
+    }
+    return numLines;
+}
+
+static bool LoadSource(Source& source, const CorpusEntry& entry, const char* corpusDirectoryName, Allocator* allocator)
+{
+    source.name             = entry.name;
+    source.fileName         = (entry.fileName != NULL) ? entry.fileName : entry.name;
+    source.entryName        = entry.entryName;
+    source.text             = NULL;
+    source.length           = 0;
+    source.fromFile         = (entry.fileName != NULL);
+    source.numLines         = 0;
+    source.numTokens        = 0;
+    source.tree             = NULL;
+    source.serialized       = NULL;
+    source.serializedSize   = 0;
+
+    if (source.fromFile)
+    {
+        char fileName[1024];
+        int count = String_Printf(fileName, sizeof(fileName), "%s/%s", corpusDirectoryName, entry.fileName);
+        if (count < 0 || count >= static_cast<int>(sizeof(fileName)))
+        {
+            Log_Error("Corpus directory name '%s' is too long", corpusDirectoryName);
+            return false;
+        }
+        source.text = File_Read(allocator, fileName, source.length);
+        if (source.text == NULL)
+        {
+            Log_Error("Couldn't read '%s'", fileName);
+            return false;
+        }
+    }
+    else
+    {
+        CodeWriter writer(allocator);
+        entry.generate(writer);
+        const char* text = writer.GetResult();
+        source.length = strlen(text);
+        source.text   = static_cast<char*>(allocator->Allocate(source.length + 1, 1));
+        memcpy(source.text, text, source.length + 1);
+    }
+    source.numLines = CountLines(source.text, source.length);
+
+    // The generators and the load stage start from a tree which is parsed once.
+    HLSLParser parser(allocator, source.fileName, source.text, source.length);
+    source.tree = new (allocator->Allocate(sizeof(HLSLTree), AlignOf<HLSLTree>::value))
+        HLSLTree(allocator, HLSLTree::GetCapacityEstimate(source.length));
+    if (!parser.Parse(source.tree))
+    {
+        Log_Error("Parsing '%s' failed", source.name);
+        return false;
+    }
+    source.tree->Freeze();
+
+    HLSLCompactTree compactTree(allocator);
+    compactTree.Build(source.tree);
+    source.serializedSize = compactTree.GetSerializedSize();
+    source.serialized = static_cast<char*>(allocator->Allocate(source.serializedSize));
+    compactTree.Serialize(source.serialized);
+
+    return true;
+}
+
+static void FreeSource(Source& source, Allocator* allocator)
+{
+    allocator->Delete(source.tree);
+    if (source.serialized != NULL)
+    {
+        allocator->Free(source.serialized, source.serializedSize);
+    }
+    if (source.fromFile)
+    {
+        File_Free(allocator, source.text, source.length);
+    }
+    else if (source.text != NULL)
+    {
+        allocator->Free(source.text, source.length + 1);
+    }
+}
+
+static void WriteResults(FILE* file, const Source sources[], int numSources)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"version\": %d,\n", _outputVersion);
+    fprintf(file, "  \"results\": [\n");
+    for (int i = 0; i < numSources; ++i)
+    {
+        const Source& source = sources[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", source.name);
+        fprintf(file, "      \"loaded\": %s,\n", source.loaded ? "true" : "false");
+        fprintf(file, "      \"bytes\": %lu,\n", static_cast<unsigned long>(source.length));
+        fprintf(file, "      \"lines\": %d,\n", source.numLines);
+        fprintf(file, "      \"tokens\": %d,\n", source.numTokens);
+        fprintf(file, "      \"serializedBytes\": %lu,\n", static_cast<unsigned long>(source.serializedSize));
+
+        // Throughput is always relative to the size of the source, so that the
+        // stages can be compared with each other.
+        fprintf(file, "      \"stages\": {\n");
+        for (int stage = 0; stage < Stage_Count; ++stage)
+        {
+            const StageResult& result = source.result[stage];
+            double seconds = (result.minSeconds > 0) ? result.minSeconds : 1e-9;
+            fprintf(file, "        \"%s\": {\n", _stageName[stage]);
+            fprintf(file, "          \"succeeded\": %s,\n", result.succeeded ? "true" : "false");
+            fprintf(file, "          \"iterations\": %d,\n", result.numIterations);
+            fprintf(file, "          \"minSeconds\": %.6g,\n", result.minSeconds);
+            fprintf(file, "          \"meanSeconds\": %.6g,\n", result.meanSeconds);
+            fprintf(file, "          \"megabytesPerSecond\": %.6g,\n", source.length / seconds * 1e-6);
+            fprintf(file, "          \"tokensPerSecond\": %.6g,\n", source.numTokens / seconds);
+            fprintf(file, "          \"allocations\": %lu,\n", static_cast<unsigned long>(result.numAllocations));
+            fprintf(file, "          \"peakBytes\": %lu\n", static_cast<unsigned long>(result.peakBytes));
+            fprintf(file, "        }%s\n", (stage + 1 < Stage_Count) ? "," : "");
+        }
+        fprintf(file, "      },\n");
+
+        // How much faster loading a serialized tree is than parsing the source.
+        const StageResult& parse = source.result[Stage_Parse];
+        const StageResult& load  = source.result[Stage_Load];
+        double speedup = (parse.succeeded && load.succeeded && load.minSeconds > 0) ? parse.minSeconds / load.minSeconds : 0;
+        fprintf(file, "      \"loadSpeedup\": %.3f\n", speedup);
+        fprintf(file, "    }%s\n", (i + 1 < numSources) ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+}
+
+struct FloatCase
+{
+    float               value;
+    const char*         text;
+};
+
+/** Literals which String_FormatFloat has formatted with more digits than needed. */
+static const FloatCase _floatCases[] =
+    {
+        { 0.1f,             "0.1" },
+        { 9.999996e+35f,    "9.999996e+35" },   // Rounds up to the next power of ten with fewer digits.
+        { 1e-45f,           "1e-45" },          // Smallest denormal.
+        { 1.26217745e-29f,  "1.2621775e-29" },  // 2^-96, only the decimal above the nearest one round trips.
+        { 1.17549435e-38f,  "1.1754944e-38" },  // Smallest normal.
+        { 3.40282347e+38f,  "3.4028235e+38" },  // Largest.
+    };
+
+/** Checks the formatting of float literals, since the generator timings are
+only comparable if the output is the same. */
+static bool CheckFloatFormatting()
+{
+    bool succeeded = true;
+    for (int i = 0; i < static_cast<int>(sizeof(_floatCases) / sizeof(_floatCases[0])); ++i)
+    {
+        char text[32];
+        String_FormatFloat(text, sizeof(text), _floatCases[i].value);
+        if (!String_Equal(text, _floatCases[i].text))
+        {
+            Log_Error("Formatted %s as '%s'", _floatCases[i].text, text);
+            succeeded = false;
+        }
+    }
+    return succeeded;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "usage: hlslbenchmark [-h] [-corpus DIRECTORY] [-time SECONDS] [-o FILENAME]\n"
+        "\n"
+        "Times the tokenizer, parser and generators and writes the results as JSON.\n"
+        "\n"
+        "optional arguments:\n"
+        " -h, --help  show this help message and exit\n"
+        " -corpus     directory containing the bundled shaders (default benchmark/corpus)\n"
+        " -time       minimum time to run each stage for, in seconds (default 0.25)\n"
+        " -o          write the results to FILENAME instead of stdout\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* corpusDirectoryName = "benchmark/corpus";
+    const char* outputFileName = NULL;
+    double minSeconds = 0.25;
+
+    for (int argn = 1; argn < argc; ++argn)
+    {
+        const char* const arg = argv[argn];
+        if (String_Equal(arg, "-h") || String_Equal(arg, "--help"))
+        {
+            PrintUsage();
+            return 0;
+        }
+        else if (String_Equal(arg, "-corpus") && argn + 1 < argc)
+        {
+            corpusDirectoryName = argv[++argn];
+        }
+        else if (String_Equal(arg, "-time") && argn + 1 < argc)
+        {
+            minSeconds = atof(argv[++argn]);
+        }
+        else if (String_Equal(arg, "-o") && argn + 1 < argc)
+        {
+            outputFileName = argv[++argn];
+        }
+        else
+        {
+            Log_Error("Unexpected argument '%s'", arg);
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    HeapAllocator allocator;
+    Source sources[_numCorpusEntries];
+    bool succeeded = CheckFloatFormatting();
+
+    for (int i = 0; i < _numCorpusEntries; ++i)
+    {
+        Source& source = sources[i];
+        source.loaded = LoadSource(source, _corpus[i], corpusDirectoryName, &allocator);
+        for (int stage = 0; stage < Stage_Count; ++stage)
+        {
+            // A source which doesn't parse can still be tokenized, but one which
+            // couldn't be read is only reported.
+            StageResult& result = source.result[stage];
+            if (source.loaded || (stage == Stage_Tokenize && source.text != NULL))
+            {
+                result = MeasureStage(static_cast<Stage>(stage), source, minSeconds);
+            }
+            else
+            {
+                memset(&result, 0, sizeof(result));
+            }
+            succeeded &= result.succeeded;
+        }
+    }
+
+    FILE* file = stdout;
+    if (outputFileName != NULL)
+    {
+        file = fopen(outputFileName, "w");
+        if (file == NULL)
+        {
+            Log_Error("Couldn't write '%s'", outputFileName);
+            succeeded = false;
+        }
+    }
+    if (file != NULL)
+    {
+        WriteResults(file, sources, _numCorpusEntries);
+        if (file != stdout)
+        {
+            fclose(file);
+        }
+    }
+
+    for (int i = 0; i < _numCorpusEntries; ++i)
+    {
+        FreeSource(sources[i], &allocator);
+    }
+
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Forward lit surface with normal mapping, several lights, fog and a shadow map.
+
+struct VS_INPUT
+{
+    float4 position : POSITION;
+    float2 texCoord : TEXCOORD0;
+    float3 normal   : NORMAL;
+    float3 tangent  : TANGENT;
+    float3 binormal : BINORMAL;
+};
+
+struct VS_OUTPUT
+{
+    float4 position      : SV_POSITION;
+    float2 texCoord      : TEXCOORD0;
+    float3 worldPosition : TEXCOORD1;
+    float3 normal        : TEXCOORD2;
+    float3 tangent       : TEXCOORD3;
+    float3 binormal      : TEXCOORD4;
+    float4 shadowCoord   : TEXCOORD5;
+};
+
+cbuffer Camera : register(b0)
+{
+    float4x4 viewProj;
+    float3   cameraPosition;
+    float    time;
+};
+
+cbuffer Object : register(b1)
+{
+    float4x4 world;
+    float3x3 normalMatrix;
+    float4x4 shadowMatrix;
+};
+
+cbuffer Lights : register(b2)
+{
+    float4 lightPosition[4];
+    float4 lightColor[4];
+    float4 ambientColor;
+    float4 fogColor;
+    float  fogDensity;
+    int    numLights;
+};
+
+sampler2D   albedoMap   : register(s0);
+sampler2D   normalMap   : register(s1);
+sampler2D   specularMap : register(s2);
+sampler2D   shadowMap   : register(s3);
+samplerCUBE reflectionMap;
+
+const float shadowOffsets[4] = { -0.5, 0.5, -1.5, 1.5 };
+
+float3 UnpackNormal(float4 packed)
+{
+    float3 normal;
+    normal.xy = packed.ag * 2.0 - 1.0;
+    normal.z  = sqrt(1.0 - saturate(dot(normal.xy, normal.xy)));
+    return normal;
+}
+
+float Attenuate(float distance, float radius)
+{
+    float falloff = saturate(1.0 - (distance * distance) / (radius * radius));
+    return falloff * falloff / (distance * distance + 1.0);
+}
+
+float SampleShadow(float4 shadowCoord)
+{
+    float3 coord = shadowCoord.xyz / shadowCoord.w;
+    float lit = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        float2 offset = float2(shadowOffsets[i], shadowOffsets[3 - i]) / 1024.0;
+        float depth = tex2D(shadowMap, coord.xy + offset).r;
+        lit += (coord.z - 0.0015 <= depth) ? 0.25 : 0.0;
+    }
+    return lit;
+}
+
+float3 Specular(float3 normal, float3 lightDirection, float3 viewDirection, float power)
+{
+    float3 halfVector = normalize(lightDirection + viewDirection);
+    float  amount = pow(saturate(dot(normal, halfVector)), power);
+    return amount * (power + 8.0) / 25.132741;
+}
+
+VS_OUTPUT vsMain(VS_INPUT input)
+{
+    VS_OUTPUT output;
+    float4 worldPosition = mul(input.position, world);
+    output.position      = mul(worldPosition, viewProj);
+    output.worldPosition = worldPosition.xyz;
+    output.texCoord      = input.texCoord;
+    output.normal        = normalize(mul(input.normal, normalMatrix));
+    output.tangent       = normalize(mul(input.tangent, normalMatrix));
+    output.binormal      = normalize(mul(input.binormal, normalMatrix));
+    output.shadowCoord   = mul(worldPosition, shadowMatrix);
+    return output;
+}
+
+float4 psMain(VS_OUTPUT input) : SV_TARGET0
+{
+    float4 albedo   = tex2D(albedoMap, input.texCoord);
+    float4 specular = tex2D(specularMap, input.texCoord);
+    float3 tangentNormal = UnpackNormal(tex2D(normalMap, input.texCoord));
+
+    float3 normal = normalize(tangentNormal.x * input.tangent +
+                              tangentNormal.y * input.binormal +
+                              tangentNormal.z * input.normal);
+
+    float3 viewDirection = normalize(cameraPosition - input.worldPosition);
+    float  shadow = SampleShadow(input.shadowCoord);
+
+    float3 diffuseLight  = ambientColor.rgb;
+    float3 specularLight = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i >= numLights)
+        {
+            break;
+        }
+        float3 toLight  = lightPosition[i].xyz - input.worldPosition;
+        float  distance = length(toLight);
+        float3 lightDirection = toLight / distance;
+        float  attenuation = Attenuate(distance, lightPosition[i].w);
+        if (i == 0)
+        {
+            attenuation *= shadow;
+        }
+        float  lambert = saturate(dot(normal, lightDirection));
+        diffuseLight  += lightColor[i].rgb * lambert * attenuation;
+        specularLight += lightColor[i].rgb * Specular(normal, lightDirection, viewDirection, specular.a * 255.0) * attenuation;
+    }
+
+    float3 reflection = texCUBE(reflectionMap, reflect(-viewDirection, normal)).rgb;
+    float  fresnel = pow(1.0 - saturate(dot(normal, viewDirection)), 5.0);
+
+    float3 color = albedo.rgb * diffuseLight + specular.rgb * (specularLight + reflection * fresnel);
+
+    float fogDistance = length(input.worldPosition - cameraPosition);
+    float fog = 1.0 / (1.0 + fogDistance * fogDensity);
+    color = lerp(fogColor.rgb, color, saturate(fog));
+
+    clip(albedo.a - 0.5);
+    return float4(color, albedo.a);
+}
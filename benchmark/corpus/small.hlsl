@@ -0,0 +1,38 @@
+// Textured, vertex lit surface.
+
+struct VS_INPUT
+{
+    float4 position : POSITION;
+    float2 texCoord : TEXCOORD0;
+    float3 normal   : NORMAL;
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;
+    float2 texCoord : TEXCOORD0;
+    float3 color    : TEXCOORD1;
+};
+
+float4x4  worldViewProj;
+float3x3  normalMatrix;
+float3    lightDir;
+float4    tint;
+sampler2D diffuseMap;
+
+VS_OUTPUT vsMain(VS_INPUT input)
+{
+    VS_OUTPUT output;
+    output.position = mul(input.position, worldViewProj);
+    output.texCoord = input.texCoord;
+    float3 normal   = normalize(mul(input.normal, normalMatrix));
+    output.color    = saturate(dot(normal, -lightDir)) * tint.rgb + 0.1;
+    return output;
+}
+
+float4 psMain(VS_OUTPUT input) : SV_TARGET0
+{
+    float4 color = tex2D(diffuseMap, input.texCoord);
+    color.rgb *= input.color;
+    return color;
+}
@@ -6,6 +6,18 @@ solution "HLSLParser"
         kind "ConsoleApp"
         language "C++"
         files { "src/**.h", "src/**.cpp" }
+
+    -- Times the tokenizer, parser and generators; see benchmark/Benchmark.cpp.
+    project "HLSLParserBenchmark"
+        kind "ConsoleApp"
+        language "C++"
+        targetname "hlslbenchmark"
+        includedirs { "src" }
+        files { "src/**.h", "src/**.cpp", "benchmark/**.cpp" }
+        excludes { "src/Main.cpp" }
+
+    -- The configurations apply to every project in the solution.
+    solution "HLSLParser"
  
     configuration "Debug"
         targetdir "bin/debug"
@@ -15,4 +27,7 @@ solution "HLSLParser"
     configuration "Release"
         targetdir "bin/release"
         defines { "NDEBUG" }
-        flags { "Optimize" }    
\ No newline at end of file
+        flags { "Optimize" }
+
+    configuration "linux"
+        links { "pthread" }
@@ -0,0 +1,374 @@
+#include "Engine/Allocator.h"
+#include "Engine/File.h"
+#include "Engine/Log.h"
+#include "Engine/String.h"
+#include "Engine/Trace.h"
+
+#include "BatchCompiler.h"
+#include "HLSLParser.h"
+#include "HLSLTree.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace M4
+{
+
+static bool GetIsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+BatchCompiler::BatchCompiler(Allocator* allocator) :
+    m_jobs(allocator),
+    m_sources(allocator),
+    m_fileNames(allocator),
+    m_sourceIndex(allocator),
+    m_manifests(allocator),
+    m_manifestLengths(allocator)
+{
+    m_allocator = allocator;
+    m_trace     = NULL;
+    m_phase     = Phase_Parse;
+    m_numItems  = 0;
+    m_nextItem  = 0;
+}
+
+BatchCompiler::~BatchCompiler()
+{
+    for (int i = 0; i < m_sources.GetSize(); ++i)
+    {
+        // The tree is destroyed before the arena holding it.
+        m_sources[i].allocator->Delete(m_sources[i].tree);
+        m_allocator->Delete(m_sources[i].allocator);
+    }
+    for (int i = 0; i < m_manifests.GetSize(); ++i)
+    {
+        File_Free(m_allocator, m_manifests[i], m_manifestLengths[i]);
+    }
+}
+
+bool BatchCompiler::LoadManifest(const char* fileName)
+{
+    size_t length = 0;
+    char* manifest = File_Read(m_allocator, fileName, length);
+    if (manifest == NULL)
+    {
+        Log_Error("Couldn't read manifest '%s'", fileName);
+        return false;
+    }
+
+    // The jobs point into the manifest, so it's kept until we're destroyed.
+    m_manifests.PushBack(manifest);
+    m_manifestLengths.PushBack(length);
+
+    bool result = true;
+    int  lineNumber = 0;
+
+    char* line = manifest;
+    while (*line != 0)
+    {
+        ++lineNumber;
+
+        char* end = line;
+        while (*end != 0 && *end != '\n')
+        {
+            ++end;
+        }
+        char* next = (*end == 0) ? end : end + 1;
+        *end = 0;
+
+        // Split the line into words in place.
+        const char* word[5];
+        int numWords = 0;
+        char* c = line;
+        while (true)
+        {
+            while (GetIsSpace(*c))
+            {
+                ++c;
+            }
+            if (*c == 0 || *c == '#')
+            {
+                break;
+            }
+            if (numWords < 5)
+            {
+                word[numWords] = c;
+            }
+            ++numWords;
+            while (*c != 0 && !GetIsSpace(*c))
+            {
+                ++c;
+            }
+            if (*c != 0)
+            {
+                *c++ = 0;
+            }
+        }
+
+        if (numWords > 0)
+        {
+            GLSLGenerator::Target target = GLSLGenerator::Target_FragmentShader;
+            int firstWord = 0;
+            if (String_Equal(word[0], "-fs"))
+            {
+                firstWord = 1;
+            }
+            else if (String_Equal(word[0], "-vs"))
+            {
+                target    = GLSLGenerator::Target_VertexShader;
+                firstWord = 1;
+            }
+
+            if (numWords - firstWord != 3)
+            {
+                Log_Error("%s(%d) : Expected [-fs | -vs] FILENAME ENTRYNAME OUTPUTNAME", fileName, lineNumber);
+                result = false;
+            }
+            else
+            {
+                AddJob(word[firstWord], word[firstWord + 1], target, word[firstWord + 2]);
+            }
+        }
+
+        line = next;
+    }
+
+    return result;
+}
+
+void BatchCompiler::AddJob(const char* fileName, const char* entryName, GLSLGenerator::Target target, const char* outputFileName)
+{
+    fileName = m_fileNames.AddString(fileName);
+
+    const int* sourceIndex = m_sourceIndex.Find(fileName);
+    int source = (sourceIndex != NULL) ? *sourceIndex : m_sources.GetSize();
+    if (sourceIndex == NULL)
+    {
+        Source& newSource = m_sources.PushBackNew();
+        newSource.fileName  = fileName;
+        newSource.allocator = NULL;
+        newSource.tree      = NULL;
+        m_sourceIndex.Insert(fileName, source);
+    }
+
+    BatchJob& job = m_jobs.PushBackNew();
+    job.fileName        = fileName;
+    job.source          = source;
+    job.entryName       = entryName;
+    job.target          = target;
+    job.outputFileName  = outputFileName;
+    job.succeeded       = false;
+}
+
+int BatchCompiler::Run(int numThreads)
+{
+    if (numThreads <= 0)
+    {
+        numThreads = Thread_GetNumProcessors();
+    }
+
+    // The allocators aren't thread safe, so create the arenas for the trees up front.
+    for (int i = 0; i < m_sources.GetSize(); ++i)
+    {
+        if (m_sources[i].allocator == NULL)
+        {
+            m_sources[i].allocator = m_allocator->New<ArenaAllocator>();
+        }
+    }
+
+    // Parse each file once, then generate code for each entry point from the
+    // shared trees.
+    RunPhase(Phase_Parse, m_sources.GetSize(), numThreads);
+    RunPhase(Phase_Generate, m_jobs.GetSize(), numThreads);
+
+    int numFailed = 0;
+    for (int i = 0; i < m_jobs.GetSize(); ++i)
+    {
+        if (!m_jobs[i].succeeded)
+        {
+            ++numFailed;
+        }
+    }
+    return numFailed;
+}
+
+void BatchCompiler::SetTrace(TraceWriter* trace)
+{
+    m_trace = trace;
+}
+
+int BatchCompiler::GetNumJobs() const
+{
+    return m_jobs.GetSize();
+}
+
+const BatchJob& BatchCompiler::GetJob(int index) const
+{
+    return m_jobs[index];
+}
+
+void BatchCompiler::RunPhase(Phase phase, int numItems, int numThreads)
+{
+    if (numThreads > numItems)
+    {
+        numThreads = numItems;
+    }
+
+    TraceScope scope(m_trace, (phase == Phase_Parse) ? "parse files" : "generate jobs");
+
+    m_phase    = phase;
+    m_numItems = numItems;
+    m_nextItem = 0;
+
+    // The calling thread runs items too, so start one fewer thread.
+    Array<Thread*> threads(m_allocator);
+    for (int i = 1; i < numThreads; ++i)
+    {
+        Thread* thread = m_allocator->New<Thread>();
+        if (!thread->Start(RunWorker, this))
+        {
+            m_allocator->Delete(thread);
+            break;
+        }
+        threads.PushBack(thread);
+    }
+
+    RunItems();
+
+    for (int i = 0; i < threads.GetSize(); ++i)
+    {
+        threads[i]->Join();
+        m_allocator->Delete(threads[i]);
+    }
+}
+
+void BatchCompiler::RunWorker(void* compiler)
+{
+    BatchCompiler* self = static_cast<BatchCompiler*>(compiler);
+    if (self->m_trace != NULL)
+    {
+        self->m_trace->SetThreadName("batch worker");
+    }
+    self->RunItems();
+}
+
+void BatchCompiler::RunItems()
+{
+    // Everything an item allocates while it's processed is released at once
+    // when it's finished, and the memory is reused for the next one.
+    ArenaAllocator allocator;
+
+    // The items are taken one at a time from a shared index, which keeps the
+    // threads busy even when the shaders vary a lot in size.
+    while (true)
+    {
+        m_mutex.Lock();
+        int index = m_nextItem++;
+        m_mutex.Unlock();
+
+        if (index >= m_numItems)
+        {
+            break;
+        }
+
+        if (m_phase == Phase_Parse)
+        {
+            ParseSource(m_sources[index], &allocator);
+        }
+        else
+        {
+            BatchJob& job = m_jobs[index];
+            job.succeeded = GenerateJob(job, &allocator);
+        }
+        allocator.Reset();
+    }
+}
+
+bool BatchCompiler::ParseSource(Source& source, Allocator* allocator)
+{
+    FileView view;
+    bool read = false;
+    {
+        TraceScope scope(m_trace, "read");
+        scope.AddArg("file", source.fileName);
+        read = File_Map(allocator, source.fileName, view);
+    }
+    if (!read)
+    {
+        Log_Error("Couldn't read '%s'", source.fileName);
+        return false;
+    }
+
+    // The file is parsed once for all of its entry points, so the span only
+    // names the file.
+    TraceScope scope(m_trace, "parse");
+    scope.AddArg("file", source.fileName);
+
+    // The tree outlives the parser and the file contents, so it's allocated
+    // from the source's own arena.
+    HLSLParser parser(allocator, source.fileName, view.contents, view.length);
+    HLSLTree* tree = new (source.allocator->Allocate(sizeof(HLSLTree), AlignOf<HLSLTree>::value))
+        HLSLTree(source.allocator, HLSLTree::GetCapacityEstimate(view.length));
+    bool parsed = parser.Parse(tree);
+
+    // The tree doesn't refer to the source, so it can be released right away.
+    File_Unmap(allocator, view);
+
+    if (!parsed)
+    {
+        Log_Error("Parsing '%s' failed", source.fileName);
+        source.allocator->Delete(tree);
+        return false;
+    }
+
+    tree->Freeze();
+    source.tree = tree;
+    return true;
+}
+
+bool BatchCompiler::GenerateJob(const BatchJob& job, Allocator* allocator)
+{
+    const HLSLTree* tree = m_sources[job.source].tree;
+    if (tree == NULL)
+    {
+        // The error was reported when the file was parsed.
+        return false;
+    }
+
+    // Writing the output is included in the span, since it's streamed.
+    TraceScope scope(m_trace, "generate");
+    scope.AddArg("file", job.fileName);
+    scope.AddArg("entry", job.entryName);
+    scope.AddArg("target", (job.target == GLSLGenerator::Target_VertexShader) ? "vs" : "fs");
+    scope.AddArg("output", job.outputFileName);
+
+    // The output is streamed to the file rather than built up in memory, so
+    // the file is removed if anything goes wrong.
+    FILE* file = fopen(job.outputFileName, "wb");
+    if (file == NULL)
+    {
+        Log_Error("Couldn't write '%s'", job.outputFileName);
+        return false;
+    }
+
+    FileCodeSink sink(file);
+    GLSLGenerator generator(allocator);
+    generator.SetSink(&sink);
+    bool result = generator.Generate(tree, job.target, job.entryName);
+    if (fclose(file) != 0 && result)
+    {
+        Log_Error("Couldn't write '%s'", job.outputFileName);
+        result = false;
+    }
+    if (!result)
+    {
+        Log_Error("Generating '%s' from '%s' failed", job.entryName, job.fileName);
+        File_Delete(job.outputFileName);
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,116 @@
+#ifndef BATCH_COMPILER_H
+#define BATCH_COMPILER_H
+
+#include "Engine/Array.h"
+#include "Engine/HashMap.h"
+#include "Engine/StringPool.h"
+#include "Engine/Thread.h"
+
+#include "GLSLGenerator.h"
+
+namespace M4
+{
+
+class Allocator;
+class ArenaAllocator;
+class HLSLTree;
+class TraceWriter;
+
+struct BatchJob
+{
+    const char*             fileName;       // Interned, so jobs with the same file share a source.
+    int                     source;
+    const char*             entryName;
+    GLSLGenerator::Target   target;
+    const char*             outputFileName;
+    bool                    succeeded;
+};
+
+/**
+ * Translates a list of shaders to GLSL using a pool of threads. Each file is
+ * parsed once into a frozen tree, then the jobs generate code from the trees.
+ * Each thread has its own allocator and each job its own generator, so the jobs
+ * don't share any mutable state.
+ */
+class BatchCompiler
+{
+
+public:
+
+    explicit BatchCompiler(Allocator* allocator);
+    ~BatchCompiler();
+
+    /**
+     * Adds the jobs listed in a manifest file. Each line has the form:
+     *
+     *   [-fs | -vs] FILENAME ENTRYNAME OUTPUTNAME
+     *
+     * Blank lines and lines starting with # are ignored. Returns false if there
+     * was an error.
+     */
+    bool LoadManifest(const char* fileName);
+
+    /** The entry and output names must remain valid until the jobs have been run. */
+    void AddJob(const char* fileName, const char* entryName, GLSLGenerator::Target target, const char* outputFileName);
+
+    /**
+     * Runs all of the jobs. If numThreads is 0 one thread is used per processor.
+     * Returns the number of jobs which failed.
+     */
+    int Run(int numThreads);
+
+    /** Records the reading, parsing and generation of each job in the trace,
+    which is optional. */
+    void SetTrace(TraceWriter* trace);
+
+    int GetNumJobs() const;
+    const BatchJob& GetJob(int index) const;
+
+private:
+
+    struct Source
+    {
+        const char*         fileName;
+        ArenaAllocator*     allocator;      // Holds the tree.
+        HLSLTree*           tree;           // NULL if the file couldn't be parsed.
+    };
+
+    enum Phase
+    {
+        Phase_Parse,
+        Phase_Generate,
+    };
+
+    /** Runs the phase for every source or job on numThreads threads. */
+    void RunPhase(Phase phase, int numItems, int numThreads);
+
+    static void RunWorker(void* compiler);
+    void RunItems();
+    bool ParseSource(Source& source, Allocator* allocator);
+    bool GenerateJob(const BatchJob& job, Allocator* allocator);
+
+    // Not copyable.
+    BatchCompiler(const BatchCompiler&);
+    BatchCompiler& operator=(const BatchCompiler&);
+
+private:
+
+    Allocator*      m_allocator;
+    Array<BatchJob> m_jobs;
+    Array<Source>   m_sources;
+    StringPool      m_fileNames;
+    HashMap<const char*, int> m_sourceIndex;    // Keyed by interned file name.
+    Array<char*>    m_manifests;
+    Array<size_t>   m_manifestLengths;
+    TraceWriter*    m_trace;
+
+    Mutex           m_mutex;
+    Phase           m_phase;
+    int             m_numItems;
+    int             m_nextItem;     // Index of the next source or job; guarded by m_mutex.
+
+};
+
+}
+
+#endif
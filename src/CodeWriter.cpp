@@ -8,20 +8,57 @@
 //=============================================================================
 
 #include "Engine/Assert.h"
+#include "Engine/Allocator.h"
 #include "Engine/String.h"
 
 #include "CodeWriter.h"
 
 #include <stdarg.h>
+#include <string.h>
+
+#ifndef va_copy
+    #if defined(__GNUC__)
+        #define va_copy(dst, src) __va_copy(dst, src)
+    #else
+        #define va_copy(dst, src) ((dst) = (src))
+    #endif
+#endif
 
 namespace M4
 {
 
-static const int _maxLineLength = 2048;
+static const int _formatBufferSize = 256;
+static const int _maxFormatBufferSize = 16 * 1024 * 1024;
+static const size_t _sinkBlockSize = 16 * 1024;
+
+FileCodeSink::FileCodeSink(FILE* file) :
+    m_file(file)
+{
+}
+
+bool FileCodeSink::Write(const char* data, size_t length)
+{
+    return fwrite(data, 1, length, m_file) == length;
+}
+
+CallbackCodeSink::CallbackCodeSink(CodeSinkCallback callback, void* userData) :
+    m_callback(callback), m_userData(userData)
+{
+}
+
+bool CallbackCodeSink::Write(const char* data, size_t length)
+{
+    return m_callback(data, length, m_userData);
+}
 
 CodeWriter::CodeWriter(Allocator* allocator) :
     m_allocator(allocator)
 {
+    m_buffer            = NULL;
+    m_bufferLength      = 0;
+    m_bufferCapacity    = 0;
+    m_sink              = NULL;
+    m_sinkError         = false;
     m_currentLine       = 1;
     m_currentFileName   = NULL;
     m_spacesPerIndent   = 4;
@@ -29,6 +66,11 @@ CodeWriter::CodeWriter(Allocator* allocator) :
     m_writeFileNames    = false;
 }
 
+CodeWriter::~CodeWriter()
+{
+    m_allocator->Free(m_buffer, m_bufferCapacity);
+}
+
 void CodeWriter::BeginLine(int indent, const char* fileName, int lineNumber)
 {
 
@@ -52,37 +94,32 @@ void CodeWriter::BeginLine(int indent, const char* fileName, int lineNumber)
         }
         if (outputLine || outputFile)
         {
-            char buffer[256];
-            String_Printf(buffer, sizeof(buffer), "#line %d", lineNumber);
-            m_buffer += buffer;
+            Append("#line ");
+            WriteInt(lineNumber);
             if (outputFile && m_writeFileNames)
             {
-                m_buffer += " \"";
-                m_buffer += fileName;
-                m_buffer += "\"\n";
+                Append(" \"");
+                Append(fileName);
+                Append("\"\n");
             }
             else
             {
-                m_buffer += "\n";
+                Append("\n");
             }
         }
 
     }
 
-    // Handle the indentation.
-    for (int i = 0; i < indent * m_spacesPerIndent; ++i)
-    {
-        m_buffer += " ";
-    }
+    WriteIndent(indent);
 }
 
 void CodeWriter::EndLine(const char* text)
 {
     if (text != NULL)
     {
-        m_buffer += text;
+        Append(text);
     }
-    m_buffer += "\n";
+    Append("\n");
     ++m_currentLine;
 }
 
@@ -90,12 +127,7 @@ void CodeWriter::Write(const char* format, ...)
 {
     va_list args;
     va_start(args, format);
-
-    char buffer[_maxLineLength];
-    String_Printf(buffer, sizeof(buffer), format, args);
-
-    m_buffer += buffer;
-
+    AppendFormat(format, args);
     va_end(args);      
 }
 
@@ -104,16 +136,8 @@ void CodeWriter::WriteLine(int indent, const char* format, ...)
     va_list args;
     va_start(args, format);
 
-    char buffer[_maxLineLength];
-
-    int result = String_Printf(buffer, sizeof(buffer), format, args);
-    ASSERT(result != -1);
-
-    for (int i = 0; i < indent * m_spacesPerIndent; ++i)
-    {
-        m_buffer += " ";
-    }
-    m_buffer += buffer;
+    WriteIndent(indent);
+    AppendFormat(format, args);
 
     EndLine();
 
@@ -126,21 +150,181 @@ void CodeWriter::WriteLine(int indent, const char* fileName, int lineNumber, con
     va_start(args, format);
 
     BeginLine(indent, fileName, lineNumber);
-
-    char buffer[_maxLineLength];
-    int result = String_Printf(buffer, sizeof(buffer), format, args);
-    ASSERT(result != -1);
-
-    m_buffer += buffer;
+    AppendFormat(format, args);
 
     EndLine();
 
     va_end(args);        
 }
 
+void CodeWriter::WriteText(const char* text)
+{
+    Append(text, strlen(text));
+}
+
+void CodeWriter::WriteText(const char* text, size_t length)
+{
+    Append(text, length);
+}
+
+void CodeWriter::WriteInt(int value)
+{
+    // Write the digits backwards from the end of the buffer.
+    char buffer[16];
+    char* p = buffer + sizeof(buffer);
+    unsigned int magnitude = (value < 0) ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+    do
+    {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    }
+    while (magnitude != 0);
+    if (value < 0)
+    {
+        *--p = '-';
+    }
+    Append(p, buffer + sizeof(buffer) - p);
+}
+
+void CodeWriter::WriteFloat(float value)
+{
+    // String_FormatFloat doesn't depend on the system locale, unlike printf.
+    char buffer[64];
+    int length = String_FormatFloat(buffer, sizeof(buffer), value);
+    ASSERT(length < static_cast<int>(sizeof(buffer)));
+    Append(buffer, length);
+}
+
+void CodeWriter::WriteIndent(int indent)
+{
+    static const char spaces[] = "                                                                ";
+    size_t count = indent * m_spacesPerIndent;
+    while (count > 0)
+    {
+        size_t length = (count < sizeof(spaces) - 1) ? count : sizeof(spaces) - 1;
+        Append(spaces, length);
+        count -= length;
+    }
+}
+
+void CodeWriter::SetSink(CodeSink* sink)
+{
+    ASSERT(m_bufferLength == 0);
+    m_sink = sink;
+    if (m_sink != NULL && m_bufferCapacity < _sinkBlockSize)
+    {
+        m_allocator->Free(m_buffer, m_bufferCapacity);
+        m_buffer         = static_cast<char*>(m_allocator->Allocate(_sinkBlockSize, 1));
+        m_bufferCapacity = _sinkBlockSize;
+    }
+}
+
+bool CodeWriter::Flush()
+{
+    if (m_sink != NULL && m_bufferLength > 0)
+    {
+        if (!m_sink->Write(m_buffer, m_bufferLength))
+        {
+            m_sinkError = true;
+        }
+        m_bufferLength = 0;
+    }
+    return !m_sinkError;
+}
+
 const char* CodeWriter::GetResult() const
 {
-    return m_buffer.c_str();
+    return (m_buffer != NULL && m_sink == NULL) ? m_buffer : "";
+}
+
+void CodeWriter::Append(const char* text)
+{
+    Append(text, strlen(text));
+}
+
+void CodeWriter::AppendFormat(const char* format, va_list args)
+{
+    // Most fragments fit in the stack buffer; longer ones are formatted again
+    // into a buffer of the right size.
+    char stackBuffer[_formatBufferSize];
+    char* buffer = stackBuffer;
+    int bufferSize = sizeof(stackBuffer);
+    while (true)
+    {
+        va_list argsCopy;
+        va_copy(argsCopy, args);
+        int length = String_Printf(buffer, bufferSize, format, argsCopy);
+        va_end(argsCopy);
+
+        if (length >= 0 && length < bufferSize)
+        {
+            Append(buffer, length);
+            break;
+        }
+
+        // Some C runtimes return -1 rather than the length when the output is
+        // truncated, so then just keep growing the buffer.
+        int newSize = (length >= 0) ? length + 1 : bufferSize * 2;
+        if (newSize > _maxFormatBufferSize)
+        {
+            ASSERT(0);
+            break;
+        }
+        if (buffer != stackBuffer)
+        {
+            m_allocator->Free(buffer, bufferSize);
+        }
+        buffer     = static_cast<char*>(m_allocator->Allocate(newSize, 1));
+        bufferSize = newSize;
+    }
+    if (buffer != stackBuffer)
+    {
+        m_allocator->Free(buffer, bufferSize);
+    }
+}
+
+void CodeWriter::Append(const char* text, size_t length)
+{
+    if (m_sink != NULL)
+    {
+        // Text that doesn't fit in a block is written directly.
+        if (m_bufferLength + length > m_bufferCapacity)
+        {
+            Flush();
+            if (length > m_bufferCapacity)
+            {
+                if (!m_sink->Write(text, length))
+                {
+                    m_sinkError = true;
+                }
+                return;
+            }
+        }
+        memcpy(m_buffer + m_bufferLength, text, length);
+        m_bufferLength += length;
+        return;
+    }
+
+    // Leave room for the terminating 0 so the result can be used directly.
+    if (m_bufferLength + length + 1 > m_bufferCapacity)
+    {
+        size_t capacity = (m_bufferCapacity < 4096) ? 4096 : m_bufferCapacity * 2;
+        while (capacity < m_bufferLength + length + 1)
+        {
+            capacity *= 2;
+        }
+        char* buffer = static_cast<char*>(m_allocator->Allocate(capacity, 1));
+        if (m_buffer != NULL)
+        {
+            memcpy(buffer, m_buffer, m_bufferLength);
+        }
+        m_allocator->Free(m_buffer, m_bufferCapacity);
+        m_buffer         = buffer;
+        m_bufferCapacity = capacity;
+    }
+    memcpy(m_buffer + m_bufferLength, text, length);
+    m_bufferLength += length;
+    m_buffer[m_bufferLength] = 0;
 }
 
 }
\ No newline at end of file
@@ -10,13 +10,47 @@
 #ifndef CODE_WRITER_H
 #define CODE_WRITER_H
 
-#include <string>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
 
 namespace M4
 {
 
 class Allocator;
 
+/** Destination for the output of a CodeWriter, which is written in blocks. */
+class CodeSink
+{
+public:
+    virtual ~CodeSink() {}
+    /** Returns false if the data couldn't be written. */
+    virtual bool Write(const char* data, size_t length) = 0;
+};
+
+/** Writes the output to a stdio file (such as stdout). The file isn't closed. */
+class FileCodeSink : public CodeSink
+{
+public:
+    explicit FileCodeSink(FILE* file);
+    virtual bool Write(const char* data, size_t length);
+private:
+    FILE*           m_file;
+};
+
+typedef bool (*CodeSinkCallback)(const char* data, size_t length, void* userData);
+
+/** Passes the output to a function. */
+class CallbackCodeSink : public CodeSink
+{
+public:
+    CallbackCodeSink(CodeSinkCallback callback, void* userData);
+    virtual bool Write(const char* data, size_t length);
+private:
+    CodeSinkCallback m_callback;
+    void*           m_userData;
+};
+
 /**
  * This class is used for outputting code. It handles indentation and inserting #line markers
  * to match the desired output line numbers.
@@ -27,20 +61,56 @@ class CodeWriter
 public:
 
     explicit CodeWriter(Allocator* allocator);
+    ~CodeWriter();
 
     void BeginLine(int indent, const char* fileName = NULL, int lineNumber = -1);
     void Write(const char* format, ...);
     void EndLine(const char* text = NULL);
 
+    /** These write a single value without going through printf, which makes them
+    much faster than Write for the fragments that make up expressions. */
+    void WriteText(const char* text);
+    void WriteText(const char* text, size_t length);
+    void WriteInt(int value);
+    void WriteFloat(float value);
+    void WriteIndent(int indent);
+
     void WriteLine(int indent, const char* format, ...);
     void WriteLine(int indent, const char* fileName, int lineNumber, const char* format, ...);
 
+    /**
+     * Streams the output to the sink in fixed size blocks instead of keeping all
+     * of it in memory, in which case GetResult returns an empty string. This must
+     * be called before anything is written.
+     */
+    void SetSink(CodeSink* sink);
+
+    /** Writes any buffered output to the sink. Returns false if any write to the
+    sink has failed. */
+    bool Flush();
+
     const char* GetResult() const;
 
+private:
+
+    void Append(const char* text);
+    void Append(const char* text, size_t length);
+
+    /** Formats the text with printf; the output can be any length. */
+    void AppendFormat(const char* format, va_list args);
+
+    // Not copyable.
+    CodeWriter(const CodeWriter&);
+    CodeWriter& operator=(const CodeWriter&);
+
 private:
 
     Allocator*      m_allocator;
-    std::string     m_buffer;
+    char*           m_buffer;
+    size_t          m_bufferLength;
+    size_t          m_bufferCapacity;
+    CodeSink*       m_sink;
+    bool            m_sinkError;
     int             m_currentLine;
     const char*     m_currentFileName;
     int             m_spacesPerIndent;
@@ -0,0 +1,172 @@
+#include "Allocator.h"
+#include "Assert.h"
+
+#include <stdlib.h>
+
+namespace M4
+{
+
+Allocator::Allocator()
+{
+    m_stats.bytesAllocated      = 0;
+    m_stats.peakBytesAllocated  = 0;
+    m_stats.numAllocations      = 0;
+}
+
+Allocator::~Allocator()
+{
+}
+
+void* Allocator::Allocate(size_t size, size_t alignment)
+{
+    ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    void* ptr = AllocateMemory(size, alignment);
+    if (ptr != NULL)
+    {
+        m_stats.bytesAllocated += size;
+        ++m_stats.numAllocations;
+        if (m_stats.bytesAllocated > m_stats.peakBytesAllocated)
+        {
+            m_stats.peakBytesAllocated = m_stats.bytesAllocated;
+        }
+    }
+    return ptr;
+}
+
+void Allocator::Free(void* ptr, size_t size)
+{
+    if (ptr != NULL)
+    {
+        ASSERT(m_stats.bytesAllocated >= size);
+        m_stats.bytesAllocated -= size;
+        FreeMemory(ptr, size);
+    }
+}
+
+const AllocatorStats& Allocator::GetStats() const
+{
+    return m_stats;
+}
+
+void Allocator::ResetStats()
+{
+    // The bytes which are still allocated are tracked so they can be freed.
+    m_stats.peakBytesAllocated  = m_stats.bytesAllocated;
+    m_stats.numAllocations      = 0;
+}
+
+void Allocator::ReleaseAll()
+{
+    m_stats.bytesAllocated      = 0;
+}
+
+void* HeapAllocator::AllocateMemory(size_t size, size_t alignment)
+{
+    // malloc already returns memory aligned for any of the built in types.
+    ASSERT(alignment <= s_defaultAlignment);
+    void* ptr = malloc(size);
+    if (ptr == NULL && size > 0)
+    {
+        // Running out of memory is not something the parser can recover from.
+        ASSERT(0);
+        abort();
+    }
+    return ptr;
+}
+
+void HeapAllocator::FreeMemory(void* ptr, size_t /*size*/)
+{
+    free(ptr);
+}
+
+ArenaAllocator::ArenaAllocator(size_t blockSize)
+{
+    m_blockSize     = blockSize;
+    m_reservedSize  = 0;
+    m_blocks        = NULL;
+    m_blockPos      = NULL;
+    m_blockEnd      = NULL;
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+    FreeBlocks();
+}
+
+void ArenaAllocator::Reset()
+{
+    if (m_blocks != NULL && m_blocks->next != NULL)
+    {
+        // Replace the blocks with a single one big enough for everything that was
+        // allocated, so the next use of the arena doesn't need to grow.
+        size_t reservedSize = m_reservedSize;
+        FreeBlocks();
+        AllocateBlock(reservedSize);
+    }
+    else if (m_blocks != NULL)
+    {
+        m_blockPos = reinterpret_cast<char*>(m_blocks + 1);
+    }
+
+    // Keep the high water mark so that it covers all uses of the arena.
+    ReleaseAll();
+}
+
+size_t ArenaAllocator::GetReservedSize() const
+{
+    return m_reservedSize;
+}
+
+void* ArenaAllocator::AllocateMemory(size_t size, size_t alignment)
+{
+    size_t padding = (alignment - reinterpret_cast<size_t>(m_blockPos) % alignment) % alignment;
+    if (m_blockPos == NULL || size + padding > static_cast<size_t>(m_blockEnd - m_blockPos))
+    {
+        AllocateBlock(size + alignment > m_blockSize ? size + alignment : m_blockSize);
+        padding = (alignment - reinterpret_cast<size_t>(m_blockPos) % alignment) % alignment;
+    }
+    char* result = m_blockPos + padding;
+    m_blockPos = result + size;
+    return result;
+}
+
+void ArenaAllocator::FreeMemory(void* ptr, size_t size)
+{
+    // Only the most recent allocation can be given back.
+    if (static_cast<char*>(ptr) + size == m_blockPos)
+    {
+        m_blockPos = static_cast<char*>(ptr);
+    }
+}
+
+void ArenaAllocator::AllocateBlock(size_t size)
+{
+    Block* block = static_cast<Block*>(malloc(sizeof(Block) + size));
+    if (block == NULL)
+    {
+        ASSERT(0);
+        abort();
+    }
+    block->next  = m_blocks;
+    block->size  = size;
+    m_blocks     = block;
+
+    m_blockPos   = reinterpret_cast<char*>(block + 1);
+    m_blockEnd   = m_blockPos + size;
+    m_reservedSize += size;
+}
+
+void ArenaAllocator::FreeBlocks()
+{
+    while (m_blocks != NULL)
+    {
+        Block* next = m_blocks->next;
+        free(m_blocks);
+        m_blocks = next;
+    }
+    m_reservedSize  = 0;
+    m_blockPos      = NULL;
+    m_blockEnd      = NULL;
+}
+
+}
@@ -1,31 +1,151 @@
 #ifndef ENGINE_ALLOCATOR_H
 #define ENGINE_ALLOCATOR_H
 
+#include <stddef.h>
+#include <new>
+
 namespace M4
 {
 
+/** Returns the alignment required by a type. */
+template<typename T>
+struct AlignOf
+{
+    struct Helper
+    {
+        char    c;
+        T       t;
+    };
+    enum { value = sizeof(Helper) - sizeof(T) };
+};
+
+struct AllocatorStats
+{
+    size_t  bytesAllocated;         // Bytes currently allocated.
+    size_t  peakBytesAllocated;     // High water mark of bytesAllocated.
+    size_t  numAllocations;         // Total number of allocations.
+};
+
+/**
+ * Interface used for all of the memory allocated while parsing and generating code.
+ * An allocator is not thread safe; each thread should use its own.
+ */
 class Allocator
 {
 
 public:
 
-    Allocator()
-    {
-    }
+    static const size_t s_defaultAlignment = 16;
+
+    Allocator();
+    virtual ~Allocator();
+
+    void* Allocate(size_t size, size_t alignment = s_defaultAlignment);
+
+    /** The size must match the size passed to Allocate. */
+    void Free(void* ptr, size_t size);
 
     template<typename T>
     T* New()
     {
-        return new T;
+        return new (Allocate(sizeof(T), AlignOf<T>::value)) T;
     }
 
     template<typename T>
-    void Delete(T* ptr) {
-        delete ptr;
+    void Delete(T* ptr)
+    {
+        if (ptr != NULL)
+        {
+            ptr->~T();
+            Free(ptr, sizeof(T));
+        }
     }
 
+    const AllocatorStats& GetStats() const;
+
+    /** Resets the allocation count and the high water mark. */
+    void ResetStats();
+
+protected:
+
+    virtual void* AllocateMemory(size_t size, size_t alignment) = 0;
+    virtual void  FreeMemory(void* ptr, size_t size) = 0;
+
+    /** Called by implementations which release all of their memory at once. */
+    void ReleaseAll();
+
 private:
 
+    // Not copyable.
+    Allocator(const Allocator&);
+    Allocator& operator=(const Allocator&);
+
+private:
+
+    AllocatorStats  m_stats;
+
+};
+
+/**
+ * Allocates each block of memory from the system heap.
+ */
+class HeapAllocator : public Allocator
+{
+
+protected:
+
+    virtual void* AllocateMemory(size_t size, size_t alignment);
+    virtual void  FreeMemory(void* ptr, size_t size);
+
+};
+
+/**
+ * Allocates memory by bumping a pointer through large blocks. Freeing memory
+ * has no effect (except for the most recent allocation) until Reset is called,
+ * which makes it well suited to allocating everything for one compilation and
+ * then reusing the memory for the next one.
+ */
+class ArenaAllocator : public Allocator
+{
+
+public:
+
+    static const size_t s_defaultBlockSize = 64 * 1024;
+
+    explicit ArenaAllocator(size_t blockSize = s_defaultBlockSize);
+    virtual ~ArenaAllocator();
+
+    /** Releases everything allocated from the arena. The memory is kept for
+    reuse, coalesced into a single block if the arena had to grow. */
+    void Reset();
+
+    /** Returns the total size of the blocks owned by the arena. */
+    size_t GetReservedSize() const;
+
+protected:
+
+    virtual void* AllocateMemory(size_t size, size_t alignment);
+    virtual void  FreeMemory(void* ptr, size_t size);
+
+private:
+
+    struct Block
+    {
+        Block*      next;
+        size_t      size;
+    };
+
+    void AllocateBlock(size_t size);
+    void FreeBlocks();
+
+private:
+
+    size_t          m_blockSize;
+    size_t          m_reservedSize;
+    Block*          m_blocks;           // Most recently allocated block first.
+    char*           m_blockPos;
+    char*           m_blockEnd;
+
 };
 
 }
@@ -1,55 +1,126 @@
 #ifndef ENGINE_ARRAY_H
 #define ENGINE_ARRAY_H
 
-#include <vector>
+#include "Allocator.h"
 
 namespace M4
 {
 
-class Allocator;
-
 template<typename T>
 class Array
 {
 
 public:
 
-    Array(Allocator* allocator) {}
+    explicit Array(Allocator* allocator)
+    {
+        m_allocator = allocator;
+        m_elements  = NULL;
+        m_size      = 0;
+        m_capacity  = 0;
+    }
+
+    ~Array()
+    {
+        Resize(0);
+        m_allocator->Free(m_elements, sizeof(T) * m_capacity);
+    }
 
     void PushBack(const T& element)
     {
-        elements_.push_back(element);
+        if (m_size == m_capacity)
+        {
+            // The element may be stored in the array.
+            T copy(element);
+            Reserve(GetGrowCapacity(m_size + 1));
+            new (m_elements + m_size) T(copy);
+        }
+        else
+        {
+            new (m_elements + m_size) T(element);
+        }
+        ++m_size;
     }
 
     T& PushBackNew()
     {
-        elements_.push_back(T());
-        return elements_.back();
+        if (m_size == m_capacity)
+        {
+            Reserve(GetGrowCapacity(m_size + 1));
+        }
+        T* element = new (m_elements + m_size) T();
+        ++m_size;
+        return *element;
     }
 
     void Resize(int newSize)
     {
-        elements_.resize(newSize);
+        if (newSize > m_capacity)
+        {
+            Reserve(GetGrowCapacity(newSize));
+        }
+        for (int i = newSize; i < m_size; ++i)
+        {
+            m_elements[i].~T();
+        }
+        for (int i = m_size; i < newSize; ++i)
+        {
+            new (m_elements + i) T();
+        }
+        m_size = newSize;
+    }
+
+    /** Makes sure the array can hold capacity elements without reallocating. */
+    void Reserve(int capacity)
+    {
+        if (capacity <= m_capacity)
+        {
+            return;
+        }
+        T* elements = static_cast<T*>(m_allocator->Allocate(sizeof(T) * capacity, AlignOf<T>::value));
+        for (int i = 0; i < m_size; ++i)
+        {
+            new (elements + i) T(m_elements[i]);
+            m_elements[i].~T();
+        }
+        m_allocator->Free(m_elements, sizeof(T) * m_capacity);
+        m_elements = elements;
+        m_capacity = capacity;
     }
 
     int GetSize() const
     {
-        return static_cast<int>(elements_.size());
+        return m_size;
     }
 
     T& operator[](int index)
     {
-        return elements_[index];
+        return m_elements[index];
     }
 
     const T& operator[](int index) const
     {
-        return elements_[index];
+        return m_elements[index];
     }
 
 private:
 
-    std::vector<T> elements_;
+    int GetGrowCapacity(int size) const
+    {
+        int capacity = (m_capacity < 8) ? 8 : m_capacity * 2;
+        return (capacity < size) ? size : capacity;
+    }
+
+    // Not copyable.
+    Array(const Array&);
+    Array& operator=(const Array&);
+
+private:
+
+    Allocator*      m_allocator;
+    T*              m_elements;
+    int             m_size;
+    int             m_capacity;
 
 };
 
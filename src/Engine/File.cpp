@@ -0,0 +1,400 @@
+#include "File.h"
+#include "Allocator.h"
+#include "String.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace M4
+{
+
+/** Reads a stream whose size isn't known ahead of time, such as a pipe. The
+contents are null terminated like those from File_Read. */
+static char* ReadStream(Allocator* allocator, FILE* file, size_t& length)
+{
+    length = 0;
+
+    size_t capacity = 64 * 1024;
+    char*  buffer   = static_cast<char*>(allocator->Allocate(capacity, 1));
+    while (true)
+    {
+        length += fread(buffer + length, 1, capacity - length, file);
+        if (length < capacity)
+        {
+            break;
+        }
+        char* newBuffer = static_cast<char*>(allocator->Allocate(capacity * 2, 1));
+        memcpy(newBuffer, buffer, length);
+        allocator->Free(buffer, capacity);
+        buffer    = newBuffer;
+        capacity *= 2;
+    }
+
+    if (ferror(file))
+    {
+        allocator->Free(buffer, capacity);
+        length = 0;
+        return NULL;
+    }
+
+    // File_Free expects the contents to be exactly one byte longer than the file.
+    if (length + 1 != capacity)
+    {
+        char* newBuffer = static_cast<char*>(allocator->Allocate(length + 1, 1));
+        memcpy(newBuffer, buffer, length);
+        allocator->Free(buffer, capacity);
+        buffer = newBuffer;
+    }
+
+    buffer[length] = 0;
+    return buffer;
+}
+
+char* File_Read(Allocator* allocator, const char* fileName, size_t& length)
+{
+    length = 0;
+
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        size = ftell(file);
+    }
+    if (size < 0 || fseek(file, 0, SEEK_SET) != 0)
+    {
+        // Pipes can't seek, so they're read until they're empty instead.
+        char* contents = ReadStream(allocator, file, length);
+        fclose(file);
+        return contents;
+    }
+
+    char* contents = static_cast<char*>(allocator->Allocate(size + 1, 1));
+    size_t numRead = fread(contents, 1, size, file);
+    fclose(file);
+
+    if (numRead != static_cast<size_t>(size))
+    {
+        allocator->Free(contents, size + 1);
+        return NULL;
+    }
+
+    contents[size] = 0;
+    length = size;
+    return contents;
+}
+
+void File_Free(Allocator* allocator, char* contents, size_t length)
+{
+    if (contents != NULL)
+    {
+        allocator->Free(contents, length + 1);
+    }
+}
+
+/**
+ * The part of the last page past the end of a mapped file reads as zeros, which
+ * null terminates the contents unless the file fills the page exactly. Those
+ * files (and empty ones, which can't be mapped) are read instead, so that the
+ * tokenizer can rely on the terminator either way.
+ */
+static bool GetCanMap(uint64_t size)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    uint64_t pageSize = info.dwPageSize;
+#else
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0)
+    {
+        return false;
+    }
+#endif
+    return size > 0 && size <= static_cast<size_t>(-1) && size % static_cast<uint64_t>(pageSize) != 0;
+}
+
+bool File_Map(Allocator* allocator, const char* fileName, FileView& view)
+{
+    view.contents = NULL;
+    view.length   = 0;
+    view.mapped   = false;
+
+    size_t length = 0;
+    char*  contents = NULL;
+
+    if (strcmp(fileName, "-") == 0)
+    {
+#if defined(_WIN32)
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        contents = ReadStream(allocator, stdin, length);
+    }
+    else
+    {
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        size.QuadPart = 0;
+        if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size) &&
+            GetCanMap(static_cast<uint64_t>(size.QuadPart)))
+        {
+            // The view keeps the mapping alive, so neither handle is needed once
+            // it's been created.
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL)
+            {
+                view.contents = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+
+        if (view.contents != NULL)
+        {
+            view.length = static_cast<size_t>(size.QuadPart);
+            view.mapped = true;
+            return true;
+        }
+        contents = File_Read(allocator, fileName, length);
+#else
+        int file = open(fileName, O_RDONLY);
+        if (file < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(file, &info) == 0 && S_ISREG(info.st_mode) &&
+            GetCanMap(static_cast<uint64_t>(info.st_size)))
+        {
+            size_t size = static_cast<size_t>(info.st_size);
+            void* address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (address != MAP_FAILED)
+            {
+#if defined(MADV_SEQUENTIAL)
+                // The tokenizer reads straight through, so read ahead aggressively.
+                madvise(address, size, MADV_SEQUENTIAL);
+#endif
+                close(file);
+                view.contents = static_cast<const char*>(address);
+                view.length   = size;
+                view.mapped   = true;
+                return true;
+            }
+        }
+
+        // Pipes and the like are read through the descriptor that's already
+        // open, since opening a pipe again could lose its contents.
+        FILE* stream = fdopen(file, "rb");
+        if (stream == NULL)
+        {
+            close(file);
+            return false;
+        }
+        contents = ReadStream(allocator, stream, length);
+        fclose(stream);
+#endif
+    }
+
+    if (contents == NULL)
+    {
+        return false;
+    }
+    view.contents = contents;
+    view.length   = length;
+    return true;
+}
+
+void File_Unmap(Allocator* allocator, FileView& view)
+{
+    if (view.mapped)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(view.contents);
+#else
+        munmap(const_cast<char*>(view.contents), view.length);
+#endif
+    }
+    else
+    {
+        File_Free(allocator, const_cast<char*>(view.contents), view.length);
+    }
+    view.contents = NULL;
+    view.length   = 0;
+    view.mapped   = false;
+}
+
+bool File_Write(const char* fileName, const char* contents, size_t length)
+{
+    FILE* file = fopen(fileName, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool result = fwrite(contents, 1, length, file) == length;
+    if (fclose(file) != 0)
+    {
+        result = false;
+    }
+    return result;
+}
+
+bool File_WriteAtomic(const char* fileName, const char* contents, size_t length)
+{
+    // The process id keeps other processes from using the same name, and the
+    // address of the contents keeps other threads writing at the same time
+    // from using it.
+#if defined(_WIN32)
+    unsigned long processId = GetCurrentProcessId();
+#else
+    unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+    char tempName[1024];
+    int count = String_Printf(tempName, sizeof(tempName), "%s.%lu.%p.tmp", fileName, processId, static_cast<const void*>(contents));
+    if (count < 0 || count >= static_cast<int>(sizeof(tempName)))
+    {
+        return false;
+    }
+
+    if (!File_Write(tempName, contents, length))
+    {
+        File_Delete(tempName);
+        return false;
+    }
+
+#if defined(_WIN32)
+    bool result = MoveFileExA(tempName, fileName, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool result = rename(tempName, fileName) == 0;
+#endif
+    if (!result)
+    {
+        File_Delete(tempName);
+    }
+    return result;
+}
+
+bool File_Delete(const char* fileName)
+{
+    return remove(fileName) == 0;
+}
+
+bool File_Touch(const char* fileName)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(fileName, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    bool result = SetFileTime(file, NULL, NULL, &now) != 0;
+    CloseHandle(file);
+    return result;
+#else
+    return utime(fileName, NULL) == 0;
+#endif
+}
+
+bool File_CreateDirectory(const char* directoryName)
+{
+#if defined(_WIN32)
+    return CreateDirectoryA(directoryName, NULL) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat info;
+    if (stat(directoryName, &info) == 0)
+    {
+        return S_ISDIR(info.st_mode);
+    }
+    return mkdir(directoryName, 0777) == 0;
+#endif
+}
+
+bool File_ListDirectory(const char* directoryName, FileCallback callback, void* data)
+{
+#if defined(_WIN32)
+    char pattern[1024];
+    int count = String_Printf(pattern, sizeof(pattern), "%s\\*", directoryName);
+    if (count < 0 || count >= static_cast<int>(sizeof(pattern)))
+    {
+        return false;
+    }
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA(pattern, &findData);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    do
+    {
+        if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+        {
+            FileInfo info;
+            info.name           = findData.cFileName;
+            info.size           = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+            info.modifiedTime   = static_cast<int64_t>(((static_cast<uint64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) |
+                                    findData.ftLastWriteTime.dwLowDateTime) / 10000000);
+            callback(info, data);
+        }
+    }
+    while (FindNextFileA(find, &findData));
+    FindClose(find);
+    return true;
+#else
+    DIR* directory = opendir(directoryName);
+    if (directory == NULL)
+    {
+        return false;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        char path[1024];
+        int count = String_Printf(path, sizeof(path), "%s/%s", directoryName, entry->d_name);
+        if (count < 0 || count >= static_cast<int>(sizeof(path)))
+        {
+            continue;
+        }
+        struct stat stats;
+        if (stat(path, &stats) == 0 && S_ISREG(stats.st_mode))
+        {
+            FileInfo info;
+            info.name           = entry->d_name;
+            info.size           = static_cast<uint64_t>(stats.st_size);
+            info.modifiedTime   = static_cast<int64_t>(stats.st_mtime);
+            callback(info, data);
+        }
+    }
+    closedir(directory);
+    return true;
+#endif
+}
+
+}
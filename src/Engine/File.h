@@ -0,0 +1,67 @@
+#ifndef ENGINE_FILE_H
+#define ENGINE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace M4
+{
+
+class Allocator;
+
+/** Reads the entire file into memory from the allocator. The contents are null
+terminated (length doesn't include the terminator). Returns NULL if the file
+couldn't be read. */
+char* File_Read(Allocator* allocator, const char* fileName, size_t& length);
+
+/** Frees the contents returned by File_Read. */
+void File_Free(Allocator* allocator, char* contents, size_t length);
+
+/** Read only contents of a file, from File_Map. */
+struct FileView
+{
+    const char*     contents;       // Null terminated, like the contents from File_Read.
+    size_t          length;
+    bool            mapped;         // Otherwise the contents are from the allocator.
+};
+
+/** Gives read only access to the contents of the file. Regular files are mapped
+into memory where possible so that they aren't copied; other files such as pipes
+are read into memory from the allocator instead, and the name "-" reads standard
+input. Returns false if the file couldn't be read. A mapped file mustn't be
+truncated until the view is released. */
+bool File_Map(Allocator* allocator, const char* fileName, FileView& view);
+
+/** Releases the view returned by File_Map. */
+void File_Unmap(Allocator* allocator, FileView& view);
+
+/** Replaces the contents of the file. Returns false if it couldn't be written. */
+bool File_Write(const char* fileName, const char* contents, size_t length);
+
+/** Like File_Write, but writes a temporary file and renames it, so that readers
+(including other processes) see either the old or the new contents. */
+bool File_WriteAtomic(const char* fileName, const char* contents, size_t length);
+
+bool File_Delete(const char* fileName);
+
+/** Sets the modification time of the file to now. */
+bool File_Touch(const char* fileName);
+
+/** Creates the directory if it doesn't already exist. The parent must exist. */
+bool File_CreateDirectory(const char* directoryName);
+
+struct FileInfo
+{
+    const char*     name;           // Without the directory.
+    uint64_t        size;
+    int64_t         modifiedTime;   // Seconds; only meaningful for comparisons.
+};
+
+typedef void (*FileCallback)(const FileInfo& info, void* data);
+
+/** Calls the callback for each regular file in the directory. */
+bool File_ListDirectory(const char* directoryName, FileCallback callback, void* data);
+
+}
+
+#endif
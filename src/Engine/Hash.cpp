@@ -0,0 +1,104 @@
+#include "Hash.h"
+
+#include <string.h>
+
+namespace M4
+{
+
+static uint64_t RotateLeft(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t Mix(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDull;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static uint64_t ReadBlock(const unsigned char* p)
+{
+    // Read byte by byte so that the result doesn't depend on the endianness or
+    // the alignment of the data.
+    uint64_t result = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        result = (result << 8) | p[i];
+    }
+    return result;
+}
+
+Hash128 Hash_Compute128(const void* data, size_t length, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const size_t numBlocks = length / 16;
+
+    const uint64_t c1 = 0x87C37B91114253D5ull;
+    const uint64_t c2 = 0x4CF5AD432745937Full;
+
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    for (size_t i = 0; i < numBlocks; ++i)
+    {
+        uint64_t k1 = ReadBlock(bytes + i * 16);
+        uint64_t k2 = ReadBlock(bytes + i * 16 + 8);
+
+        k1 *= c1; k1 = RotateLeft(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = RotateLeft(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+
+        k2 *= c2; k2 = RotateLeft(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = RotateLeft(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+    }
+
+    // Remaining bytes, padded with zeros.
+    const unsigned char* tail = bytes + numBlocks * 16;
+    unsigned char padded[16];
+    memset(padded, 0, sizeof(padded));
+    memcpy(padded, tail, length & 15);
+
+    uint64_t k1 = ReadBlock(padded);
+    uint64_t k2 = ReadBlock(padded + 8);
+    if ((length & 15) > 8)
+    {
+        k2 *= c2; k2 = RotateLeft(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+    if ((length & 15) > 0)
+    {
+        k1 *= c1; k1 = RotateLeft(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= length;
+    h2 ^= length;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = Mix(h1);
+    h2 = Mix(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    Hash128 hash;
+    hash.low  = h1;
+    hash.high = h2;
+    return hash;
+}
+
+void Hash_ToString(const Hash128& hash, char buffer[33])
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 16; ++i)
+    {
+        buffer[i]      = digits[(hash.high >> (60 - i * 4)) & 15];
+        buffer[i + 16] = digits[(hash.low  >> (60 - i * 4)) & 15];
+    }
+    buffer[32] = 0;
+}
+
+}
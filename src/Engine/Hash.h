@@ -0,0 +1,25 @@
+#ifndef ENGINE_HASH_H
+#define ENGINE_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace M4
+{
+
+/** 128 bit hash, wide enough to identify content without comparing it. */
+struct Hash128
+{
+    uint64_t    low;
+    uint64_t    high;
+};
+
+/** Computes the 128 bit MurmurHash3 (x64 variant) of the data. */
+Hash128 Hash_Compute128(const void* data, size_t length, uint64_t seed = 0);
+
+/** Writes the hash as 32 hex digits and a null terminator. */
+void Hash_ToString(const Hash128& hash, char buffer[33]);
+
+}
+
+#endif
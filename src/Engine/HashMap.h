@@ -0,0 +1,169 @@
+#ifndef ENGINE_HASH_MAP_H
+#define ENGINE_HASH_MAP_H
+
+#include "Allocator.h"
+
+#include <stdint.h>
+
+namespace M4
+{
+
+inline unsigned int HashMap_GetHash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return static_cast<unsigned int>(key);
+}
+
+inline unsigned int HashMap_GetHash(unsigned int key)
+{
+    return HashMap_GetHash(static_cast<uint64_t>(key));
+}
+
+/** Pointers are hashed by address, so strings should be interned. */
+template<typename T>
+inline unsigned int HashMap_GetHash(T* key)
+{
+    return HashMap_GetHash(static_cast<uint64_t>(reinterpret_cast<size_t>(key)));
+}
+
+/**
+ * Open addressing hash map. Entries can't be removed, which keeps the probing
+ * simple; store a value which means "none" instead. The keys and values are
+ * copied when the table grows, so they should be small.
+ */
+template<typename K, typename V>
+class HashMap
+{
+
+public:
+
+    explicit HashMap(Allocator* allocator)
+    {
+        m_allocator = allocator;
+        m_slots     = NULL;
+        m_capacity  = 0;
+        m_size      = 0;
+    }
+
+    ~HashMap()
+    {
+        FreeSlots(m_slots, m_capacity);
+    }
+
+    /** Returns the value for the key, or NULL if the key isn't in the map. */
+    V* Find(const K& key)
+    {
+        if (m_capacity == 0)
+        {
+            return NULL;
+        }
+        Slot& slot = m_slots[FindSlot(key)];
+        return slot.used ? &slot.value : NULL;
+    }
+
+    const V* Find(const K& key) const
+    {
+        return const_cast<HashMap*>(this)->Find(key);
+    }
+
+    /** Sets the value for the key, adding the key if it isn't in the map. */
+    void Insert(const K& key, const V& value)
+    {
+        if ((m_size + 1) * 2 > m_capacity)
+        {
+            Grow();
+        }
+        Slot& slot = m_slots[FindSlot(key)];
+        if (!slot.used)
+        {
+            slot.used = true;
+            slot.key  = key;
+            ++m_size;
+        }
+        slot.value = value;
+    }
+
+    int GetSize() const
+    {
+        return m_size;
+    }
+
+    void Clear()
+    {
+        for (int i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].used = false;
+        }
+        m_size = 0;
+    }
+
+private:
+
+    struct Slot
+    {
+        Slot() : used(false) {}
+        K       key;
+        V       value;
+        bool    used;
+    };
+
+    int FindSlot(const K& key) const
+    {
+        int mask  = m_capacity - 1;
+        int index = static_cast<int>(HashMap_GetHash(key) & mask);
+        while (m_slots[index].used && !(m_slots[index].key == key))
+        {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    void Grow()
+    {
+        Slot* oldSlots    = m_slots;
+        int   oldCapacity = m_capacity;
+
+        m_capacity = (oldCapacity == 0) ? 64 : oldCapacity * 2;
+        m_slots    = static_cast<Slot*>(m_allocator->Allocate(sizeof(Slot) * m_capacity, AlignOf<Slot>::value));
+        for (int i = 0; i < m_capacity; ++i)
+        {
+            new (m_slots + i) Slot();
+        }
+
+        for (int i = 0; i < oldCapacity; ++i)
+        {
+            if (oldSlots[i].used)
+            {
+                m_slots[FindSlot(oldSlots[i].key)] = oldSlots[i];
+            }
+        }
+        FreeSlots(oldSlots, oldCapacity);
+    }
+
+    void FreeSlots(Slot* slots, int capacity)
+    {
+        for (int i = 0; i < capacity; ++i)
+        {
+            slots[i].~Slot();
+        }
+        m_allocator->Free(slots, sizeof(Slot) * capacity);
+    }
+
+    // Not copyable.
+    HashMap(const HashMap&);
+    HashMap& operator=(const HashMap&);
+
+private:
+
+    Allocator*  m_allocator;
+    Slot*       m_slots;
+    int         m_capacity;     // Always 0 or a power of two.
+    int         m_size;
+
+};
+
+}
+
+#endif
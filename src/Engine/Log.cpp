@@ -1,7 +1,7 @@
 #include "Log.h"
 #include "String.h"
 
-#include <iostream>
+#include <stdio.h>
 
 namespace M4
 {
@@ -16,7 +16,11 @@ void Log_Error(const char* format, ...)
 
     va_end(args);
 
-    std::cerr << "ERROR: " << buffer << '\n';
+    // Write the whole line at once so that errors from different threads don't
+    // get interleaved.
+    char line[1024 + 16];
+    String_Printf(line, sizeof(line), "ERROR: %s\n", buffer);
+    fputs(line, stderr);
 }
 
 }
@@ -1,14 +1,16 @@
 #include "String.h"
 
 #include <cctype>
+#include <climits>
+#include <cmath>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <sstream>
-#include <locale>
 #include <algorithm>
 
+#include <stdint.h>
+
 namespace M4
 {
 
@@ -71,18 +73,467 @@ int String_ToInteger(const char* buffer, char** end)
     return static_cast<int>(value);
 }
 
+namespace
+{
+
+/** Fixed size unsigned integer used for the exact comparisons in String_DecimalToFloat. */
+class BigInteger
+{
+
+public:
+
+    explicit BigInteger(uint32_t value)
+    {
+        m_word[0]   = value;
+        m_numWords  = 1;
+    }
+
+    void MultiplyAdd(uint32_t factor, uint32_t addend)
+    {
+        uint64_t carry = addend;
+        for (int i = 0; i < m_numWords; ++i)
+        {
+            uint64_t product = static_cast<uint64_t>(m_word[i]) * factor + carry;
+            m_word[i] = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+        if (carry != 0 && m_numWords < s_maxWords)
+        {
+            m_word[m_numWords++] = static_cast<uint32_t>(carry);
+        }
+    }
+
+    void MultiplyPow10(int power)
+    {
+        for (; power >= 9; power -= 9)
+        {
+            MultiplyAdd(1000000000, 0);
+        }
+        static const uint32_t pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+        MultiplyAdd(pow10[power], 0);
+    }
+
+    void ShiftLeft(int bits)
+    {
+        int words = bits / 32;
+        bits %= 32;
+        if (bits != 0)
+        {
+            uint32_t carry = 0;
+            for (int i = 0; i < m_numWords; ++i)
+            {
+                uint32_t word = m_word[i];
+                m_word[i] = (word << bits) | carry;
+                carry = word >> (32 - bits);
+            }
+            if (carry != 0 && m_numWords < s_maxWords)
+            {
+                m_word[m_numWords++] = carry;
+            }
+        }
+        if (words > 0)
+        {
+            int numWords = std::min(m_numWords + words, static_cast<int>(s_maxWords));
+            for (int i = numWords - 1; i >= words; --i)
+            {
+                m_word[i] = m_word[i - words];
+            }
+            for (int i = 0; i < words; ++i)
+            {
+                m_word[i] = 0;
+            }
+            m_numWords = numWords;
+        }
+    }
+
+    static int Compare(const BigInteger& a, const BigInteger& b)
+    {
+        int numWords = std::max(a.m_numWords, b.m_numWords);
+        for (int i = numWords - 1; i >= 0; --i)
+        {
+            uint32_t wordA = (i < a.m_numWords) ? a.m_word[i] : 0;
+            uint32_t wordB = (i < b.m_numWords) ? b.m_word[i] : 0;
+            if (wordA != wordB)
+            {
+                return (wordA < wordB) ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+private:
+
+    // Enough for 128 significant digits scaled by the largest powers used.
+    static const int s_maxWords = 40;
+
+    uint32_t    m_word[s_maxWords];
+    int         m_numWords;
+
+};
+
+static const int _maxSignificantDigits = 128;
+
+// Powers of ten which are exactly representable as doubles.
+static const double _pow10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+static uint32_t FloatToBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsToFloat(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/** Compares digits * 10^exponent (plus a little more if truncated) with mantissa * 2^power. */
+static int CompareDecimal(const char* digits, int numDigits, int exponent, bool truncated, uint32_t mantissa, int power)
+{
+    BigInteger decimal(0);
+    for (int i = 0; i < numDigits; ++i)
+    {
+        decimal.MultiplyAdd(10, digits[i] - '0');
+    }
+    BigInteger binary(mantissa);
+
+    if (exponent >= 0)  decimal.MultiplyPow10(exponent);
+    else                binary.MultiplyPow10(-exponent);
+    if (power >= 0)     binary.ShiftLeft(power);
+    else                decimal.ShiftLeft(-power);
+
+    int result = BigInteger::Compare(decimal, binary);
+    if (result == 0 && truncated)
+    {
+        result = 1;
+    }
+    return result;
+}
+
+}
+
+float String_DecimalToFloat(const char* digits, int numDigits, int exponent, bool truncated)
+{
+
+    // Strip leading and trailing zeros.
+    while (numDigits > 0 && digits[0] == '0')
+    {
+        ++digits;
+        --numDigits;
+    }
+    while (numDigits > 0 && digits[numDigits - 1] == '0')
+    {
+        --numDigits;
+        ++exponent;
+    }
+    if (numDigits > _maxSignificantDigits)
+    {
+        for (int i = _maxSignificantDigits; i < numDigits; ++i)
+        {
+            truncated |= (digits[i] != '0');
+        }
+        exponent += numDigits - _maxSignificantDigits;
+        numDigits = _maxSignificantDigits;
+    }
+
+    if (numDigits == 0)
+    {
+        return 0.0f;
+    }
+
+    // Values which are certain to overflow or underflow.
+    if (numDigits - 1 + exponent >= 39)
+    {
+        return BitsToFloat(0x7F800000);
+    }
+    if (numDigits + exponent < -45)
+    {
+        return 0.0f;
+    }
+
+    // Use the leading digits for an approximation.
+    const int numLeadingDigits = std::min(numDigits, 19);
+    uint64_t mantissa = 0;
+    for (int i = 0; i < numLeadingDigits; ++i)
+    {
+        mantissa = mantissa * 10 + (digits[i] - '0');
+    }
+    const bool exact = (numLeadingDigits == numDigits) && !truncated;
+    const int  leadingExponent = exponent + (numDigits - numLeadingDigits);
+
+    // When the mantissa and the power of ten are both exactly representable as
+    // floats a single multiplication or division is correctly rounded.
+    if (exact && mantissa < (1 << 24) && leadingExponent >= -10 && leadingExponent <= 10)
+    {
+        float value = static_cast<float>(mantissa);
+        float scale = static_cast<float>(_pow10[leadingExponent < 0 ? -leadingExponent : leadingExponent]);
+        return leadingExponent < 0 ? value / scale : value * scale;
+    }
+
+    double approximation = static_cast<double>(mantissa);
+    int remainingExponent = leadingExponent;
+    while (remainingExponent > 22)
+    {
+        approximation *= _pow10[22];
+        remainingExponent -= 22;
+    }
+    while (remainingExponent < -22)
+    {
+        approximation /= _pow10[22];
+        remainingExponent += 22;
+    }
+    approximation = remainingExponent < 0 ? approximation / _pow10[-remainingExponent] : approximation * _pow10[remainingExponent];
+
+    uint32_t bits = FloatToBits(static_cast<float>(approximation));
+    if (exact && mantissa < (static_cast<uint64_t>(1) << 53) && leadingExponent >= -22 && leadingExponent <= 22 && bits < 0x7F800000)
+    {
+        // The approximation is the correctly rounded double, so rounding it to a float
+        // is only incorrect if it lies exactly halfway between two floats.
+        double value = static_cast<float>(approximation);
+        double other = approximation > value ? BitsToFloat(bits + 1) : (bits > 0 ? BitsToFloat(bits - 1) : value);
+        if (approximation == value || approximation != (value + other) * 0.5)
+        {
+            return static_cast<float>(value);
+        }
+    }
+
+    // The approximation is within a few units in the last place, so walk to the
+    // correctly rounded value using exact comparisons with the halfway points.
+    if (bits >= 0x7F800000)
+    {
+        bits = 0x7F7FFFFF;
+    }
+    while (true)
+    {
+        const uint32_t biasedExponent = bits >> 23;
+        const uint32_t significand = (biasedExponent == 0) ? (bits & 0x7FFFFF) : ((bits & 0x7FFFFF) | 0x800000);
+        const int      power = (biasedExponent == 0) ? -149 : static_cast<int>(biasedExponent) - 150;
+        const bool     odd = (significand & 1) != 0;
+
+        int upper = CompareDecimal(digits, numDigits, exponent, truncated, 2 * significand + 1, power - 1);
+        if (upper > 0 || (upper == 0 && odd))
+        {
+            ++bits;
+            if (bits == 0x7F800000)
+            {
+                break;
+            }
+            continue;
+        }
+        if (bits > 0)
+        {
+            int lower;
+            if (significand == 0x800000 && biasedExponent > 1)
+            {
+                lower = CompareDecimal(digits, numDigits, exponent, truncated, 4 * significand - 1, power - 2);
+            }
+            else
+            {
+                lower = CompareDecimal(digits, numDigits, exponent, truncated, 2 * significand - 1, power - 1);
+            }
+            if (lower < 0 || (lower == 0 && odd))
+            {
+                --bits;
+                continue;
+            }
+        }
+        break;
+    }
+
+    return BitsToFloat(bits);
+
+}
+
+/** Returns value * 10^power rounded to the nearest integer. */
+static uint64_t ScaleToInteger(double value, int power)
+{
+    for (; power > 22; power -= 22)
+    {
+        value *= _pow10[22];
+    }
+    for (; power < -22; power += 22)
+    {
+        value /= _pow10[22];
+    }
+    value = power < 0 ? value / _pow10[-power] : value * _pow10[power];
+    return static_cast<uint64_t>(value + 0.5);
+}
+
+/**
+ * Writes significand as numDigits digits, and returns true if they convert back
+ * to the value with bits. A significand of 10^numDigits is written as 1000...
+ * with the exponent increased.
+ */
+static bool GetIsRoundTrip(uint32_t bits, uint64_t significand, int numDigits, char digits[9], int& exponent)
+{
+    static const uint64_t powers[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+    if (significand < powers[numDigits - 1] || significand > powers[numDigits])
+    {
+        return false;
+    }
+    if (significand == powers[numDigits])
+    {
+        significand /= 10;
+        ++exponent;
+    }
+    for (int i = numDigits - 1; i >= 0; --i)
+    {
+        digits[i] = static_cast<char>('0' + significand % 10);
+        significand /= 10;
+    }
+    return FloatToBits(String_DecimalToFloat(digits, numDigits, exponent - (numDigits - 1), false)) == bits;
+}
+
+/**
+ * Finds the fewest significant digits which String_DecimalToFloat converts back
+ * to the (positive, finite, non-zero) value. The digits are written to digits and
+ * the exponent is that of the first digit, so the value is d.ddd * 10^exponent.
+ */
+static int GetShortestDigits(float value, char digits[9], int& exponent)
+{
+    // Find the decimal exponent from the 9 digit significand, which can't round
+    // up to the next power of ten since a float has fewer than 9 digits of
+    // precision. Rounding to fewer digits may carry into the next power, which
+    // GetIsRoundTrip handles without changing this exponent.
+    const uint32_t bits = FloatToBits(value);
+    int binaryExponent;
+    std::frexp(value, &binaryExponent);
+    exponent = ((binaryExponent - 1) * 78913) >> 18;
+    for (;;)
+    {
+        const uint64_t significand = ScaleToInteger(value, 8 - exponent);
+        if (significand >= 1000000000)
+        {
+            ++exponent;
+        }
+        else if (significand < 100000000)
+        {
+            --exponent;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // The nearest decimal with each number of digits is checked. At a power of
+    // two the interval of decimals which round to the float is narrower below
+    // it than above, so the nearest one can miss when its neighbor on the other
+    // side doesn't; there both neighbors are checked as well. A float is
+    // uniquely identified by 9 significant digits, so this always finds one.
+    static const int offsets[] = { 0, -1, 1 };
+    const int numCandidates = (bits & 0x7FFFFF) == 0 ? 3 : 1;
+    int numDigits = 1;
+    for (; numDigits <= 9; ++numDigits)
+    {
+        const uint64_t nearest = ScaleToInteger(value, numDigits - 1 - exponent);
+        int candidateExponent = exponent;
+        bool found = false;
+        for (int i = 0; i < numCandidates && !found; ++i)
+        {
+            candidateExponent = exponent;
+            found = GetIsRoundTrip(bits, nearest + offsets[i], numDigits, digits, candidateExponent);
+        }
+        if (found)
+        {
+            exponent = candidateExponent;
+            break;
+        }
+    }
+    numDigits = std::min(numDigits, 9);
+
+    while (numDigits > 1 && digits[numDigits - 1] == '0')
+    {
+        --numDigits;
+    }
+    return numDigits;
+}
+
 int String_FormatFloat(char* buffer, int bufferSize, float value)
 {
-    std::stringstream stream;
-    stream.imbue(std::locale("C"));
-    stream << value;
+    char text[32];
+    int length = 0;
 
-    const std::string str = stream.str();
-    const int length = str.length();
+    const uint32_t bits = FloatToBits(value);
+    if (bits & 0x80000000)
+    {
+        text[length++] = '-';
+    }
+
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    if (magnitude > 0x7F800000)
+    {
+        std::memcpy(text + length, "nan", 3);
+        length += 3;
+    }
+    else if (magnitude == 0x7F800000)
+    {
+        std::memcpy(text + length, "inf", 3);
+        length += 3;
+    }
+    else if (magnitude == 0)
+    {
+        text[length++] = '0';
+    }
+    else
+    {
+        char digits[9];
+        int exponent = 0;
+        const int numDigits = GetShortestDigits(BitsToFloat(magnitude), digits, exponent);
 
-    const int charsToCopy = std::min(length, bufferSize - 1);
-    std::memcpy(buffer, str.data(), charsToCopy);
-    buffer[charsToCopy] = '\0';
+        // Use the same layout as printf's %g, with enough precision for the digits.
+        if (exponent < -4 || exponent >= std::max(numDigits, 6))
+        {
+            text[length++] = digits[0];
+            if (numDigits > 1)
+            {
+                text[length++] = '.';
+                std::memcpy(text + length, digits + 1, numDigits - 1);
+                length += numDigits - 1;
+            }
+            text[length++] = 'e';
+            text[length++] = (exponent < 0) ? '-' : '+';
+            const int absExponent = (exponent < 0) ? -exponent : exponent;
+            text[length++] = static_cast<char>('0' + absExponent / 10);
+            text[length++] = static_cast<char>('0' + absExponent % 10);
+        }
+        else if (exponent < 0)
+        {
+            text[length++] = '0';
+            text[length++] = '.';
+            for (int i = -1; i > exponent; --i)
+            {
+                text[length++] = '0';
+            }
+            std::memcpy(text + length, digits, numDigits);
+            length += numDigits;
+        }
+        else
+        {
+            for (int i = 0; i <= exponent || i < numDigits; ++i)
+            {
+                if (i == exponent + 1)
+                {
+                    text[length++] = '.';
+                }
+                text[length++] = (i < numDigits) ? digits[i] : '0';
+            }
+        }
+    }
+
+    if (bufferSize > 0)
+    {
+        const int charsToCopy = std::min(length, bufferSize - 1);
+        std::memcpy(buffer, text, charsToCopy);
+        buffer[charsToCopy] = '\0';
+    }
 
     return length;
 }
@@ -18,6 +18,14 @@ double String_ToDouble(const char* buffer, char** end);
 
 int String_ToInteger(const char* buffer, char** end);
 
+/** Returns the float nearest to the decimal number digits * 10^exponent, where digits
+contains numDigits characters '0' to '9'. If truncated is true, non-zero digits were dropped
+after the end of digits. The result is correctly rounded and doesn't depend on the locale. */
+float String_DecimalToFloat(const char* digits, int numDigits, int exponent, bool truncated);
+
+/** Writes the value with the fewest significant digits which read back as exactly the same
+float, laid out like printf's %g. Doesn't depend on the locale or allocate memory. Returns
+the length of the text, which may be more than fits in the buffer. */
 int String_FormatFloat(char* buffer, int bufferSize, float value);
 
 }
@@ -1,20 +1,184 @@
 #include "StringPool.h"
+#include "Allocator.h"
+#include "Assert.h"
+
+#include <string.h>
 
 namespace M4
 {
 
 StringPool::StringPool(Allocator* allocator)
 {
+    m_allocator     = allocator;
+    m_entries       = NULL;
+    m_capacity      = 0;
+    m_numStrings    = 0;
+    m_blocks        = NULL;
+    m_blockPos      = NULL;
+    m_blockEnd      = NULL;
+}
+
+StringPool::~StringPool()
+{
+    m_allocator->Free(m_entries, sizeof(Entry) * m_capacity);
+    while (m_blocks != NULL)
+    {
+        Block* next = m_blocks->next;
+        m_allocator->Free(m_blocks, sizeof(Block) + m_blocks->size);
+        m_blocks = next;
+    }
+}
+
+unsigned int StringPool::GetHash(const char* string, size_t length)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash = (hash ^ static_cast<unsigned char>(string[i])) * 16777619u;
+    }
+    return hash;
 }
 
 const char* StringPool::AddString(const char* string)
 {
-    return m_strings.insert(string).first->c_str();
+    size_t length = strlen(string);
+    return AddString(string, length, GetHash(string, length));
+}
+
+const char* StringPool::AddString(const char* string, size_t length)
+{
+    return AddString(string, length, GetHash(string, length));
+}
+
+const char* StringPool::AddString(const char* string, size_t length, unsigned int hash)
+{
+    // Keep the table at most half full so that probe sequences stay short.
+    if ((m_numStrings + 1) * 2 > m_capacity)
+    {
+        Grow();
+    }
+
+    Entry& entry = m_entries[FindEntry(string, length, hash)];
+    if (entry.string == NULL)
+    {
+        char* copy = AllocateString(length);
+        memcpy(copy, string, length);
+        copy[length] = 0;
+
+        entry.string = copy;
+        entry.length = static_cast<unsigned int>(length);
+        entry.hash   = hash;
+        ++m_numStrings;
+    }
+    return entry.string;
+}
+
+const char* StringPool::AddExternalString(const char* string, size_t length)
+{
+    ASSERT(string[length] == 0);
+    if ((m_numStrings + 1) * 2 > m_capacity)
+    {
+        Grow();
+    }
+
+    unsigned int hash = GetHash(string, length);
+    Entry& entry = m_entries[FindEntry(string, length, hash)];
+    if (entry.string == NULL)
+    {
+        entry.string = string;
+        entry.length = static_cast<unsigned int>(length);
+        entry.hash   = hash;
+        ++m_numStrings;
+    }
+    return entry.string;
 }
 
 bool StringPool::GetContainsString(const char* string) const
 {
-    return m_strings.find(string) != m_strings.end();
+    size_t length = strlen(string);
+    return GetContainsString(string, length, GetHash(string, length));
+}
+
+bool StringPool::GetContainsString(const char* string, size_t length) const
+{
+    return GetContainsString(string, length, GetHash(string, length));
+}
+
+bool StringPool::GetContainsString(const char* string, size_t length, unsigned int hash) const
+{
+    if (m_capacity == 0)
+    {
+        return false;
+    }
+    return m_entries[FindEntry(string, length, hash)].string != NULL;
+}
+
+int StringPool::GetNumStrings() const
+{
+    return static_cast<int>(m_numStrings);
+}
+
+unsigned int StringPool::FindEntry(const char* string, size_t length, unsigned int hash) const
+{
+    // Linear probing; returns the matching entry or the empty entry where the
+    // string would be inserted.
+    unsigned int mask  = m_capacity - 1;
+    unsigned int index = hash & mask;
+    while (true)
+    {
+        const Entry& entry = m_entries[index];
+        if (entry.string == NULL)
+        {
+            return index;
+        }
+        if (entry.hash == hash && entry.length == length && memcmp(entry.string, string, length) == 0)
+        {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+void StringPool::Grow()
+{
+    Entry*       oldEntries  = m_entries;
+    unsigned int oldCapacity = m_capacity;
+
+    m_capacity = (oldCapacity == 0) ? 256 : oldCapacity * 2;
+    m_entries  = static_cast<Entry*>(m_allocator->Allocate(sizeof(Entry) * m_capacity, AlignOf<Entry>::value));
+    memset(m_entries, 0, sizeof(Entry) * m_capacity);
+
+    // Only the entries are moved; the strings themselves stay where they are.
+    for (unsigned int i = 0; i < oldCapacity; ++i)
+    {
+        const Entry& entry = oldEntries[i];
+        if (entry.string != NULL)
+        {
+            m_entries[FindEntry(entry.string, entry.length, entry.hash)] = entry;
+        }
+    }
+
+    m_allocator->Free(oldEntries, sizeof(Entry) * oldCapacity);
+}
+
+char* StringPool::AllocateString(size_t length)
+{
+    size_t size = length + 1;
+    if (size > static_cast<size_t>(m_blockEnd - m_blockPos))
+    {
+        size_t blockSize = (size > s_blockSize) ? size : s_blockSize;
+        Block* block = static_cast<Block*>(m_allocator->Allocate(sizeof(Block) + blockSize, AlignOf<Block>::value));
+        block->next = m_blocks;
+        block->size = blockSize;
+        m_blocks = block;
+
+        m_blockPos = reinterpret_cast<char*>(block + 1);
+        m_blockEnd = m_blockPos + blockSize;
+    }
+    char* result = m_blockPos;
+    m_blockPos += size;
+    return result;
 }
 
 }
@@ -1,27 +1,80 @@
 #ifndef ENGINE_STRING_POOL_H
 #define ENGINE_STRING_POOL_H
 
-#include <set>
-#include <string>
+#include <stddef.h>
 
 namespace M4
 {
 
 class Allocator;
 
+/**
+ * Interns strings so that they can be compared by pointer. The strings are
+ * copied into large blocks and never move, and are indexed by an open
+ * addressing hash table.
+ */
 class StringPool
 {
 
 public:
 
-    StringPool(Allocator* allocator);
+    explicit StringPool(Allocator* allocator);
+    ~StringPool();
+
+    /** Returns the hash of a string. This can be computed ahead of time and passed
+    into the functions below to avoid hashing the same string more than once. */
+    static unsigned int GetHash(const char* string, size_t length);
 
     const char* AddString(const char* string);
+    const char* AddString(const char* string, size_t length);
+    const char* AddString(const char* string, size_t length, unsigned int hash);
+
+    /** Interns a null terminated string which outlives the pool without copying
+    it. Returns the string already in the pool if there is one. */
+    const char* AddExternalString(const char* string, size_t length);
+
     bool GetContainsString(const char* string) const;
+    bool GetContainsString(const char* string, size_t length) const;
+    bool GetContainsString(const char* string, size_t length, unsigned int hash) const;
+
+    int GetNumStrings() const;
 
 private:
 
-    std::set<std::string> m_strings;
+    struct Entry
+    {
+        const char*     string;
+        unsigned int    length;
+        unsigned int    hash;
+    };
+
+    struct Block
+    {
+        Block*          next;
+        size_t          size;
+    };
+
+    // Not copyable, since the table refers into the blocks.
+    StringPool(const StringPool&);
+    StringPool& operator=(const StringPool&);
+
+    unsigned int FindEntry(const char* string, size_t length, unsigned int hash) const;
+    void Grow();
+    char* AllocateString(size_t length);
+
+private:
+
+    static const size_t s_blockSize = 16 * 1024;
+
+    Allocator*      m_allocator;
+
+    Entry*          m_entries;
+    unsigned int    m_capacity;     // Always 0 or a power of two.
+    unsigned int    m_numStrings;
+
+    Block*          m_blocks;
+    char*           m_blockPos;
+    char*           m_blockEnd;
 
 };
 
@@ -0,0 +1,141 @@
+#include "Thread.h"
+#include "Assert.h"
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace M4
+{
+
+Thread::Thread()
+{
+    m_function  = NULL;
+    m_data      = NULL;
+    m_started   = false;
+#if defined(_WIN32)
+    m_handle    = NULL;
+#endif
+}
+
+Thread::~Thread()
+{
+    ASSERT(!m_started);
+}
+
+bool Thread::Start(ThreadFunction function, void* data)
+{
+    ASSERT(!m_started);
+    m_function = function;
+    m_data     = data;
+#if defined(_WIN32)
+    m_handle   = CreateThread(NULL, 0, Run, this, 0, NULL);
+    m_started  = (m_handle != NULL);
+#else
+    m_started  = (pthread_create(&m_handle, NULL, Run, this) == 0);
+#endif
+    return m_started;
+}
+
+void Thread::Join()
+{
+    if (m_started)
+    {
+#if defined(_WIN32)
+        WaitForSingleObject(m_handle, INFINITE);
+        CloseHandle(m_handle);
+        m_handle = NULL;
+#else
+        pthread_join(m_handle, NULL);
+#endif
+        m_started = false;
+    }
+}
+
+#if defined(_WIN32)
+unsigned long __stdcall Thread::Run(void* thread)
+{
+    Thread* self = static_cast<Thread*>(thread);
+    self->m_function(self->m_data);
+    return 0;
+}
+#else
+void* Thread::Run(void* thread)
+{
+    Thread* self = static_cast<Thread*>(thread);
+    self->m_function(self->m_data);
+    return NULL;
+}
+#endif
+
+Mutex::Mutex()
+{
+#if defined(_WIN32)
+    InitializeSRWLock(reinterpret_cast<PSRWLOCK>(&m_lock));
+#else
+    pthread_mutex_init(&m_mutex, NULL);
+#endif
+}
+
+Mutex::~Mutex()
+{
+#if !defined(_WIN32)
+    pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+void Mutex::Lock()
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(reinterpret_cast<PSRWLOCK>(&m_lock));
+#else
+    pthread_mutex_lock(&m_mutex);
+#endif
+}
+
+void Mutex::Unlock()
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(reinterpret_cast<PSRWLOCK>(&m_lock));
+#else
+    pthread_mutex_unlock(&m_mutex);
+#endif
+}
+
+int Thread_GetNumProcessors()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int numProcessors = static_cast<int>(info.dwNumberOfProcessors);
+#else
+    int numProcessors = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+    return (numProcessors > 0) ? numProcessors : 1;
+}
+
+uint64_t Thread_GetCurrentId()
+{
+#if defined(_WIN32)
+    return GetCurrentThreadId();
+#elif defined(__linux__)
+    // Matches the ids shown by other tools, such as top and perf.
+    return static_cast<uint64_t>(syscall(SYS_gettid));
+#elif defined(__APPLE__)
+    uint64_t id = 0;
+    pthread_threadid_np(NULL, &id);
+    return id;
+#else
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pthread_self()));
+#endif
+}
+
+}
@@ -0,0 +1,95 @@
+#ifndef ENGINE_THREAD_H
+#define ENGINE_THREAD_H
+
+#include <stdint.h>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+namespace M4
+{
+
+typedef void (*ThreadFunction)(void* data);
+
+/** Minimal wrapper around the platform threads. */
+class Thread
+{
+
+public:
+
+    Thread();
+
+    /** The thread must be joined before it's destroyed. */
+    ~Thread();
+
+    /** Starts running the function on a new thread. Returns false if the thread
+    couldn't be created. */
+    bool Start(ThreadFunction function, void* data);
+
+    /** Waits for the thread to finish. */
+    void Join();
+
+private:
+
+    // Not copyable.
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+
+#if defined(_WIN32)
+    static unsigned long __stdcall Run(void* thread);
+#else
+    static void* Run(void* thread);
+#endif
+
+private:
+
+    ThreadFunction  m_function;
+    void*           m_data;
+    bool            m_started;
+
+#if defined(_WIN32)
+    void*           m_handle;
+#else
+    pthread_t       m_handle;
+#endif
+
+};
+
+class Mutex
+{
+
+public:
+
+    Mutex();
+    ~Mutex();
+
+    void Lock();
+    void Unlock();
+
+private:
+
+    // Not copyable.
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+
+private:
+
+#if defined(_WIN32)
+    void*           m_lock;     // SRWLOCK
+#else
+    pthread_mutex_t m_mutex;
+#endif
+
+};
+
+/** Returns the number of processors available to run threads (at least 1). */
+int Thread_GetNumProcessors();
+
+/** Returns an identifier for the calling thread, which is unique among the
+threads currently running in the process. */
+uint64_t Thread_GetCurrentId();
+
+}
+
+#endif
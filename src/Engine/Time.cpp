@@ -0,0 +1,34 @@
+#include "Time.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace M4
+{
+
+uint64_t Time_GetNanoseconds()
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // Split the conversion so that it doesn't overflow.
+    uint64_t ticks          = static_cast<uint64_t>(counter.QuadPart);
+    uint64_t ticksPerSecond = static_cast<uint64_t>(frequency.QuadPart);
+    return (ticks / ticksPerSecond) * 1000000000 + (ticks % ticksPerSecond) * 1000000000 / ticksPerSecond;
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+#endif
+}
+
+}
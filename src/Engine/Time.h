@@ -0,0 +1,15 @@
+#ifndef ENGINE_TIME_H
+#define ENGINE_TIME_H
+
+#include <stdint.h>
+
+namespace M4
+{
+
+/** Returns a monotonic time in nanoseconds, only meaningful for measuring
+intervals. */
+uint64_t Time_GetNanoseconds();
+
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "Trace.h"
+#include "Assert.h"
+#include "Time.h"
+
+#include <stdio.h>
+
+namespace M4
+{
+
+static void WriteJsonString(FILE* file, const char* string)
+{
+    fputc('"', file);
+    for (const char* c = string; *c != 0; ++c)
+    {
+        unsigned char value = static_cast<unsigned char>(*c);
+        if (value == '"' || value == '\\')
+        {
+            fputc('\\', file);
+            fputc(value, file);
+        }
+        else if (value < 0x20)
+        {
+            fprintf(file, "\\u%04x", value);
+        }
+        else
+        {
+            fputc(value, file);
+        }
+    }
+    fputc('"', file);
+}
+
+TraceWriter::TraceWriter(Allocator* allocator) :
+    m_events(allocator),
+    m_strings(allocator)
+{
+    m_startTime = Time_GetNanoseconds();
+}
+
+void TraceWriter::SetThreadName(const char* name)
+{
+    m_mutex.Lock();
+    Event& event = m_events.PushBackNew();
+    event.name          = NULL;
+    event.thread        = Thread_GetCurrentId();
+    event.startTime     = 0;
+    event.duration      = 0;
+    event.numArgs       = 1;
+    event.argName[0]    = "name";
+    event.argValue[0]   = m_strings.AddString(name);
+    m_mutex.Unlock();
+}
+
+void TraceWriter::AddSpan(const char* name, uint64_t startTime, uint64_t endTime, int numArgs, const char* const argNames[], const char* const argValues[])
+{
+    ASSERT(numArgs <= s_maxArgs);
+    uint64_t thread = Thread_GetCurrentId();
+
+    m_mutex.Lock();
+    Event& event = m_events.PushBackNew();
+    event.name      = name;
+    event.thread    = thread;
+    event.startTime = (startTime > m_startTime) ? startTime - m_startTime : 0;
+    event.duration  = (endTime > startTime) ? endTime - startTime : 0;
+    event.numArgs   = numArgs;
+    for (int i = 0; i < numArgs; ++i)
+    {
+        event.argName[i]  = argNames[i];
+        event.argValue[i] = m_strings.AddString(argValues[i]);
+    }
+    m_mutex.Unlock();
+}
+
+bool TraceWriter::Save(const char* fileName)
+{
+    FILE* file = fopen(fileName, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    m_mutex.Lock();
+
+    // Complete ("X") events take a start and a duration in microseconds, which
+    // keeps the file about half the size of matching begin and end events.
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (int i = 0; i < m_events.GetSize(); ++i)
+    {
+        const Event& event = m_events[i];
+        if (event.name == NULL)
+        {
+            fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%llu",
+                static_cast<unsigned long long>(event.thread));
+        }
+        else
+        {
+            fprintf(file, "{\"ph\":\"X\",\"name\":");
+            WriteJsonString(file, event.name);
+            fprintf(file, ",\"pid\":1,\"tid\":%llu,\"ts\":%llu.%03u,\"dur\":%llu.%03u",
+                static_cast<unsigned long long>(event.thread),
+                static_cast<unsigned long long>(event.startTime / 1000), static_cast<unsigned int>(event.startTime % 1000),
+                static_cast<unsigned long long>(event.duration / 1000), static_cast<unsigned int>(event.duration % 1000));
+        }
+        if (event.numArgs > 0)
+        {
+            fprintf(file, ",\"args\":{");
+            for (int j = 0; j < event.numArgs; ++j)
+            {
+                if (j > 0)
+                {
+                    fputc(',', file);
+                }
+                WriteJsonString(file, event.argName[j]);
+                fputc(':', file);
+                WriteJsonString(file, event.argValue[j]);
+            }
+            fputc('}', file);
+        }
+        fprintf(file, (i + 1 < m_events.GetSize()) ? "},\n" : "}\n");
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    m_mutex.Unlock();
+
+    bool result = (ferror(file) == 0);
+    if (fclose(file) != 0)
+    {
+        result = false;
+    }
+    return result;
+}
+
+TraceScope::TraceScope(TraceWriter* writer, const char* name)
+{
+    m_writer    = writer;
+    m_name      = name;
+    m_startTime = (writer != NULL) ? Time_GetNanoseconds() : 0;
+    m_numArgs   = 0;
+}
+
+TraceScope::~TraceScope()
+{
+    if (m_writer != NULL)
+    {
+        m_writer->AddSpan(m_name, m_startTime, Time_GetNanoseconds(), m_numArgs, m_argName, m_argValue);
+    }
+}
+
+void TraceScope::AddArg(const char* name, const char* value)
+{
+    ASSERT(m_numArgs < TraceWriter::s_maxArgs);
+    if (m_writer != NULL && m_numArgs < TraceWriter::s_maxArgs)
+    {
+        m_argName[m_numArgs]  = name;
+        m_argValue[m_numArgs] = value;
+        ++m_numArgs;
+    }
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef ENGINE_TRACE_H
+#define ENGINE_TRACE_H
+
+#include "Array.h"
+#include "StringPool.h"
+#include "Thread.h"
+
+#include <stdint.h>
+
+namespace M4
+{
+
+class Allocator;
+
+/**
+ * Records timed spans from any number of threads and saves them in the Chrome
+ * trace event format, which can be loaded into chrome://tracing or Perfetto.
+ * The events are kept in memory until the trace is saved, so recording one
+ * doesn't touch the disk.
+ */
+class TraceWriter
+{
+
+public:
+
+    static const int s_maxArgs = 4;
+
+    /** The allocator is only used while holding the writer's lock, so it must
+    not be used by anything else while spans are being recorded. */
+    explicit TraceWriter(Allocator* allocator);
+
+    /** Names the calling thread in the trace. */
+    void SetThreadName(const char* name);
+
+    /** Records a span on the calling thread. The times are from Time_GetNanoseconds.
+    The event and argument names must remain valid until the trace is saved, but
+    the values are copied. */
+    void AddSpan(const char* name, uint64_t startTime, uint64_t endTime, int numArgs, const char* const argNames[], const char* const argValues[]);
+
+    /** Writes the trace to a file. Returns false if it couldn't be written. */
+    bool Save(const char* fileName);
+
+private:
+
+    struct Event
+    {
+        const char*     name;           // NULL for a thread name.
+        uint64_t        thread;
+        uint64_t        startTime;
+        uint64_t        duration;
+        int             numArgs;
+        const char*     argName[s_maxArgs];
+        const char*     argValue[s_maxArgs];
+    };
+
+    // Not copyable.
+    TraceWriter(const TraceWriter&);
+    TraceWriter& operator=(const TraceWriter&);
+
+private:
+
+    Mutex           m_mutex;
+    Array<Event>    m_events;       // Guarded by m_mutex.
+    StringPool      m_strings;      // Guarded by m_mutex.
+    uint64_t        m_startTime;
+
+};
+
+/**
+ * Records a span covering the lifetime of the object. Does nothing if the
+ * writer is NULL.
+ */
+class TraceScope
+{
+
+public:
+
+    TraceScope(TraceWriter* writer, const char* name);
+    ~TraceScope();
+
+    /** Attaches a value to the span, such as the file being processed. The
+    strings must remain valid until the scope ends. */
+    void AddArg(const char* name, const char* value);
+
+private:
+
+    // Not copyable.
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+private:
+
+    TraceWriter*    m_writer;
+    const char*     m_name;
+    uint64_t        m_startTime;
+    int             m_numArgs;
+    const char*     m_argName[TraceWriter::s_maxArgs];
+    const char*     m_argValue[TraceWriter::s_maxArgs];
+
+};
+
+}
+
+#endif
@@ -14,24 +14,26 @@
 #include "GLSLGenerator.h"
 #include "HLSLParser.h"
 #include "HLSLTree.h"
+#include "HLSLTreeAccessor.h"
 
+#include <ctype.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 
 namespace M4
 {
 
-static const HLSLType kBoolType(HLSLBaseType_Bool);
-
 // http://www.opengl.org/registry/doc/GLSLangSpec.Full.1.40.08.pdf
 
-static const char* _builtInSemantics[] = 
+static const char* const _builtInSemantics[] = 
     {
         "SV_POSITION",  "gl_Position",
         "DEPTH",        "gl_FragDepth",
     };
 
 // These are reserved words in GLSL that aren't reserved in HLSL.
-const char* GLSLGenerator::s_reservedWord[] =
+const char* const GLSLGenerator::s_reservedWord[] =
     {
         "output",
         "input",
@@ -40,7 +42,8 @@ const char* GLSLGenerator::s_reservedWord[] =
         "fract"
     };
 
-static const char* GetTypeName(const HLSLType& type)
+template<typename Type>
+static const char* GetTypeName(const Type& type)
 {
     switch (type.baseType)
     {
@@ -75,7 +78,8 @@ static const char* GetTypeName(const HLSLType& type)
     return "?";
 }
 
-static bool GetCanImplicitCast(const HLSLType& srcType, const HLSLType& dstType)
+template<typename Type>
+static bool GetCanImplicitCast(const Type& srcType, const Type& dstType)
 {
     return srcType.baseType == dstType.baseType;
 }
@@ -93,17 +97,18 @@ static const char* GetBuiltInSemantic(const char* semantic)
     return NULL;
 }
 
-static int GetFunctionArguments(HLSLFunctionCall* functionCall, HLSLExpression* expression[], int maxArguments)
+template<typename Tree>
+static int GetFunctionArguments(const Tree& tree, typename Tree::Node functionCall, typename Tree::Node expression[], int maxArguments)
 {
-    HLSLExpression* argument = functionCall->argument;
+    typename Tree::Node argument = tree.GetCallArguments(functionCall);
     int numArguments = 0;
-    while (argument != NULL)
+    while (argument)
     {
         if (numArguments < maxArguments)
         {
             expression[numArguments] = argument;
         }
-        argument = argument->nextExpression;
+        argument = tree.GetNextExpression(argument);
         ++numArguments;
     }
     return numArguments;
@@ -112,7 +117,7 @@ static int GetFunctionArguments(HLSLFunctionCall* functionCall, HLSLExpression*
 GLSLGenerator::GLSLGenerator(Allocator* allocator) :
     m_writer(allocator)
 {
-    m_tree                      = NULL;
+    m_instrumentation           = NULL;
     m_entryName                 = NULL;
     m_target                    = Target_VertexShader;
     m_inAttribPrefix            = NULL;
@@ -131,32 +136,43 @@ GLSLGenerator::GLSLGenerator(Allocator* allocator) :
 
 bool GLSLGenerator::Generate(const HLSLTree* tree, Target target, const char* entryName)
 {
+    return GenerateTree(HLSLTreeAccessor(tree), target, entryName);
+}
+
+bool GLSLGenerator::Generate(const HLSLCompactTree* tree, Target target, const char* entryName)
+{
+    return GenerateTree(HLSLCompactTreeAccessor(tree), target, entryName);
+}
+
+template<typename Tree>
+bool GLSLGenerator::GenerateTree(const Tree& tree, Target target, const char* entryName)
+{
+    HLSLPhaseScope phase(m_instrumentation, HLSLPhase_Generate);
 
-    m_tree      = tree;
     m_entryName = entryName;
     m_target    = target;
 
     
-    bool usesClip = m_tree->GetContainsString("clip");
-    bool usesTex2Dlod = m_tree->GetContainsString("tex2Dlod");
-    bool usestexCUBEbias = m_tree->GetContainsString("texCUBEbias");
-    bool usesSinCos = m_tree->GetContainsString("sincos");
+    bool usesClip = tree.GetContainsString("clip");
+    bool usesTex2Dlod = tree.GetContainsString("tex2Dlod");
+    bool usestexCUBEbias = tree.GetContainsString("texCUBEbias");
+    bool usesSinCos = tree.GetContainsString("sincos");
 
-    ChooseUniqueName("matrix_row", m_matrixRowFunction, sizeof(m_matrixRowFunction));
-    ChooseUniqueName("clip", m_clipFunction, sizeof(m_clipFunction));
-    ChooseUniqueName("tex2Dlod", m_tex2DlodFunction, sizeof(m_tex2DlodFunction));
-    ChooseUniqueName("texCUBEbias", m_texCUBEbiasFunction, sizeof(m_texCUBEbiasFunction));
+    ChooseUniqueName(tree, "matrix_row", m_matrixRowFunction, sizeof(m_matrixRowFunction));
+    ChooseUniqueName(tree, "clip", m_clipFunction, sizeof(m_clipFunction));
+    ChooseUniqueName(tree, "tex2Dlod", m_tex2DlodFunction, sizeof(m_tex2DlodFunction));
+    ChooseUniqueName(tree, "texCUBEbias", m_texCUBEbiasFunction, sizeof(m_texCUBEbiasFunction));
 
     for (int i = 0; i < s_numReservedWords; ++i)
     {
-        ChooseUniqueName( s_reservedWord[i], m_reservedWord[i], sizeof(m_reservedWord[i]) );
+        ChooseUniqueName(tree, s_reservedWord[i], m_reservedWord[i], sizeof(m_reservedWord[i]) );
     }
 
-    ChooseUniqueName("m_scalar_swizzle2", m_scalarSwizzle2Function, sizeof(m_scalarSwizzle2Function));
-    ChooseUniqueName("m_scalar_swizzle3", m_scalarSwizzle3Function, sizeof(m_scalarSwizzle3Function));
-    ChooseUniqueName("m_scalar_swizzle4", m_scalarSwizzle4Function, sizeof(m_scalarSwizzle4Function));
+    ChooseUniqueName(tree, "m_scalar_swizzle2", m_scalarSwizzle2Function, sizeof(m_scalarSwizzle2Function));
+    ChooseUniqueName(tree, "m_scalar_swizzle3", m_scalarSwizzle3Function, sizeof(m_scalarSwizzle3Function));
+    ChooseUniqueName(tree, "m_scalar_swizzle4", m_scalarSwizzle4Function, sizeof(m_scalarSwizzle4Function));
 
-    ChooseUniqueName("sincos", m_sinCosFunction, sizeof(m_sinCosFunction));
+    ChooseUniqueName(tree, "sincos", m_sinCosFunction, sizeof(m_sinCosFunction));
 
     if (target == Target_VertexShader)
     {
@@ -169,12 +185,9 @@ bool GLSLGenerator::Generate(const HLSLTree* tree, Target target, const char* en
         m_outAttribPrefix = "rast_";
     }
 
-    HLSLRoot* root = m_tree->GetRoot();
-    HLSLStatement* statement = root->statement;
-
     // Find the entry point function.
-    HLSLFunction* entryFunction = FindFunction(root, m_entryName);
-    if (entryFunction == NULL)
+    typename Tree::Node entryFunction = FindFunction(tree, m_entryName);
+    if (!entryFunction)
     {
         Error("Entry point '%s' doesn't exist", m_entryName);
         return false;
@@ -246,11 +259,9 @@ bool GLSLGenerator::Generate(const HLSLTree* tree, Target target, const char* en
         }
     }
 
-    OutputAttributes(entryFunction);
-    OutputStatements(0, statement);
-    OutputEntryCaller(entryFunction);
-
-    m_tree = NULL;
+    OutputAttributes(tree, entryFunction);
+    OutputStatements(tree, 0, tree.GetRootStatements());
+    OutputEntryCaller(tree, entryFunction);
 
     // The GLSL compilers don't check for this, so generate our own error message.
     if (target == Target_VertexShader && !m_outputPosition)
@@ -258,6 +269,11 @@ bool GLSLGenerator::Generate(const HLSLTree* tree, Target target, const char* en
         Error("Vertex shader must output a position");
     }
 
+    if (!m_writer.Flush())
+    {
+        Error("Couldn't write the output");
+    }
+
     return !m_error;
 
 }
@@ -267,34 +283,51 @@ const char* GLSLGenerator::GetResult() const
     return m_writer.GetResult();
 }
 
-void GLSLGenerator::OutputExpressionList(HLSLExpression* expression, HLSLArgument* argument)
+void GLSLGenerator::SetSink(CodeSink* sink)
+{
+    m_writer.SetSink(sink);
+}
+
+void GLSLGenerator::SetInstrumentation(HLSLInstrumentation* instrumentation)
+{
+    m_instrumentation = instrumentation;
+}
+
+template<typename Tree>
+void GLSLGenerator::OutputExpressionList(const Tree& tree, typename Tree::Node expression, typename Tree::Node argument)
 {
     int numExpressions = 0;
-    while (expression != NULL)
+    while (expression)
     {
         if (numExpressions > 0)
         {
-            m_writer.Write(", ");
+            m_writer.WriteText(", ");
         }
         
-        HLSLType* expectedType = NULL;
-        if (argument != NULL)
+        typename Tree::Type argumentType;
+        const typename Tree::Type* expectedType = NULL;
+        if (argument)
         {
-            expectedType = &argument->type;
-            argument = argument->nextArgument;
+            argumentType = tree.GetArgumentType(argument);
+            expectedType = &argumentType;
+            argument = tree.GetNextArgument(argument);
         }
 
-        OutputExpression(expression, expectedType);
-        expression = expression->nextExpression;
+        OutputExpression(tree, expression, expectedType);
+        expression = tree.GetNextExpression(expression);
         ++numExpressions;
     }
 }
 
-void GLSLGenerator::OutputExpression(HLSLExpression* expression, const HLSLType* dstType)
+template<typename Tree>
+void GLSLGenerator::OutputExpression(const Tree& tree, typename Tree::Node expression, const typename Tree::Type* dstType)
 {
 
-    bool cast = dstType != NULL && !GetCanImplicitCast(expression->expressionType, *dstType);
-    if (expression->nodeType == HLSLNodeType_CastingExpression)
+    HLSLNodeType nodeType = tree.GetNodeType(expression);
+    const typename Tree::Type& expressionType = tree.GetExpressionType(expression);
+
+    bool cast = dstType != NULL && !GetCanImplicitCast(expressionType, *dstType);
+    if (nodeType == HLSLNodeType_CastingExpression)
     {
         // No need to include a cast if the expression is already doing it.
         cast = false;
@@ -302,95 +335,85 @@ void GLSLGenerator::OutputExpression(HLSLExpression* expression, const HLSLType*
 
     if (cast)
     {
-        OutputDeclaration(*dstType, "");
-        m_writer.Write("(");
+        OutputDeclaration(tree, *dstType, "");
+        m_writer.WriteText("(");
     }
 
-    if (expression->nodeType == HLSLNodeType_IdentifierExpression)
+    if (nodeType == HLSLNodeType_IdentifierExpression)
     {
-        HLSLIdentifierExpression* identifierExpression = static_cast<HLSLIdentifierExpression*>(expression);
-        const char* name = identifierExpression->name;
+        const char* name = tree.GetIdentifierName(expression);
         OutputIdentifier(name);
     }
-    else if (expression->nodeType == HLSLNodeType_ConstructorExpression)
+    else if (nodeType == HLSLNodeType_ConstructorExpression)
     {
-        HLSLConstructorExpression* constructorExpression = static_cast<HLSLConstructorExpression*>(expression);
-        m_writer.Write("%s(", GetTypeName(constructorExpression->type));
-        OutputExpressionList(constructorExpression->argument);
-        m_writer.Write(")");
+        m_writer.WriteText(GetTypeName(tree.GetConstructorType(expression)));
+        m_writer.WriteText("(");
+        OutputExpressionList(tree, tree.GetConstructorArguments(expression));
+        m_writer.WriteText(")");
     }
-    else if (expression->nodeType == HLSLNodeType_CastingExpression)
+    else if (nodeType == HLSLNodeType_CastingExpression)
     {
-        HLSLCastingExpression* castingExpression = static_cast<HLSLCastingExpression*>(expression);
-        OutputDeclaration(castingExpression->type, "");
-        m_writer.Write("(");
-        OutputExpression(castingExpression->expression);
-        m_writer.Write(")");
+        OutputDeclaration(tree, tree.GetCastType(expression), "");
+        m_writer.WriteText("(");
+        OutputExpression(tree, tree.GetCastOperand(expression));
+        m_writer.WriteText(")");
     }
-    else if (expression->nodeType == HLSLNodeType_LiteralExpression)
+    else if (nodeType == HLSLNodeType_LiteralExpression)
     {
-        HLSLLiteralExpression* literalExpression = static_cast<HLSLLiteralExpression*>(expression);
-        switch (literalExpression->type)
+        switch (tree.GetLiteralType(expression))
         {
         case HLSLBaseType_Half:
         case HLSLBaseType_Float:
-            {
-                // Don't use printf directly so that we don't use the system locale.
-                char buffer[64];
-                String_FormatFloat(buffer, sizeof(buffer), literalExpression->fValue);
-                m_writer.Write("%s", buffer);
-            }
+            m_writer.WriteFloat(tree.GetLiteralFloat(expression));
             break;
         case HLSLBaseType_Int:
         case HLSLBaseType_Uint:
-            m_writer.Write("%d", literalExpression->iValue);
+            m_writer.WriteInt(tree.GetLiteralInt(expression));
             break;
         case HLSLBaseType_Bool:
-            m_writer.Write("%s", literalExpression->bValue ? "true" : "false");
+            m_writer.WriteText(tree.GetLiteralBool(expression) ? "true" : "false");
             break;
         default:
             ASSERT(0);
         }
     }
-    else if (expression->nodeType == HLSLNodeType_UnaryExpression)
+    else if (nodeType == HLSLNodeType_UnaryExpression)
     {
-        HLSLUnaryExpression* unaryExpression = static_cast<HLSLUnaryExpression*>(expression);
         const char* op = "?";
         bool pre = true;
-        const HLSLType* dstType = NULL;
-        switch (unaryExpression->unaryOp)
+        const typename Tree::Type* dstType = NULL;
+        switch (tree.GetUnaryOp(expression))
         {
         case HLSLUnaryOp_Negative:      op = "-";  break;
         case HLSLUnaryOp_Positive:      op = "+";  break;
-        case HLSLUnaryOp_Not:           op = "!";  dstType = &unaryExpression->expressionType; break;
+        case HLSLUnaryOp_Not:           op = "!";  dstType = &expressionType; break;
         case HLSLUnaryOp_PreIncrement:  op = "++"; break;
         case HLSLUnaryOp_PreDecrement:  op = "++"; break;
         case HLSLUnaryOp_PostIncrement: op = "++"; pre = false; break;
         case HLSLUnaryOp_PostDecrement: op = "--"; pre = false; break;
         }
-        m_writer.Write("(");
+        m_writer.WriteText("(");
         if (pre)
         {
-            m_writer.Write("%s", op);
-            OutputExpression(unaryExpression->expression, dstType);
+            m_writer.WriteText(op);
+            OutputExpression(tree, tree.GetUnaryOperand(expression), dstType);
         }
         else
         {
-            OutputExpression(unaryExpression->expression, dstType);
-            m_writer.Write("%s", op);
+            OutputExpression(tree, tree.GetUnaryOperand(expression), dstType);
+            m_writer.WriteText(op);
         }
-        m_writer.Write(")");
+        m_writer.WriteText(")");
     }
-    else if (expression->nodeType == HLSLNodeType_BinaryExpression)
+    else if (nodeType == HLSLNodeType_BinaryExpression)
     {
-        HLSLBinaryExpression* binaryExpression = static_cast<HLSLBinaryExpression*>(expression);
         const char* op = "?";
-        const HLSLType* dstType1 = NULL;
-        const HLSLType* dstType2 = NULL;
-        switch (binaryExpression->binaryOp)
+        const typename Tree::Type* dstType1 = NULL;
+        const typename Tree::Type* dstType2 = NULL;
+        switch (tree.GetBinaryOp(expression))
         {
-        case HLSLBinaryOp_Add:          op = " + "; dstType1 = dstType2 = &binaryExpression->expressionType; break;
-        case HLSLBinaryOp_Sub:          op = " - "; dstType1 = dstType2 = &binaryExpression->expressionType; break;
+        case HLSLBinaryOp_Add:          op = " + "; dstType1 = dstType2 = &expressionType; break;
+        case HLSLBinaryOp_Sub:          op = " - "; dstType1 = dstType2 = &expressionType; break;
         case HLSLBinaryOp_Mul:          op = " * "; break;
         case HLSLBinaryOp_Div:          op = " / "; break;
         case HLSLBinaryOp_Less:         op = " < "; break;
@@ -399,74 +422,76 @@ void GLSLGenerator::OutputExpression(HLSLExpression* expression, const HLSLType*
         case HLSLBinaryOp_GreaterEqual: op = " >= "; break;
         case HLSLBinaryOp_Equal:        op = " == "; break;
         case HLSLBinaryOp_NotEqual:     op = " != "; break;
-        case HLSLBinaryOp_Assign:       op = " = ";  dstType2 = &binaryExpression->expressionType; break;
-        case HLSLBinaryOp_AddAssign:    op = " += "; dstType2 = &binaryExpression->expressionType; break;
-        case HLSLBinaryOp_SubAssign:    op = " -= "; dstType2 = &binaryExpression->expressionType; break;
-        case HLSLBinaryOp_MulAssign:    op = " *= "; dstType2 = &binaryExpression->expressionType; break;
-        case HLSLBinaryOp_DivAssign:    op = " /= "; dstType2 = &binaryExpression->expressionType; break;
-        case HLSLBinaryOp_And:          op = " && "; dstType1 = dstType2 = &binaryExpression->expressionType; break;
-        case HLSLBinaryOp_Or:           op = " || "; dstType1 = dstType2 = &binaryExpression->expressionType; break;
+        case HLSLBinaryOp_Assign:       op = " = ";  dstType2 = &expressionType; break;
+        case HLSLBinaryOp_AddAssign:    op = " += "; dstType2 = &expressionType; break;
+        case HLSLBinaryOp_SubAssign:    op = " -= "; dstType2 = &expressionType; break;
+        case HLSLBinaryOp_MulAssign:    op = " *= "; dstType2 = &expressionType; break;
+        case HLSLBinaryOp_DivAssign:    op = " /= "; dstType2 = &expressionType; break;
+        case HLSLBinaryOp_And:          op = " && "; dstType1 = dstType2 = &expressionType; break;
+        case HLSLBinaryOp_Or:           op = " || "; dstType1 = dstType2 = &expressionType; break;
         default:
             ASSERT(0);
         }
-        m_writer.Write("(");
-        OutputExpression(binaryExpression->expression1, dstType1);
-        m_writer.Write("%s", op);
-        OutputExpression(binaryExpression->expression2, dstType2);
-        m_writer.Write(")");
+        m_writer.WriteText("(");
+        OutputExpression(tree, tree.GetBinaryOperand1(expression), dstType1);
+        m_writer.WriteText(op);
+        OutputExpression(tree, tree.GetBinaryOperand2(expression), dstType2);
+        m_writer.WriteText(")");
     }
-    else if (expression->nodeType == HLSLNodeType_ConditionalExpression)
+    else if (nodeType == HLSLNodeType_ConditionalExpression)
     {
-        HLSLConditionalExpression* conditionalExpression = static_cast<HLSLConditionalExpression*>(expression);
-        m_writer.Write("((");
-        OutputExpression(conditionalExpression->condition, &kBoolType);
-        m_writer.Write(")?(");
-        OutputExpression(conditionalExpression->trueExpression);
-        m_writer.Write("):(");
-        OutputExpression(conditionalExpression->falseExpression);
-        m_writer.Write("))");
+        const typename Tree::Type boolType(HLSLBaseType_Bool);
+        m_writer.WriteText("((");
+        OutputExpression(tree, tree.GetConditionalCondition(expression), &boolType);
+        m_writer.WriteText(")?(");
+        OutputExpression(tree, tree.GetConditionalTrue(expression));
+        m_writer.WriteText("):(");
+        OutputExpression(tree, tree.GetConditionalFalse(expression));
+        m_writer.WriteText("))");
     }
-    else if (expression->nodeType == HLSLNodeType_MemberAccess)
+    else if (nodeType == HLSLNodeType_MemberAccess)
     {
 
-        HLSLMemberAccess* memberAccess = static_cast<HLSLMemberAccess*>(expression);
+        typename Tree::Node object = tree.GetMemberObject(expression);
+        const char* field = tree.GetMemberField(expression);
+        HLSLBaseType objectBaseType = tree.GetExpressionType(object).baseType;
 
-        if (memberAccess->object->expressionType.baseType == HLSLBaseType_Half  ||
-            memberAccess->object->expressionType.baseType == HLSLBaseType_Float ||
-            memberAccess->object->expressionType.baseType == HLSLBaseType_Int   ||
-            memberAccess->object->expressionType.baseType == HLSLBaseType_Uint)
+        if (objectBaseType == HLSLBaseType_Half  ||
+            objectBaseType == HLSLBaseType_Float ||
+            objectBaseType == HLSLBaseType_Int   ||
+            objectBaseType == HLSLBaseType_Uint)
         {
             // Handle swizzling on scalar values.
-            int swizzleLength = strlen(memberAccess->field);
+            int swizzleLength = strlen(field);
             if (swizzleLength == 2)
             {
-                m_writer.Write("%s", m_scalarSwizzle2Function);
+                m_writer.WriteText(m_scalarSwizzle2Function);
             }
             else if (swizzleLength == 3)
             {
-                m_writer.Write("%s", m_scalarSwizzle3Function);
+                m_writer.WriteText(m_scalarSwizzle3Function);
             }
             else if (swizzleLength == 4)
             {
-                m_writer.Write("%s", m_scalarSwizzle4Function);
+                m_writer.WriteText(m_scalarSwizzle4Function);
             }
-            m_writer.Write("(");
-            OutputExpression(memberAccess->object);
-            m_writer.Write(")");
+            m_writer.WriteText("(");
+            OutputExpression(tree, object);
+            m_writer.WriteText(")");
         }
         else
         {
 
-            m_writer.Write("(");
-            OutputExpression(memberAccess->object);
-            m_writer.Write(")");
+            m_writer.WriteText("(");
+            OutputExpression(tree, object);
+            m_writer.WriteText(")");
 
-            if (memberAccess->object->expressionType.baseType == HLSLBaseType_Float3x3 ||
-                memberAccess->object->expressionType.baseType == HLSLBaseType_Float4x4)
+            if (objectBaseType == HLSLBaseType_Float3x3 ||
+                objectBaseType == HLSLBaseType_Float4x4)
             {
                 // Handle HLSL matrix "swizzling".
                 // TODO: Properly handle multiple element selection such as _m00_m12
-                const char* n = memberAccess->field;
+                const char* n = field;
                 while (n[0] != 0)
                 {
                     if ( n[0] != '_' )
@@ -483,7 +508,11 @@ void GLSLGenerator::OutputExpression(HLSLExpression* expression, const HLSLType*
                     }
                     if (isdigit(n[0]) && isdigit(n[1]) )
                     {
-                        m_writer.Write("[%d][%d]", n[1] - base, n[0] - base);
+                        m_writer.WriteText("[");
+                        m_writer.WriteInt(n[1] - base);
+                        m_writer.WriteText("][");
+                        m_writer.WriteInt(n[0] - base);
+                        m_writer.WriteText("]");
                         n += 2;
                     }
                     else
@@ -495,85 +524,92 @@ void GLSLGenerator::OutputExpression(HLSLExpression* expression, const HLSLType*
             }
             else
             {
-                m_writer.Write(".%s", memberAccess->field);
+                m_writer.WriteText(".");
+                m_writer.WriteText(field);
             }
 
         }
 
     }
-    else if (expression->nodeType == HLSLNodeType_ArrayAccess)
+    else if (nodeType == HLSLNodeType_ArrayAccess)
     {
-        HLSLArrayAccess* arrayAccess = static_cast<HLSLArrayAccess*>(expression);
+        typename Tree::Node array = tree.GetArrayAccessArray(expression);
+        typename Tree::Node index = tree.GetArrayAccessIndex(expression);
+        const typename Tree::Type& arrayType = tree.GetExpressionType(array);
 
-        if (!arrayAccess->array->expressionType.array &&
-            (arrayAccess->array->expressionType.baseType == HLSLBaseType_Float3x3 ||
-             arrayAccess->array->expressionType.baseType == HLSLBaseType_Float4x4))
+        if (!arrayType.array &&
+            (arrayType.baseType == HLSLBaseType_Float3x3 ||
+             arrayType.baseType == HLSLBaseType_Float4x4))
         {
             // GLSL access a matrix as m[c][r] while HLSL is m[r][c], so use our
             // special row access function to convert.
-            m_writer.Write("%s(", m_matrixRowFunction);
-            OutputExpression(arrayAccess->array);
-            m_writer.Write(",");
-            OutputExpression(arrayAccess->index);
-            m_writer.Write(")");
+            m_writer.WriteText(m_matrixRowFunction);
+            m_writer.WriteText("(");
+            OutputExpression(tree, array);
+            m_writer.WriteText(",");
+            OutputExpression(tree, index);
+            m_writer.WriteText(")");
         }
         else
         {
-            OutputExpression(arrayAccess->array);
-            m_writer.Write("[");
-            OutputExpression(arrayAccess->index);
-            m_writer.Write("]");
+            OutputExpression(tree, array);
+            m_writer.WriteText("[");
+            OutputExpression(tree, index);
+            m_writer.WriteText("]");
         }
 
     }
-    else if (expression->nodeType == HLSLNodeType_FunctionCall)
+    else if (nodeType == HLSLNodeType_FunctionCall)
     {
-        HLSLFunctionCall* functionCall = static_cast<HLSLFunctionCall*>(expression);
+        typename Tree::Node function = tree.GetCalledFunction(expression);
 
         // Handle intrinsic funtions that are different between HLSL and GLSL.
         bool handled = false;
-        const char* functionName = functionCall->function->name;
+        const char* functionName = tree.GetFunctionName(function);
 
         if (String_Equal(functionName, "mul"))
         {
-            HLSLExpression* argument[2];
-            if (GetFunctionArguments(functionCall, argument, 2) != 2)
+            typename Tree::Node argument[2];
+            if (GetFunctionArguments(tree, expression, argument, 2) != 2)
             {
                 Error("mul expects 2 arguments");
                 return;
             }
-            m_writer.Write("((");
-            OutputExpression(argument[0], &functionCall->function->argument->type);
-            m_writer.Write(") * (");
-            OutputExpression(argument[1], &functionCall->function->argument->nextArgument->type);
-            m_writer.Write("))");
+            typename Tree::Node functionArgument = tree.GetFunctionArguments(function);
+            const typename Tree::Type& argumentType1 = tree.GetArgumentType(functionArgument);
+            const typename Tree::Type& argumentType2 = tree.GetArgumentType(tree.GetNextArgument(functionArgument));
+            m_writer.WriteText("((");
+            OutputExpression(tree, argument[0], &argumentType1);
+            m_writer.WriteText(") * (");
+            OutputExpression(tree, argument[1], &argumentType2);
+            m_writer.WriteText("))");
             handled = true;
         }
         else if (String_Equal(functionName, "saturate"))
         {
-            HLSLExpression* argument[1];
-            if (GetFunctionArguments(functionCall, argument, 1) != 1)
+            typename Tree::Node argument[1];
+            if (GetFunctionArguments(tree, expression, argument, 1) != 1)
             {
                 Error("saturate expects 1 argument");
                 return;
             }
-            m_writer.Write("clamp(");
-            OutputExpression(argument[0]);
-            m_writer.Write(", 0.0, 1.0)");
+            m_writer.WriteText("clamp(");
+            OutputExpression(tree, argument[0]);
+            m_writer.WriteText(", 0.0, 1.0)");
             handled = true;
         }
 
         if (!handled)
         {
             OutputIdentifier(functionName);
-            m_writer.Write("(");
-            OutputExpressionList(functionCall->argument, functionCall->function->argument);
-            m_writer.Write(")");
+            m_writer.WriteText("(");
+            OutputExpressionList(tree, tree.GetCallArguments(expression), tree.GetFunctionArguments(function));
+            m_writer.WriteText(")");
         }
     }
     else
     {
-        m_writer.Write("<unknown expression>");
+        m_writer.WriteText("<unknown expression>");
     }
 
     if (cast)
@@ -587,12 +623,12 @@ void GLSLGenerator::OutputExpression(HLSLExpression* expression, const HLSLType*
             // Casting to a vector - pad with 0s
             for (int i = srcTypeDesc.numComponents; i < dstTypeDesc.numComponents; ++i)
             {
-                m_writer.Write(", 0");
+                m_writer.WriteText(", 0");
             }
         }
 */
 
-        m_writer.Write(")");
+        m_writer.WriteText(")");
     }
 
 }
@@ -653,187 +689,186 @@ void GLSLGenerator::OutputIdentifier(const char* name)
         // The identifier could be a GLSL reserved word (if it's not also a HLSL reserved word).
         name = GetSafeIdentifierName(name);
     }
-    m_writer.Write("%s", name);
+    m_writer.WriteText(name);
 
 }
 
-void GLSLGenerator::OutputArguments(HLSLArgument* argument)
+template<typename Tree>
+void GLSLGenerator::OutputArguments(const Tree& tree, typename Tree::Node argument)
 {
     int numArgs = 0;
-    while (argument != NULL)
+    while (argument)
     {
         if (numArgs > 0)
         {
-            m_writer.Write(", ");
+            m_writer.WriteText(", ");
         }
 
-        switch (argument->modifier)
+        switch (tree.GetArgumentModifier(argument))
         {
         case HLSLArgumentModifier_In:
-            m_writer.Write("in ");
+            m_writer.WriteText("in ");
             break;
         case HLSLArgumentModifier_Inout:
-            m_writer.Write("inout ");
+            m_writer.WriteText("inout ");
             break;
         }
 
-        OutputDeclaration(argument->type, argument->name);
-        argument = argument->nextArgument;
+        OutputDeclaration(tree, tree.GetArgumentType(argument), tree.GetArgumentName(argument));
+        argument = tree.GetNextArgument(argument);
         ++numArgs;
     }
 }
 
-void GLSLGenerator::OutputStatements(int indent, HLSLStatement* statement, const HLSLType* returnType)
+template<typename Tree>
+void GLSLGenerator::OutputStatements(const Tree& tree, int indent, typename Tree::Node statement, const typename Tree::Type* returnType)
 {
 
-    while (statement != NULL)
+    while (statement)
     {
 
-        if (statement->nodeType == HLSLNodeType_Declaration)
-        {
-            HLSLDeclaration* declaration = static_cast<HLSLDeclaration*>(statement);
+        HLSLNodeType nodeType = tree.GetNodeType(statement);
+        const char* fileName  = tree.GetFileName(statement);
+        int line              = tree.GetLine(statement);
 
+        if (nodeType == HLSLNodeType_Declaration)
+        {
             // GLSL doesn't seem have texture uniforms, so just ignore them.
-            if (declaration->type.baseType != HLSLBaseType_Texture)
+            if (tree.GetDeclarationType(statement).baseType != HLSLBaseType_Texture)
             {
-                m_writer.BeginLine(indent, declaration->fileName, declaration->line);
+                m_writer.BeginLine(indent, fileName, line);
                 if (indent == 0)
                 {
                     // At the top level, we need the "uniform" keyword.
-                    m_writer.Write("uniform ");
+                    m_writer.WriteText("uniform ");
                 }
-                OutputDeclaration(declaration);
+                OutputDeclaration(tree, statement);
                 m_writer.EndLine(";");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_Struct)
+        else if (nodeType == HLSLNodeType_Struct)
         {
-            HLSLStruct* structure = static_cast<HLSLStruct*>(statement);
-            m_writer.WriteLine(indent, "struct %s {", structure->name);
-            HLSLStructField* field = structure->field;
-            while (field != NULL)
+            m_writer.WriteLine(indent, "struct %s {", tree.GetStructName(statement));
+            typename Tree::Node field = tree.GetStructFields(statement);
+            while (field)
             {
-                m_writer.BeginLine(indent + 1, field->fileName, field->line);
-                OutputDeclaration(field->type, field->name);
-                m_writer.Write(";");
+                m_writer.BeginLine(indent + 1, tree.GetFileName(field), tree.GetLine(field));
+                OutputDeclaration(tree, tree.GetStructFieldType(field), tree.GetStructFieldName(field));
+                m_writer.WriteText(";");
                 m_writer.EndLine();
-                field = field->nextField;
+                field = tree.GetNextStructField(field);
             }
             m_writer.WriteLine(indent, "};");
         }
-        else if (statement->nodeType == HLSLNodeType_Buffer)
+        else if (nodeType == HLSLNodeType_Buffer)
         {
-            HLSLBuffer* buffer = static_cast<HLSLBuffer*>(statement);
+            typename Tree::Node field = tree.GetBufferFields(statement);
             // Empty uniform blocks cause compilation errors on NVIDIA, so don't emit them.
-            if (buffer->field != NULL)
+            if (field)
             {
-                m_writer.WriteLine(indent, buffer->fileName, buffer->line, "layout (std140) uniform %s {", buffer->name);
-                HLSLBufferField* field = buffer->field;
-                while (field != NULL)
+                m_writer.WriteLine(indent, fileName, line, "layout (std140) uniform %s {", tree.GetBufferName(statement));
+                while (field)
                 {
-                    m_writer.BeginLine(indent + 1, field->fileName, field->line);
-                    OutputDeclaration(field->type, field->name);
-                    m_writer.Write(";");
+                    m_writer.BeginLine(indent + 1, tree.GetFileName(field), tree.GetLine(field));
+                    OutputDeclaration(tree, tree.GetBufferFieldType(field), tree.GetBufferFieldName(field));
+                    m_writer.WriteText(";");
                     m_writer.EndLine();
-                    field = field->nextField;
+                    field = tree.GetNextBufferField(field);
                 }
                 m_writer.WriteLine(indent, "};");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_Function)
+        else if (nodeType == HLSLNodeType_Function)
         {
-            HLSLFunction* function = static_cast<HLSLFunction*>(statement);
-
-            // Check if this is our entry point.
-            bool entryPoint = String_Equal(function->name, m_entryName);
+            const typename Tree::Type& functionReturnType = tree.GetFunctionReturnType(statement);
 
             // Use an alternate name for the function which is supposed to be entry point
             // so that we can supply our own function which will be the actual entry point.
-            const char* functionName   = GetSafeIdentifierName(function->name);
-            const char* returnTypeName = GetTypeName(function->returnType);
+            const char* functionName   = GetSafeIdentifierName(tree.GetFunctionName(statement));
+            const char* returnTypeName = GetTypeName(functionReturnType);
 
-            m_writer.BeginLine(indent, function->fileName, function->line);
-            m_writer.Write("%s %s(", returnTypeName, functionName);
+            m_writer.BeginLine(indent, fileName, line);
+            m_writer.WriteText(returnTypeName);
+            m_writer.WriteText(" ");
+            m_writer.WriteText(functionName);
+            m_writer.WriteText("(");
 
-            OutputArguments(function->argument);
+            OutputArguments(tree, tree.GetFunctionArguments(statement));
 
-            m_writer.Write(") {");
+            m_writer.WriteText(") {");
             m_writer.EndLine();
 
-            OutputStatements(indent + 1, function->statement, &function->returnType);
+            OutputStatements(tree, indent + 1, tree.GetFunctionStatements(statement), &functionReturnType);
             m_writer.WriteLine(indent, "}");
 
         }
-        else if (statement->nodeType == HLSLNodeType_ExpressionStatement)
+        else if (nodeType == HLSLNodeType_ExpressionStatement)
         {
-            HLSLExpressionStatement* expressionStatement = static_cast<HLSLExpressionStatement*>(statement);
-            m_writer.BeginLine(indent, statement->fileName, statement->line);
-            OutputExpression(expressionStatement->expression);
+            m_writer.BeginLine(indent, fileName, line);
+            OutputExpression(tree, tree.GetExpressionStatementExpression(statement));
             m_writer.EndLine(";");
         }
-        else if (statement->nodeType == HLSLNodeType_ReturnStatement)
+        else if (nodeType == HLSLNodeType_ReturnStatement)
         {
-            HLSLReturnStatement* returnStatement = static_cast<HLSLReturnStatement*>(statement);
-            if (returnStatement->expression != NULL)
+            typename Tree::Node expression = tree.GetReturnExpression(statement);
+            if (expression)
             {
-                m_writer.BeginLine(indent, returnStatement->fileName, returnStatement->line);
-                m_writer.Write("return ");
-                OutputExpression(returnStatement->expression, returnType);
+                m_writer.BeginLine(indent, fileName, line);
+                m_writer.WriteText("return ");
+                OutputExpression(tree, expression, returnType);
                 m_writer.EndLine(";");
             }
             else
             {
-                m_writer.WriteLine(indent, returnStatement->fileName, returnStatement->line, "return;");
+                m_writer.WriteLine(indent, fileName, line, "return;");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_DiscardStatement)
+        else if (nodeType == HLSLNodeType_DiscardStatement)
         {
-            HLSLDiscardStatement* discardStatement = static_cast<HLSLDiscardStatement*>(statement);
             if (m_target == Target_FragmentShader)
             {
-                m_writer.WriteLine(indent, discardStatement->fileName, discardStatement->line, "discard;");
+                m_writer.WriteLine(indent, fileName, line, "discard;");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_BreakStatement)
+        else if (nodeType == HLSLNodeType_BreakStatement)
         {
-            HLSLBreakStatement* breakStatement = static_cast<HLSLBreakStatement*>(statement);
-            m_writer.WriteLine(indent, breakStatement->fileName, breakStatement->line, "break;");
+            m_writer.WriteLine(indent, fileName, line, "break;");
         }
-        else if (statement->nodeType == HLSLNodeType_ContinueStatement)
+        else if (nodeType == HLSLNodeType_ContinueStatement)
         {
-            HLSLContinueStatement* continueStatement = static_cast<HLSLContinueStatement*>(statement);
-            m_writer.WriteLine(indent, continueStatement->fileName, continueStatement->line, "continue;");
+            m_writer.WriteLine(indent, fileName, line, "continue;");
         }
-        else if (statement->nodeType == HLSLNodeType_IfStatement)
+        else if (nodeType == HLSLNodeType_IfStatement)
         {
-            HLSLIfStatement* ifStatement = static_cast<HLSLIfStatement*>(statement);
-            m_writer.BeginLine(indent, ifStatement->fileName, ifStatement->line);
-            m_writer.Write("if (");
-            OutputExpression(ifStatement->condition, &kBoolType);
-            m_writer.Write(") {");
+            const typename Tree::Type boolType(HLSLBaseType_Bool);
+            typename Tree::Node elseStatement = tree.GetElseStatements(statement);
+            m_writer.BeginLine(indent, fileName, line);
+            m_writer.WriteText("if (");
+            OutputExpression(tree, tree.GetIfCondition(statement), &boolType);
+            m_writer.WriteText(") {");
             m_writer.EndLine();
-            OutputStatements(indent + 1, ifStatement->statement, returnType);
+            OutputStatements(tree, indent + 1, tree.GetIfStatements(statement), returnType);
             m_writer.WriteLine(indent, "}");
-            if (ifStatement->elseStatement != NULL)
+            if (elseStatement)
             {
                 m_writer.WriteLine(indent, "else {");
-                OutputStatements(indent + 1, ifStatement->elseStatement, returnType);
+                OutputStatements(tree, indent + 1, elseStatement, returnType);
                 m_writer.WriteLine(indent, "}");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_ForStatement)
+        else if (nodeType == HLSLNodeType_ForStatement)
         {
-            HLSLForStatement* forStatement = static_cast<HLSLForStatement*>(statement);
-            m_writer.BeginLine(indent, forStatement->fileName, forStatement->line);
-            m_writer.Write("for (");
-            OutputDeclaration(forStatement->initialization);
-            m_writer.Write("; ");
-            OutputExpression(forStatement->condition, &kBoolType);
-            m_writer.Write("; ");
-            OutputExpression(forStatement->increment);
-            m_writer.Write(") {");
+            const typename Tree::Type boolType(HLSLBaseType_Bool);
+            m_writer.BeginLine(indent, fileName, line);
+            m_writer.WriteText("for (");
+            OutputDeclaration(tree, tree.GetForInitialization(statement));
+            m_writer.WriteText("; ");
+            OutputExpression(tree, tree.GetForCondition(statement), &boolType);
+            m_writer.WriteText("; ");
+            OutputExpression(tree, tree.GetForIncrement(statement));
+            m_writer.WriteText(") {");
             m_writer.EndLine();
-            OutputStatements(indent + 1, forStatement->statement, returnType);
+            OutputStatements(tree, indent + 1, tree.GetForStatements(statement), returnType);
             m_writer.WriteLine(indent, "}");
         }
         else
@@ -842,66 +877,67 @@ void GLSLGenerator::OutputStatements(int indent, HLSLStatement* statement, const
             ASSERT(0);
         }
 
-        statement = statement->nextStatement;
+        statement = tree.GetNextStatement(statement);
 
     }
 
 }
 
-HLSLFunction* GLSLGenerator::FindFunction(HLSLRoot* root, const char* name)
+template<typename Tree>
+typename Tree::Node GLSLGenerator::FindFunction(const Tree& tree, const char* name)
 {
-    HLSLStatement* statement = root->statement;
-    while (statement != NULL)
+    typename Tree::Node statement = tree.GetRootStatements();
+    while (statement)
     {
-        if (statement->nodeType == HLSLNodeType_Function)
+        if (tree.GetNodeType(statement) == HLSLNodeType_Function)
         {
-            HLSLFunction* function = static_cast<HLSLFunction*>(statement);
-            if (String_Equal(function->name, name))
+            if (String_Equal(tree.GetFunctionName(statement), name))
             {
-                return function;
+                return statement;
             }
         }
-        statement = statement->nextStatement;
+        statement = tree.GetNextStatement(statement);
     }
-    return NULL;
+    return typename Tree::Node();
 }
 
-HLSLStruct* GLSLGenerator::FindStruct(HLSLRoot* root, const char* name)
+template<typename Tree>
+typename Tree::Node GLSLGenerator::FindStruct(const Tree& tree, const char* name)
 {
-    HLSLStatement* statement = root->statement;
-    while (statement != NULL)
+    typename Tree::Node statement = tree.GetRootStatements();
+    while (statement)
     {
-        if (statement->nodeType == HLSLNodeType_Struct)
+        if (tree.GetNodeType(statement) == HLSLNodeType_Struct)
         {
-            HLSLStruct* structDeclaration = static_cast<HLSLStruct*>(statement);
-            if (String_Equal(structDeclaration->name, name))
+            if (String_Equal(tree.GetStructName(statement), name))
             {
-                return structDeclaration;
+                return statement;
             }
         }
-        statement = statement->nextStatement;
+        statement = tree.GetNextStatement(statement);
     }
-    return NULL;
+    return typename Tree::Node();
 }
 
-void GLSLGenerator::OutputAttribute(const HLSLType& type, const char* semantic, const char* attribType, const char* prefix)
+template<typename Tree>
+void GLSLGenerator::OutputAttribute(const Tree& tree, const typename Tree::Type& type, const char* semantic, const char* attribType, const char* prefix)
 {
-    HLSLRoot* root = m_tree->GetRoot();
     if (type.baseType == HLSLBaseType_UserDefined)
     {
         // If the argument is a struct with semantics specified, we need to
         // grab them.
-        HLSLStruct* structDeclaration = FindStruct(root, type.typeName);
-        ASSERT(structDeclaration != NULL);
-        HLSLStructField* field = structDeclaration->field;
-        while (field != NULL)
+        typename Tree::Node structDeclaration = FindStruct(tree, type.typeName);
+        ASSERT(structDeclaration);
+        typename Tree::Node field = tree.GetStructFields(structDeclaration);
+        while (field)
         {
-            if (field->semantic != NULL && GetBuiltInSemantic(field->semantic) == NULL)
+            const char* fieldSemantic = tree.GetStructFieldSemantic(field);
+            if (fieldSemantic != NULL && GetBuiltInSemantic(fieldSemantic) == NULL)
             {
-                const char* typeName = GetTypeName(field->type);            
-                m_writer.WriteLine(0, "%s %s %s%s;", attribType, typeName, prefix, field->semantic);
+                const char* typeName = GetTypeName(tree.GetStructFieldType(field));            
+                m_writer.WriteLine(0, "%s %s %s%s;", attribType, typeName, prefix, fieldSemantic);
             }
-            field = field->nextField;
+            field = tree.GetNextStructField(field);
         }
     }
     else if (semantic != NULL && GetBuiltInSemantic(semantic) == NULL)
@@ -911,18 +947,19 @@ void GLSLGenerator::OutputAttribute(const HLSLType& type, const char* semantic,
     }
 }
 
-void GLSLGenerator::OutputAttributes(HLSLFunction* entryFunction)
+template<typename Tree>
+void GLSLGenerator::OutputAttributes(const Tree& tree, typename Tree::Node entryFunction)
 {
     // Write out the input attributes to the shader.
-    HLSLArgument* argument = entryFunction->argument;
-    while (argument != NULL)
+    typename Tree::Node argument = tree.GetFunctionArguments(entryFunction);
+    while (argument)
     {
-        OutputAttribute(argument->type, argument->semantic, "in", m_inAttribPrefix);
-        argument = argument->nextArgument;
+        OutputAttribute(tree, tree.GetArgumentType(argument), tree.GetArgumentSemantic(argument), "in", m_inAttribPrefix);
+        argument = tree.GetNextArgument(argument);
     }
 
     // Write out the output attributes from the shader.
-    OutputAttribute(entryFunction->returnType, entryFunction->semantic, "out", m_outAttribPrefix);
+    OutputAttribute(tree, tree.GetFunctionReturnType(entryFunction), tree.GetFunctionSemantic(entryFunction), "out", m_outAttribPrefix);
 }
 
 void GLSLGenerator::OutputSetOutAttribute(const char* semantic, const char* resultName)
@@ -960,135 +997,152 @@ void GLSLGenerator::OutputSetOutAttribute(const char* semantic, const char* resu
     }
 }
 
-void GLSLGenerator::OutputEntryCaller(HLSLFunction* entryFunction)
+template<typename Tree>
+void GLSLGenerator::OutputEntryCaller(const Tree& tree, typename Tree::Node entryFunction)
 {
-    HLSLRoot* root = m_tree->GetRoot();
-
     m_writer.WriteLine(0, "void main() {");
 
     // Create local variables for each of the parameters we'll need to pass
     // into the entry point function.
-    HLSLArgument* argument = entryFunction->argument;
-    while (argument != NULL)
+    typename Tree::Node argument = tree.GetFunctionArguments(entryFunction);
+    while (argument)
     {
+        const typename Tree::Type& argumentType = tree.GetArgumentType(argument);
+        const char* argumentName                = GetSafeIdentifierName(tree.GetArgumentName(argument));
+        const char* argumentSemantic            = tree.GetArgumentSemantic(argument);
+
         m_writer.BeginLine(1);
-        OutputDeclaration(argument->type, argument->name);
+        OutputDeclaration(tree, argumentType, tree.GetArgumentName(argument));
         m_writer.EndLine(";");
 
         // Set the value for the local variable.
-        if (argument->type.baseType == HLSLBaseType_UserDefined)
+        if (argumentType.baseType == HLSLBaseType_UserDefined)
         {
-            HLSLStruct* structDeclaration = FindStruct(root, argument->type.typeName);
-            ASSERT(structDeclaration != NULL);
-            HLSLStructField* field = structDeclaration->field;
-            while (field != NULL)
+            typename Tree::Node structDeclaration = FindStruct(tree, argumentType.typeName);
+            ASSERT(structDeclaration);
+            typename Tree::Node field = tree.GetStructFields(structDeclaration);
+            while (field)
             {
-                if (field->semantic != NULL)
+                const char* fieldSemantic = tree.GetStructFieldSemantic(field);
+                if (fieldSemantic != NULL)
                 {
-                    const char* builtInSemantic = GetBuiltInSemantic(field->semantic);
+                    const char* fieldName = GetSafeIdentifierName(tree.GetStructFieldName(field));
+                    const char* builtInSemantic = GetBuiltInSemantic(fieldSemantic);
                     if (builtInSemantic)
                     {
-                        m_writer.WriteLine(1, "%s.%s = %s;", GetSafeIdentifierName(argument->name), GetSafeIdentifierName(field->name), builtInSemantic);
+                        m_writer.WriteLine(1, "%s.%s = %s;", argumentName, fieldName, builtInSemantic);
                     }
                     else
                     {
-                        m_writer.WriteLine(1, "%s.%s = %s%s;", GetSafeIdentifierName(argument->name), GetSafeIdentifierName(field->name), m_inAttribPrefix, field->semantic);
+                        m_writer.WriteLine(1, "%s.%s = %s%s;", argumentName, fieldName, m_inAttribPrefix, fieldSemantic);
                     }
                 }
-                field = field->nextField;
+                field = tree.GetNextStructField(field);
             }
         }
-        else if (argument->semantic != NULL)
+        else if (argumentSemantic != NULL)
         {
-            const char* builtInSemantic = GetBuiltInSemantic(argument->semantic);
+            const char* builtInSemantic = GetBuiltInSemantic(argumentSemantic);
             if (builtInSemantic)
             {
-                m_writer.WriteLine(1, "%s = %s;", GetSafeIdentifierName(argument->name), builtInSemantic);
+                m_writer.WriteLine(1, "%s = %s;", argumentName, builtInSemantic);
             }
             else
             {
-                m_writer.WriteLine(1, "%s = %s%s;", GetSafeIdentifierName(argument->name), m_inAttribPrefix, argument->semantic);
+                m_writer.WriteLine(1, "%s = %s%s;", argumentName, m_inAttribPrefix, argumentSemantic);
             }
         }
 
-        argument = argument->nextArgument;
+        argument = tree.GetNextArgument(argument);
     }
 
     const char* resultName = "result";
+    const typename Tree::Type& returnType = tree.GetFunctionReturnType(entryFunction);
+    const char* semantic = tree.GetFunctionSemantic(entryFunction);
 
     // Call the original entry function.
     m_writer.BeginLine(1);
-    m_writer.Write("%s %s = %s(", GetTypeName(entryFunction->returnType), resultName, m_entryName);
+    m_writer.Write("%s %s = %s(", GetTypeName(returnType), resultName, m_entryName);
 
     int numArgs = 0;
-    argument = entryFunction->argument;
-    while (argument != NULL)
+    argument = tree.GetFunctionArguments(entryFunction);
+    while (argument)
     {
         if (numArgs > 0)
         {
-            m_writer.Write(", ");
+            m_writer.WriteText(", ");
         }
-        m_writer.Write("%s", GetSafeIdentifierName(argument->name));
-        argument = argument->nextArgument;
+        m_writer.WriteText(GetSafeIdentifierName(tree.GetArgumentName(argument)));
+        argument = tree.GetNextArgument(argument);
         ++numArgs;
     }
     m_writer.EndLine(");");
 
     // Copy values from the result into the out attributes as necessary.
-    if (entryFunction->returnType.baseType == HLSLBaseType_UserDefined)
+    if (returnType.baseType == HLSLBaseType_UserDefined)
     {
-        HLSLStruct* structDeclaration = FindStruct(root, entryFunction->returnType.typeName);
-        ASSERT(structDeclaration != NULL);
-        HLSLStructField* field = structDeclaration->field;
-        while (field != NULL)
+        typename Tree::Node structDeclaration = FindStruct(tree, returnType.typeName);
+        ASSERT(structDeclaration);
+        typename Tree::Node field = tree.GetStructFields(structDeclaration);
+        while (field)
         {
             char fieldResultName[1024];
-            String_Printf( fieldResultName, sizeof(fieldResultName), "%s.%s", resultName, field->name );
-            OutputSetOutAttribute( field->semantic, fieldResultName );
-            field = field->nextField;
+            String_Printf( fieldResultName, sizeof(fieldResultName), "%s.%s", resultName, tree.GetStructFieldName(field) );
+            OutputSetOutAttribute( tree.GetStructFieldSemantic(field), fieldResultName );
+            field = tree.GetNextStructField(field);
         }
     }
-    else if (entryFunction->semantic != NULL)
+    else if (semantic != NULL)
     {
-        OutputSetOutAttribute(entryFunction->semantic, resultName);
+        OutputSetOutAttribute(semantic, resultName);
     }
 
     m_writer.WriteLine(0, "}");
 }
 
-void GLSLGenerator::OutputDeclaration(HLSLDeclaration* declaration)
+template<typename Tree>
+void GLSLGenerator::OutputDeclaration(const Tree& tree, typename Tree::Node declaration)
 {
-    OutputDeclaration(declaration->type, GetSafeIdentifierName(declaration->name));
-    if (declaration->assignment != NULL)
+    const typename Tree::Type& type = tree.GetDeclarationType(declaration);
+    typename Tree::Node assignment  = tree.GetDeclarationAssignment(declaration);
+    OutputDeclaration(tree, type, GetSafeIdentifierName(tree.GetDeclarationName(declaration)));
+    if (assignment)
     {
-        m_writer.Write(" = ");
-        if (declaration->type.array)
+        m_writer.WriteText(" = ");
+        if (type.array)
         {
-            m_writer.Write("%s[]( ", GetTypeName(declaration->type));
-            OutputExpressionList(declaration->assignment);
-            m_writer.Write(" )");
+            m_writer.WriteText(GetTypeName(type));
+            m_writer.WriteText("[]( ");
+            OutputExpressionList(tree, assignment);
+            m_writer.WriteText(" )");
         }
         else
         {
-            OutputExpression(declaration->assignment, &declaration->type);
+            OutputExpression(tree, assignment, &type);
         }
     }
 }
 
-void GLSLGenerator::OutputDeclaration(const HLSLType& type, const char* name)
+template<typename Tree>
+void GLSLGenerator::OutputDeclaration(const Tree& tree, const typename Tree::Type& type, const char* name)
 {
     if (!type.array)
     {
-        m_writer.Write("%s %s", GetTypeName(type), GetSafeIdentifierName(name) );
+        m_writer.WriteText(GetTypeName(type));
+        m_writer.WriteText(" ");
+        m_writer.WriteText(GetSafeIdentifierName(name));
     }
     else
     {
-        m_writer.Write("%s %s[", GetTypeName(type), GetSafeIdentifierName(name));
-        if (type.arraySize != NULL)
+        m_writer.WriteText(GetTypeName(type));
+        m_writer.WriteText(" ");
+        m_writer.WriteText(GetSafeIdentifierName(name));
+        m_writer.WriteText("[");
+        if (type.arraySize)
         {
-            OutputExpression(type.arraySize);
+            OutputExpression(tree, type.arraySize);
         }
-        m_writer.Write("]");
+        m_writer.WriteText("]");
     }
 }
 
@@ -1124,12 +1178,17 @@ const char* GLSLGenerator::GetSafeIdentifierName(const char* name) const
     return name;
 }
 
-bool GLSLGenerator::ChooseUniqueName(const char* base, char* dst, int dstLength) const
+template<typename Tree>
+bool GLSLGenerator::ChooseUniqueName(const Tree& tree, const char* base, char* dst, int dstLength) const
 {
     for (int i = 0; i < 1024; ++i)
     {
         String_Printf(dst, dstLength, "%s%d", base, i);
-        if (!m_tree->GetContainsString(dst))
+        if (m_instrumentation != NULL)
+        {
+            m_instrumentation->AddCount(HLSLCounter_UniqueNameProbes, 1);
+        }
+        if (!tree.GetContainsString(dst))
         {
             return true;
         }
@@ -1137,4 +1196,4 @@ bool GLSLGenerator::ChooseUniqueName(const char* base, char* dst, int dstLength)
     return false;
 }
 
-}
\ No newline at end of file
+}
@@ -11,11 +11,14 @@
 #define GLSL_GENERATOR_H
 
 #include "CodeWriter.h"
+#include "HLSLInstrumentation.h"
 #include "HLSLTree.h"
 
 namespace M4
 {
 
+class HLSLCompactTree;
+
 class GLSLGenerator
 {
 
@@ -29,32 +32,61 @@ public:
 
     explicit GLSLGenerator(Allocator* allocator);
     
+    /** The tree is only read, so one frozen tree can be shared by generators on
+    several threads (see HLSLTree::Freeze). */
     bool Generate(const HLSLTree* tree, Target target, const char* entryName);
+
+    /** Generates the output from a compact tree without expanding it first. */
+    bool Generate(const HLSLCompactTree* tree, Target target, const char* entryName);
+
     const char* GetResult() const;
 
+    /** Streams the output to the sink as it's generated instead of keeping it
+    for GetResult (see CodeWriter::SetSink). */
+    void SetSink(CodeSink* sink);
+
+    /** Reports timings and counts to the instrumentation, which is optional. */
+    void SetInstrumentation(HLSLInstrumentation* instrumentation);
+
 private:
 
-    void OutputExpressionList(HLSLExpression* expression, HLSLArgument* argument = NULL);
-    void OutputExpression(HLSLExpression* expression, const HLSLType* dstType = NULL);
+    /** The tree is read through an HLSLTreeAccessor or HLSLCompactTreeAccessor,
+    so the same code generates from either layout. */
+    template<typename Tree>
+    bool GenerateTree(const Tree& tree, Target target, const char* entryName);
+
+    template<typename Tree>
+    void OutputExpressionList(const Tree& tree, typename Tree::Node expression, typename Tree::Node argument = typename Tree::Node());
+    template<typename Tree>
+    void OutputExpression(const Tree& tree, typename Tree::Node expression, const typename Tree::Type* dstType = NULL);
     void OutputIdentifier(const char* name);
-    void OutputArguments(HLSLArgument* argument);
+    template<typename Tree>
+    void OutputArguments(const Tree& tree, typename Tree::Node argument);
     
     /**
      * If the statements are part of a function, then returnType can be used to specify the type
      * that a return statement is expected to produce so that correct casts will be generated.
      */
-    void OutputStatements(int indent, HLSLStatement* statement, const HLSLType* returnType = NULL);
-
-    void OutputAttribute(const HLSLType& type, const char* semantic, const char* attribType, const char* prefix);
-    void OutputAttributes(HLSLFunction* entryFunction);
-    void OutputEntryCaller(HLSLFunction* entryFunction);
-    void OutputDeclaration(HLSLDeclaration* declaration);
-    void OutputDeclaration(const HLSLType& type, const char* name);
+    template<typename Tree>
+    void OutputStatements(const Tree& tree, int indent, typename Tree::Node statement, const typename Tree::Type* returnType = NULL);
+
+    template<typename Tree>
+    void OutputAttribute(const Tree& tree, const typename Tree::Type& type, const char* semantic, const char* attribType, const char* prefix);
+    template<typename Tree>
+    void OutputAttributes(const Tree& tree, typename Tree::Node entryFunction);
+    template<typename Tree>
+    void OutputEntryCaller(const Tree& tree, typename Tree::Node entryFunction);
+    template<typename Tree>
+    void OutputDeclaration(const Tree& tree, typename Tree::Node declaration);
+    template<typename Tree>
+    void OutputDeclaration(const Tree& tree, const typename Tree::Type& type, const char* name);
 
     void OutputSetOutAttribute(const char* semantic, const char* resultName);
 
-    HLSLFunction* FindFunction(HLSLRoot* root, const char* name);
-    HLSLStruct* FindStruct(HLSLRoot* root, const char* name);
+    template<typename Tree>
+    typename Tree::Node FindFunction(const Tree& tree, const char* name);
+    template<typename Tree>
+    typename Tree::Node FindStruct(const Tree& tree, const char* name);
 
     void Error(const char* format, ...);
 
@@ -64,16 +96,17 @@ private:
 
     /** Generates a name of the format "base+n" where n is an integer such that the name
      * isn't used in the syntax tree. */
-    bool ChooseUniqueName(const char* base, char* dst, int dstLength) const;
+    template<typename Tree>
+    bool ChooseUniqueName(const Tree& tree, const char* base, char* dst, int dstLength) const;
 
 private:
 
     static const int    s_numReservedWords = 5;
-    static const char*  s_reservedWord[s_numReservedWords];
+    static const char* const s_reservedWord[s_numReservedWords];
 
     CodeWriter          m_writer;
+    HLSLInstrumentation* m_instrumentation;
 
-    const HLSLTree*     m_tree;
     const char*         m_entryName;
     Target              m_target;
     bool                m_outputPosition;
@@ -0,0 +1,1215 @@
+#include "Engine/Assert.h"
+#include "Engine/File.h"
+#include "Engine/Hash.h"
+#include "Engine/HashMap.h"
+
+#include "HLSLCompactTree.h"
+
+#include <string.h>
+#include <stdint.h>
+
+namespace M4
+{
+
+struct HLSLCompactTree::BuildContext
+{
+    typedef HashMap<uint64_t, unsigned int> IndexMap;
+
+    explicit BuildContext(Allocator* allocator) : nodes(allocator), types(allocator), strings(allocator), fileNames(allocator)
+    {
+    }
+    IndexMap    nodes;          // Node pointer to node index.
+    IndexMap    types;          // Packed type to type id.
+    IndexMap    strings;        // Interned string pointer to string id.
+    IndexMap    fileNames;      // Interned file name pointer to file id.
+};
+
+static uint64_t GetPointerKey(const void* pointer)
+{
+    return static_cast<uint64_t>(reinterpret_cast<size_t>(pointer));
+}
+
+static bool GetIsExpression(int nodeType)
+{
+    return nodeType == HLSLNodeType_Expression || (nodeType >= HLSLNodeType_UnaryExpression && nodeType <= HLSLNodeType_FunctionCall);
+}
+
+// Intrinsic functions aren't part of the tree and don't have their node type
+// set, so the type of a node in a list is determined by the list when possible.
+static HLSLNodeType GetListNodeType(const HLSLStatement* node)      { return node->nodeType; }
+static HLSLNodeType GetListNodeType(const HLSLExpression* node)     { return node->nodeType; }
+static HLSLNodeType GetListNodeType(const HLSLStructField*)         { return HLSLNodeType_StructField; }
+static HLSLNodeType GetListNodeType(const HLSLBufferField*)         { return HLSLNodeType_BufferField; }
+static HLSLNodeType GetListNodeType(const HLSLArgument*)            { return HLSLNodeType_Argument; }
+
+HLSLCompactTree::HLSLCompactTree(Allocator* allocator) :
+    m_allocator(allocator),
+    m_stringPool(allocator),
+    m_nodes(allocator),
+    m_types(allocator),
+    m_strings(allocator),
+    m_fileNames(allocator)
+{
+    m_nodeData          = NULL;
+    m_numNodes          = 0;
+    m_root              = 0;
+    m_file.contents     = NULL;
+    m_file.length       = 0;
+    m_file.mapped       = false;
+}
+
+HLSLCompactTree::~HLSLCompactTree()
+{
+    if (m_file.contents != NULL)
+    {
+        File_Unmap(m_allocator, m_file);
+    }
+}
+
+void HLSLCompactTree::Build(const HLSLTree* tree)
+{
+    ASSERT(m_numNodes == 0);
+
+    // Index 0 is reserved for no node, and for NULL strings and file names.
+    m_nodes.PushBackNew();
+    m_strings.PushBack(NULL);
+    m_fileNames.PushBack(NULL);
+
+    BuildContext context(m_allocator);
+    m_root = CompactNode(context, tree->GetRoot(), HLSLNodeType_Root);
+
+    m_nodeData = &m_nodes[0];
+    m_numNodes = m_nodes.GetSize();
+}
+
+HLSLNodeIndex HLSLCompactTree::GetRoot() const
+{
+    return m_root;
+}
+
+int HLSLCompactTree::GetNumNodes() const
+{
+    return m_numNodes;
+}
+
+bool HLSLCompactTree::GetContainsString(const char* string) const
+{
+    return m_stringPool.GetContainsString(string);
+}
+
+size_t HLSLCompactTree::GetMemorySize() const
+{
+    return m_numNodes * sizeof(HLSLCompactNode) +
+           m_types.GetSize() * sizeof(HLSLCompactType) +
+           m_strings.GetSize() * sizeof(const char*) +
+           m_fileNames.GetSize() * sizeof(const char*);
+}
+
+HLSLNodeIndex HLSLCompactTree::CompactNode(BuildContext& context, const HLSLNode* node, HLSLNodeType nodeType)
+{
+
+    if (node == NULL)
+    {
+        return 0;
+    }
+
+    // Nodes can be referenced more than once (functions by calls and array sizes
+    // by the types which use them), so each one is only compacted once.
+    const unsigned int* compacted = context.nodes.Find(GetPointerKey(node));
+    if (compacted != NULL)
+    {
+        return *compacted;
+    }
+    unsigned int index = m_nodes.GetSize();
+    context.nodes.Insert(GetPointerKey(node), index);
+    m_nodes.PushBackNew();
+
+    // Build the node separately, since compacting the children grows the array.
+    HLSLCompactNode compact;
+    memset(&compact, 0, sizeof(compact));
+    compact.nodeType    = static_cast<unsigned char>(nodeType);
+    compact.fileId      = CompactFileName(context, node->fileName);
+    compact.line        = node->line;
+
+    unsigned int* operand = compact.operand;
+
+    switch (nodeType)
+    {
+    case HLSLNodeType_Root:
+        {
+            const HLSLRoot* root = static_cast<const HLSLRoot*>(node);
+            operand[0] = CompactList(context, root->statement, &HLSLStatement::nextStatement);
+        }
+        break;
+    case HLSLNodeType_Declaration:
+        {
+            const HLSLDeclaration* declaration = static_cast<const HLSLDeclaration*>(node);
+            compact.type = CompactType(context, declaration->type);
+            operand[0] = CompactString(context, declaration->name);
+            operand[1] = CompactString(context, declaration->registerName);
+            operand[2] = CompactNode(context, declaration->nextDeclaration, HLSLNodeType_Declaration);
+            operand[3] = CompactList(context, declaration->assignment, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_Struct:
+        {
+            const HLSLStruct* structure = static_cast<const HLSLStruct*>(node);
+            operand[0] = CompactString(context, structure->name);
+            operand[1] = CompactList(context, structure->field, &HLSLStructField::nextField);
+        }
+        break;
+    case HLSLNodeType_StructField:
+        {
+            const HLSLStructField* field = static_cast<const HLSLStructField*>(node);
+            compact.type = CompactType(context, field->type);
+            operand[0] = CompactString(context, field->name);
+            operand[1] = CompactString(context, field->semantic);
+        }
+        break;
+    case HLSLNodeType_Buffer:
+        {
+            const HLSLBuffer* buffer = static_cast<const HLSLBuffer*>(node);
+            operand[0] = CompactString(context, buffer->name);
+            operand[1] = CompactString(context, buffer->registerName);
+            operand[2] = CompactList(context, buffer->field, &HLSLBufferField::nextField);
+        }
+        break;
+    case HLSLNodeType_BufferField:
+        {
+            const HLSLBufferField* field = static_cast<const HLSLBufferField*>(node);
+            compact.type = CompactType(context, field->type);
+            operand[0] = CompactString(context, field->name);
+        }
+        break;
+    case HLSLNodeType_Function:
+        {
+            const HLSLFunction* function = static_cast<const HLSLFunction*>(node);
+            compact.type = CompactType(context, function->returnType);
+            operand[0] = CompactString(context, function->name);
+            operand[1] = CompactString(context, function->semantic);
+            operand[2] = CompactList(context, function->argument, &HLSLArgument::nextArgument);
+            operand[3] = CompactList(context, function->statement, &HLSLStatement::nextStatement);
+        }
+        break;
+    case HLSLNodeType_Argument:
+        {
+            const HLSLArgument* argument = static_cast<const HLSLArgument*>(node);
+            compact.type = CompactType(context, argument->type);
+            operand[0] = CompactString(context, argument->name);
+            operand[1] = argument->modifier;
+            operand[2] = CompactString(context, argument->semantic);
+        }
+        break;
+    case HLSLNodeType_ExpressionStatement:
+        {
+            const HLSLExpressionStatement* statement = static_cast<const HLSLExpressionStatement*>(node);
+            operand[0] = CompactList(context, statement->expression, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_ReturnStatement:
+        {
+            const HLSLReturnStatement* statement = static_cast<const HLSLReturnStatement*>(node);
+            operand[0] = CompactList(context, statement->expression, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_DiscardStatement:
+    case HLSLNodeType_BreakStatement:
+    case HLSLNodeType_ContinueStatement:
+        break;
+    case HLSLNodeType_IfStatement:
+        {
+            const HLSLIfStatement* statement = static_cast<const HLSLIfStatement*>(node);
+            operand[0] = CompactList(context, statement->condition, &HLSLExpression::nextExpression);
+            operand[1] = CompactList(context, statement->statement, &HLSLStatement::nextStatement);
+            operand[2] = CompactList(context, statement->elseStatement, &HLSLStatement::nextStatement);
+        }
+        break;
+    case HLSLNodeType_ForStatement:
+        {
+            const HLSLForStatement* statement = static_cast<const HLSLForStatement*>(node);
+            operand[0] = CompactNode(context, statement->initialization, HLSLNodeType_Declaration);
+            operand[1] = CompactList(context, statement->condition, &HLSLExpression::nextExpression);
+            operand[2] = CompactList(context, statement->increment, &HLSLExpression::nextExpression);
+            operand[3] = CompactList(context, statement->statement, &HLSLStatement::nextStatement);
+        }
+        break;
+    case HLSLNodeType_UnaryExpression:
+        {
+            const HLSLUnaryExpression* expression = static_cast<const HLSLUnaryExpression*>(node);
+            operand[0] = expression->unaryOp;
+            operand[1] = CompactList(context, expression->expression, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_BinaryExpression:
+        {
+            const HLSLBinaryExpression* expression = static_cast<const HLSLBinaryExpression*>(node);
+            operand[0] = expression->binaryOp;
+            operand[1] = CompactList(context, expression->expression1, &HLSLExpression::nextExpression);
+            operand[2] = CompactList(context, expression->expression2, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_ConditionalExpression:
+        {
+            const HLSLConditionalExpression* expression = static_cast<const HLSLConditionalExpression*>(node);
+            operand[0] = CompactList(context, expression->condition, &HLSLExpression::nextExpression);
+            operand[1] = CompactList(context, expression->trueExpression, &HLSLExpression::nextExpression);
+            operand[2] = CompactList(context, expression->falseExpression, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_CastingExpression:
+        {
+            const HLSLCastingExpression* expression = static_cast<const HLSLCastingExpression*>(node);
+            operand[0] = CompactType(context, expression->type);
+            operand[1] = CompactList(context, expression->expression, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_LiteralExpression:
+        {
+            const HLSLLiteralExpression* expression = static_cast<const HLSLLiteralExpression*>(node);
+            operand[0] = expression->type;
+            switch (expression->type)
+            {
+            case HLSLBaseType_Bool:
+                operand[1] = expression->bValue ? 1 : 0;
+                break;
+            case HLSLBaseType_Float:
+            case HLSLBaseType_Half:
+                memcpy(&operand[1], &expression->fValue, sizeof(float));
+                break;
+            default:
+                operand[1] = static_cast<unsigned int>(expression->iValue);
+                break;
+            }
+        }
+        break;
+    case HLSLNodeType_IdentifierExpression:
+        {
+            const HLSLIdentifierExpression* expression = static_cast<const HLSLIdentifierExpression*>(node);
+            operand[0] = CompactString(context, expression->name);
+            operand[1] = expression->global ? 1 : 0;
+        }
+        break;
+    case HLSLNodeType_ConstructorExpression:
+        {
+            const HLSLConstructorExpression* expression = static_cast<const HLSLConstructorExpression*>(node);
+            operand[0] = CompactType(context, expression->type);
+            operand[1] = CompactList(context, expression->argument, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_MemberAccess:
+        {
+            const HLSLMemberAccess* expression = static_cast<const HLSLMemberAccess*>(node);
+            operand[0] = CompactList(context, expression->object, &HLSLExpression::nextExpression);
+            operand[1] = CompactString(context, expression->field);
+        }
+        break;
+    case HLSLNodeType_ArrayAccess:
+        {
+            const HLSLArrayAccess* expression = static_cast<const HLSLArrayAccess*>(node);
+            operand[0] = CompactList(context, expression->array, &HLSLExpression::nextExpression);
+            operand[1] = CompactList(context, expression->index, &HLSLExpression::nextExpression);
+        }
+        break;
+    case HLSLNodeType_FunctionCall:
+        {
+            const HLSLFunctionCall* expression = static_cast<const HLSLFunctionCall*>(node);
+            operand[0] = CompactNode(context, expression->function, HLSLNodeType_Function);
+            operand[1] = expression->numArguments;
+            operand[2] = CompactList(context, expression->argument, &HLSLExpression::nextExpression);
+        }
+        break;
+    default:
+        ASSERT(0);
+        break;
+    }
+
+    if (GetIsExpression(nodeType))
+    {
+        compact.type = CompactType(context, static_cast<const HLSLExpression*>(node)->expressionType);
+    }
+
+    // The next node is linked by the list which contains this node.
+    compact.next = m_nodes[index].next;
+    m_nodes[index] = compact;
+    return index;
+
+}
+
+template<typename T>
+HLSLNodeIndex HLSLCompactTree::CompactList(BuildContext& context, const T* node, T* T::*next)
+{
+    HLSLNodeIndex first = 0;
+    HLSLNodeIndex last  = 0;
+    for (; node != NULL; node = node->*next)
+    {
+        HLSLNodeIndex index = CompactNode(context, node, GetListNodeType(node));
+        if (last != 0)
+        {
+            m_nodes[last].next = index;
+        }
+        else
+        {
+            first = index;
+        }
+        last = index;
+    }
+    return first;
+}
+
+HLSLTypeId HLSLCompactTree::CompactType(BuildContext& context, const HLSLType& type)
+{
+
+    HLSLCompactType compact;
+    compact.baseType    = type.baseType;
+    compact.typeName    = CompactString(context, type.typeName);
+    compact.arraySize   = CompactList(context, type.arraySize, &HLSLExpression::nextExpression);
+    compact.array       = type.array;
+    compact.constant    = type.constant;
+
+    // Pack the type into a key for interning. The string and node indices are
+    // limited to 28 bits, which is far more than a shader will ever have.
+    ASSERT(compact.typeName < (1u << 28) && compact.arraySize < (1u << 28));
+    uint64_t key = static_cast<uint64_t>(compact.baseType) |
+                   (static_cast<uint64_t>(compact.array) << 6) |
+                   (static_cast<uint64_t>(compact.constant) << 7) |
+                   (static_cast<uint64_t>(compact.typeName) << 8) |
+                   (static_cast<uint64_t>(compact.arraySize) << 36);
+
+    const unsigned int* typeId = context.types.Find(key);
+    if (typeId != NULL)
+    {
+        return *typeId;
+    }
+    m_types.PushBack(compact);
+    context.types.Insert(key, m_types.GetSize() - 1);
+    return m_types.GetSize() - 1;
+
+}
+
+HLSLStringId HLSLCompactTree::CompactString(BuildContext& context, const char* string)
+{
+    if (string == NULL)
+    {
+        return 0;
+    }
+    // Strings in the tree are interned, so they can be looked up by pointer.
+    const unsigned int* stringId = context.strings.Find(GetPointerKey(string));
+    if (stringId != NULL)
+    {
+        return *stringId;
+    }
+    m_strings.PushBack(m_stringPool.AddString(string));
+    context.strings.Insert(GetPointerKey(string), m_strings.GetSize() - 1);
+    return m_strings.GetSize() - 1;
+}
+
+unsigned short HLSLCompactTree::CompactFileName(BuildContext& context, const char* fileName)
+{
+    if (fileName == NULL)
+    {
+        return 0;
+    }
+    const unsigned int* fileId = context.fileNames.Find(GetPointerKey(fileName));
+    if (fileId != NULL)
+    {
+        return static_cast<unsigned short>(*fileId);
+    }
+    ASSERT(m_fileNames.GetSize() <= 0xFFFF);
+    m_fileNames.PushBack(m_stringPool.AddString(fileName));
+    context.fileNames.Insert(GetPointerKey(fileName), m_fileNames.GetSize() - 1);
+    return static_cast<unsigned short>(m_fileNames.GetSize() - 1);
+}
+
+void HLSLCompactTree::Expand(HLSLTree* tree) const
+{
+    // Maps node indices to the expanded nodes, so that shared nodes stay shared.
+    Array<HLSLNode*> nodes(m_allocator);
+    nodes.Resize(m_numNodes);
+
+    HLSLRoot* root = tree->GetRoot();
+    nodes[m_root] = root;
+    root->statement = static_cast<HLSLStatement*>(ExpandList(tree, nodes, m_nodeData[m_root].operand[0]));
+}
+
+template<typename T>
+static T* AddExpandedNode(HLSLTree* tree, Array<HLSLNode*>& nodes, HLSLNodeIndex index, const char* fileName, int line)
+{
+    T* node = tree->AddNode<T>(fileName, line);
+    nodes[index] = node;
+    return node;
+}
+
+HLSLNode* HLSLCompactTree::ExpandNode(HLSLTree* tree, Array<HLSLNode*>& nodes, HLSLNodeIndex index) const
+{
+
+    if (index == 0)
+    {
+        return NULL;
+    }
+    if (nodes[index] != NULL)
+    {
+        return nodes[index];
+    }
+
+    const HLSLCompactNode& compact = m_nodeData[index];
+    const unsigned int* operand = compact.operand;
+
+    const char* fileName = m_fileNames[compact.fileId];
+    if (fileName != NULL)
+    {
+        fileName = tree->AddString(fileName);
+    }
+    const int line = compact.line;
+
+    HLSLNode* result = NULL;
+    switch (compact.nodeType)
+    {
+    case HLSLNodeType_Declaration:
+        {
+            HLSLDeclaration* declaration = AddExpandedNode<HLSLDeclaration>(tree, nodes, index, fileName, line);
+            ExpandType(tree, nodes, compact.type, declaration->type);
+            declaration->name               = ExpandString(tree, operand[0]);
+            declaration->registerName       = ExpandString(tree, operand[1]);
+            declaration->nextDeclaration    = static_cast<HLSLDeclaration*>(ExpandNode(tree, nodes, operand[2]));
+            declaration->assignment         = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[3]));
+            result = declaration;
+        }
+        break;
+    case HLSLNodeType_Struct:
+        {
+            HLSLStruct* structure = AddExpandedNode<HLSLStruct>(tree, nodes, index, fileName, line);
+            structure->name     = ExpandString(tree, operand[0]);
+            structure->field    = static_cast<HLSLStructField*>(ExpandList(tree, nodes, operand[1]));
+            result = structure;
+        }
+        break;
+    case HLSLNodeType_StructField:
+        {
+            HLSLStructField* field = AddExpandedNode<HLSLStructField>(tree, nodes, index, fileName, line);
+            ExpandType(tree, nodes, compact.type, field->type);
+            field->name         = ExpandString(tree, operand[0]);
+            field->semantic     = ExpandString(tree, operand[1]);
+            result = field;
+        }
+        break;
+    case HLSLNodeType_Buffer:
+        {
+            HLSLBuffer* buffer = AddExpandedNode<HLSLBuffer>(tree, nodes, index, fileName, line);
+            buffer->name            = ExpandString(tree, operand[0]);
+            buffer->registerName    = ExpandString(tree, operand[1]);
+            buffer->field           = static_cast<HLSLBufferField*>(ExpandList(tree, nodes, operand[2]));
+            result = buffer;
+        }
+        break;
+    case HLSLNodeType_BufferField:
+        {
+            HLSLBufferField* field = AddExpandedNode<HLSLBufferField>(tree, nodes, index, fileName, line);
+            ExpandType(tree, nodes, compact.type, field->type);
+            field->name         = ExpandString(tree, operand[0]);
+            result = field;
+        }
+        break;
+    case HLSLNodeType_Function:
+        {
+            HLSLFunction* function = AddExpandedNode<HLSLFunction>(tree, nodes, index, fileName, line);
+            ExpandType(tree, nodes, compact.type, function->returnType);
+            function->name          = ExpandString(tree, operand[0]);
+            function->semantic      = ExpandString(tree, operand[1]);
+            function->argument      = static_cast<HLSLArgument*>(ExpandList(tree, nodes, operand[2]));
+            function->statement     = static_cast<HLSLStatement*>(ExpandList(tree, nodes, operand[3]));
+            for (const HLSLArgument* argument = function->argument; argument != NULL; argument = argument->nextArgument)
+            {
+                ++function->numArguments;
+            }
+            result = function;
+        }
+        break;
+    case HLSLNodeType_Argument:
+        {
+            HLSLArgument* argument = AddExpandedNode<HLSLArgument>(tree, nodes, index, fileName, line);
+            ExpandType(tree, nodes, compact.type, argument->type);
+            argument->name          = ExpandString(tree, operand[0]);
+            argument->modifier      = static_cast<HLSLArgumentModifier>(operand[1]);
+            argument->semantic      = ExpandString(tree, operand[2]);
+            result = argument;
+        }
+        break;
+    case HLSLNodeType_ExpressionStatement:
+        {
+            HLSLExpressionStatement* statement = AddExpandedNode<HLSLExpressionStatement>(tree, nodes, index, fileName, line);
+            statement->expression   = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[0]));
+            result = statement;
+        }
+        break;
+    case HLSLNodeType_ReturnStatement:
+        {
+            HLSLReturnStatement* statement = AddExpandedNode<HLSLReturnStatement>(tree, nodes, index, fileName, line);
+            statement->expression   = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[0]));
+            result = statement;
+        }
+        break;
+    case HLSLNodeType_DiscardStatement:
+        result = AddExpandedNode<HLSLDiscardStatement>(tree, nodes, index, fileName, line);
+        break;
+    case HLSLNodeType_BreakStatement:
+        result = AddExpandedNode<HLSLBreakStatement>(tree, nodes, index, fileName, line);
+        break;
+    case HLSLNodeType_ContinueStatement:
+        result = AddExpandedNode<HLSLContinueStatement>(tree, nodes, index, fileName, line);
+        break;
+    case HLSLNodeType_IfStatement:
+        {
+            HLSLIfStatement* statement = AddExpandedNode<HLSLIfStatement>(tree, nodes, index, fileName, line);
+            statement->condition        = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[0]));
+            statement->statement        = static_cast<HLSLStatement*>(ExpandList(tree, nodes, operand[1]));
+            statement->elseStatement    = static_cast<HLSLStatement*>(ExpandList(tree, nodes, operand[2]));
+            result = statement;
+        }
+        break;
+    case HLSLNodeType_ForStatement:
+        {
+            HLSLForStatement* statement = AddExpandedNode<HLSLForStatement>(tree, nodes, index, fileName, line);
+            statement->initialization   = static_cast<HLSLDeclaration*>(ExpandNode(tree, nodes, operand[0]));
+            statement->condition        = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[1]));
+            statement->increment        = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[2]));
+            statement->statement        = static_cast<HLSLStatement*>(ExpandList(tree, nodes, operand[3]));
+            result = statement;
+        }
+        break;
+    case HLSLNodeType_UnaryExpression:
+        {
+            HLSLUnaryExpression* expression = AddExpandedNode<HLSLUnaryExpression>(tree, nodes, index, fileName, line);
+            expression->unaryOp     = static_cast<HLSLUnaryOp>(operand[0]);
+            expression->expression  = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[1]));
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_BinaryExpression:
+        {
+            HLSLBinaryExpression* expression = AddExpandedNode<HLSLBinaryExpression>(tree, nodes, index, fileName, line);
+            expression->binaryOp    = static_cast<HLSLBinaryOp>(operand[0]);
+            expression->expression1 = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[1]));
+            expression->expression2 = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[2]));
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_ConditionalExpression:
+        {
+            HLSLConditionalExpression* expression = AddExpandedNode<HLSLConditionalExpression>(tree, nodes, index, fileName, line);
+            expression->condition       = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[0]));
+            expression->trueExpression  = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[1]));
+            expression->falseExpression = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[2]));
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_CastingExpression:
+        {
+            HLSLCastingExpression* expression = AddExpandedNode<HLSLCastingExpression>(tree, nodes, index, fileName, line);
+            ExpandType(tree, nodes, operand[0], expression->type);
+            expression->expression  = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[1]));
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_LiteralExpression:
+        {
+            HLSLLiteralExpression* expression = AddExpandedNode<HLSLLiteralExpression>(tree, nodes, index, fileName, line);
+            expression->type = static_cast<HLSLBaseType>(operand[0]);
+            switch (expression->type)
+            {
+            case HLSLBaseType_Bool:
+                expression->bValue = operand[1] != 0;
+                break;
+            case HLSLBaseType_Float:
+            case HLSLBaseType_Half:
+                memcpy(&expression->fValue, &operand[1], sizeof(float));
+                break;
+            default:
+                expression->iValue = static_cast<int>(operand[1]);
+                break;
+            }
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_IdentifierExpression:
+        {
+            HLSLIdentifierExpression* expression = AddExpandedNode<HLSLIdentifierExpression>(tree, nodes, index, fileName, line);
+            expression->name    = ExpandString(tree, operand[0]);
+            expression->global  = operand[1] != 0;
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_ConstructorExpression:
+        {
+            HLSLConstructorExpression* expression = AddExpandedNode<HLSLConstructorExpression>(tree, nodes, index, fileName, line);
+            ExpandType(tree, nodes, operand[0], expression->type);
+            expression->argument    = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[1]));
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_MemberAccess:
+        {
+            HLSLMemberAccess* expression = AddExpandedNode<HLSLMemberAccess>(tree, nodes, index, fileName, line);
+            expression->object  = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[0]));
+            expression->field   = ExpandString(tree, operand[1]);
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_ArrayAccess:
+        {
+            HLSLArrayAccess* expression = AddExpandedNode<HLSLArrayAccess>(tree, nodes, index, fileName, line);
+            expression->array   = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[0]));
+            expression->index   = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[1]));
+            result = expression;
+        }
+        break;
+    case HLSLNodeType_FunctionCall:
+        {
+            HLSLFunctionCall* expression = AddExpandedNode<HLSLFunctionCall>(tree, nodes, index, fileName, line);
+            expression->function        = static_cast<HLSLFunction*>(ExpandNode(tree, nodes, operand[0]));
+            expression->numArguments    = static_cast<int>(operand[1]);
+            expression->argument        = static_cast<HLSLExpression*>(ExpandList(tree, nodes, operand[2]));
+            result = expression;
+        }
+        break;
+    default:
+        ASSERT(0);
+        break;
+    }
+
+    if (result != NULL && GetIsExpression(result->nodeType))
+    {
+        ExpandType(tree, nodes, compact.type, static_cast<HLSLExpression*>(result)->expressionType);
+    }
+
+    return result;
+
+}
+
+HLSLNode* HLSLCompactTree::ExpandList(HLSLTree* tree, Array<HLSLNode*>& nodes, HLSLNodeIndex index) const
+{
+    HLSLNode* first = NULL;
+    HLSLNode* last  = NULL;
+    for (; index != 0; index = m_nodeData[index].next)
+    {
+        HLSLNode* node = ExpandNode(tree, nodes, index);
+        if (last == NULL)
+        {
+            first = node;
+        }
+        else
+        {
+            switch (last->nodeType)
+            {
+            case HLSLNodeType_StructField:
+                static_cast<HLSLStructField*>(last)->nextField = static_cast<HLSLStructField*>(node);
+                break;
+            case HLSLNodeType_BufferField:
+                static_cast<HLSLBufferField*>(last)->nextField = static_cast<HLSLBufferField*>(node);
+                break;
+            case HLSLNodeType_Argument:
+                static_cast<HLSLArgument*>(last)->nextArgument = static_cast<HLSLArgument*>(node);
+                break;
+            default:
+                if (GetIsExpression(last->nodeType))
+                {
+                    static_cast<HLSLExpression*>(last)->nextExpression = static_cast<HLSLExpression*>(node);
+                }
+                else
+                {
+                    static_cast<HLSLStatement*>(last)->nextStatement = static_cast<HLSLStatement*>(node);
+                }
+                break;
+            }
+        }
+        last = node;
+    }
+    return first;
+}
+
+void HLSLCompactTree::ExpandType(HLSLTree* tree, Array<HLSLNode*>& nodes, HLSLTypeId typeId, HLSLType& type) const
+{
+    const HLSLCompactType& compact = m_types[typeId];
+    type.baseType   = compact.baseType;
+    type.typeName   = ExpandString(tree, compact.typeName);
+    type.array      = compact.array;
+    type.arraySize  = static_cast<HLSLExpression*>(ExpandList(tree, nodes, compact.arraySize));
+    type.constant   = compact.constant;
+}
+
+const char* HLSLCompactTree::ExpandString(HLSLTree* tree, HLSLStringId stringId) const
+{
+    const char* string = m_strings[stringId];
+    return (string != NULL) ? tree->AddString(string) : NULL;
+}
+
+// Serialized format: the header, then the nodes, the types, the offsets of the
+// strings and file names in the string data, and finally the string data.
+struct HLSLCompactTree::SerializedHeader
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    byteOrder;
+    uint32_t    numNodes;
+    uint32_t    numTypes;
+    uint32_t    numStrings;
+    uint32_t    numFileNames;
+    uint32_t    root;
+    uint32_t    stringDataSize;
+    uint32_t    reserved;
+    uint64_t    checksum;       // Hash of everything after the header.
+};
+
+struct HLSLCompactTree::SerializedType
+{
+    uint32_t    baseType;
+    uint32_t    typeName;
+    uint32_t    arraySize;
+    uint32_t    flags;
+};
+
+static const uint32_t _serializedMagic      = 0x54434C48;   // "HLCT"
+static const uint32_t _serializedVersion    = 1;            // Increment when the nodes or format change.
+static const uint32_t _serializedByteOrder  = 0x01020304;
+static const uint32_t _serializedNullString = 0xFFFFFFFF;
+
+static const uint32_t _serializedTypeArray      = 1 << 0;
+static const uint32_t _serializedTypeConstant   = 1 << 1;
+
+size_t HLSLCompactTree::GetSerializedSize() const
+{
+    size_t size = sizeof(SerializedHeader) +
+                  m_numNodes * sizeof(HLSLCompactNode) +
+                  m_types.GetSize() * sizeof(SerializedType) +
+                  (m_strings.GetSize() + m_fileNames.GetSize()) * sizeof(uint32_t);
+    for (int i = 0; i < m_strings.GetSize(); ++i)
+    {
+        size += (m_strings[i] != NULL) ? strlen(m_strings[i]) + 1 : 0;
+    }
+    for (int i = 0; i < m_fileNames.GetSize(); ++i)
+    {
+        size += (m_fileNames[i] != NULL) ? strlen(m_fileNames[i]) + 1 : 0;
+    }
+    return size;
+}
+
+void HLSLCompactTree::Serialize(void* buffer) const
+{
+    char* data = static_cast<char*>(buffer);
+    char* p = data + sizeof(SerializedHeader);
+
+    if (m_numNodes > 0)
+    {
+        memcpy(p, m_nodeData, m_numNodes * sizeof(HLSLCompactNode));
+        p += m_numNodes * sizeof(HLSLCompactNode);
+    }
+
+    for (int i = 0; i < m_types.GetSize(); ++i)
+    {
+        SerializedType type;
+        type.baseType   = m_types[i].baseType;
+        type.typeName   = m_types[i].typeName;
+        type.arraySize  = m_types[i].arraySize;
+        type.flags      = (m_types[i].array ? _serializedTypeArray : 0) | (m_types[i].constant ? _serializedTypeConstant : 0);
+        memcpy(p, &type, sizeof(type));
+        p += sizeof(type);
+    }
+
+    // The strings and file names share one table of offsets.
+    char* offsets = p;
+    p += (m_strings.GetSize() + m_fileNames.GetSize()) * sizeof(uint32_t);
+    char* stringData = p;
+    for (int i = 0; i < m_strings.GetSize() + m_fileNames.GetSize(); ++i)
+    {
+        const char* string = (i < m_strings.GetSize()) ? m_strings[i] : m_fileNames[i - m_strings.GetSize()];
+        uint32_t offset = _serializedNullString;
+        if (string != NULL)
+        {
+            size_t length = strlen(string) + 1;
+            offset = static_cast<uint32_t>(p - stringData);
+            memcpy(p, string, length);
+            p += length;
+        }
+        memcpy(offsets + i * sizeof(uint32_t), &offset, sizeof(offset));
+    }
+
+    SerializedHeader header;
+    header.magic            = _serializedMagic;
+    header.version          = _serializedVersion;
+    header.byteOrder        = _serializedByteOrder;
+    header.numNodes         = m_numNodes;
+    header.numTypes         = m_types.GetSize();
+    header.numStrings       = m_strings.GetSize();
+    header.numFileNames     = m_fileNames.GetSize();
+    header.root             = m_root;
+    header.stringDataSize   = static_cast<uint32_t>(p - stringData);
+    header.reserved         = 0;
+    header.checksum         = Hash_Compute128(data + sizeof(header), p - data - sizeof(header)).low;
+    memcpy(data, &header, sizeof(header));
+
+    ASSERT(static_cast<size_t>(p - data) == GetSerializedSize());
+}
+
+// Which lists a node can be linked into, for checking the references between nodes.
+enum ListKind
+{
+    ListKind_None,
+    ListKind_Statement,
+    ListKind_Expression,
+    ListKind_StructField,
+    ListKind_BufferField,
+    ListKind_Argument,
+};
+
+static ListKind GetListKind(int nodeType)
+{
+    switch (nodeType)
+    {
+    case HLSLNodeType_Declaration:
+    case HLSLNodeType_Struct:
+    case HLSLNodeType_Buffer:
+    case HLSLNodeType_Function:
+    case HLSLNodeType_ExpressionStatement:
+    case HLSLNodeType_ReturnStatement:
+    case HLSLNodeType_DiscardStatement:
+    case HLSLNodeType_BreakStatement:
+    case HLSLNodeType_ContinueStatement:
+    case HLSLNodeType_IfStatement:
+    case HLSLNodeType_ForStatement:
+        return ListKind_Statement;
+    case HLSLNodeType_StructField:
+        return ListKind_StructField;
+    case HLSLNodeType_BufferField:
+        return ListKind_BufferField;
+    case HLSLNodeType_Argument:
+        return ListKind_Argument;
+    case HLSLNodeType_Root:
+    case HLSLNodeType_Expression:
+        // Never referenced by another node.
+        return ListKind_None;
+    default:
+        return GetIsExpression(nodeType) ? ListKind_Expression : ListKind_None;
+    }
+}
+
+namespace
+{
+
+/** Limits for the indices in serialized nodes, from the header. */
+struct SerializedLimits
+{
+    const HLSLCompactNode*  nodes;
+    uint32_t                numNodes;
+    uint32_t                numTypes;
+    uint32_t                numStrings;
+    uint32_t                numFileNames;
+};
+
+}
+
+// References which are checked against a parent require a higher index. The
+// children are always built after their parent, so this stops the tree from
+// containing itself.
+static bool GetIsValidList(const SerializedLimits& limits, uint32_t parent, uint32_t index, ListKind kind)
+{
+    return index == 0 || (index > parent && index < limits.numNodes && GetListKind(limits.nodes[index].nodeType) == kind);
+}
+
+static bool GetIsValidNode(const SerializedLimits& limits, uint32_t parent, uint32_t index, int nodeType)
+{
+    return index == 0 || (index > parent && index < limits.numNodes && limits.nodes[index].nodeType == nodeType);
+}
+
+static bool GetIsValidString(const SerializedLimits& limits, uint32_t stringId)
+{
+    return stringId < limits.numStrings;
+}
+
+/**
+ * Checks that the node only references nodes, types and strings which exist,
+ * and that the nodes it references are of the types Expand expects. The
+ * checksum only detects damage, so a file which was made by another version or
+ * tool must not be able to make Expand read out of bounds.
+ */
+static bool GetIsValidNode(const SerializedLimits& limits, uint32_t index)
+{
+    const HLSLCompactNode& node = limits.nodes[index];
+    const unsigned int* operand = node.operand;
+
+    if (node.nodeType >= HLSLNodeType_Count || node.fileId >= limits.numFileNames)
+    {
+        return false;
+    }
+    // Lists are built in order, so the next node also has a higher index and the
+    // lists can't loop.
+    ListKind kind = GetListKind(node.nodeType);
+    if (node.next != 0 && (kind == ListKind_None || !GetIsValidList(limits, index, node.next, kind)))
+    {
+        return false;
+    }
+    if (node.type >= limits.numTypes && (node.type != 0 || GetIsExpression(node.nodeType)))
+    {
+        return false;
+    }
+
+    switch (node.nodeType)
+    {
+    case HLSLNodeType_Root:
+        return GetIsValidList(limits, index, operand[0], ListKind_Statement);
+    case HLSLNodeType_Declaration:
+        return node.type < limits.numTypes &&
+               GetIsValidString(limits, operand[0]) &&
+               GetIsValidString(limits, operand[1]) &&
+               GetIsValidNode(limits, index, operand[2], HLSLNodeType_Declaration) &&
+               GetIsValidList(limits, index, operand[3], ListKind_Expression);
+    case HLSLNodeType_Struct:
+        return GetIsValidString(limits, operand[0]) &&
+               GetIsValidList(limits, index, operand[1], ListKind_StructField);
+    case HLSLNodeType_StructField:
+        return node.type < limits.numTypes &&
+               GetIsValidString(limits, operand[0]) &&
+               GetIsValidString(limits, operand[1]);
+    case HLSLNodeType_Buffer:
+        return GetIsValidString(limits, operand[0]) &&
+               GetIsValidString(limits, operand[1]) &&
+               GetIsValidList(limits, index, operand[2], ListKind_BufferField);
+    case HLSLNodeType_BufferField:
+        return node.type < limits.numTypes &&
+               GetIsValidString(limits, operand[0]);
+    case HLSLNodeType_Function:
+        return node.type < limits.numTypes &&
+               GetIsValidString(limits, operand[0]) &&
+               GetIsValidString(limits, operand[1]) &&
+               GetIsValidList(limits, index, operand[2], ListKind_Argument) &&
+               GetIsValidList(limits, index, operand[3], ListKind_Statement);
+    case HLSLNodeType_Argument:
+        return node.type < limits.numTypes &&
+               GetIsValidString(limits, operand[0]) &&
+               operand[1] <= HLSLArgumentModifier_Uniform &&
+               GetIsValidString(limits, operand[2]);
+    case HLSLNodeType_ExpressionStatement:
+    case HLSLNodeType_ReturnStatement:
+        return GetIsValidList(limits, index, operand[0], ListKind_Expression);
+    case HLSLNodeType_IfStatement:
+        return GetIsValidList(limits, index, operand[0], ListKind_Expression) &&
+               GetIsValidList(limits, index, operand[1], ListKind_Statement) &&
+               GetIsValidList(limits, index, operand[2], ListKind_Statement);
+    case HLSLNodeType_ForStatement:
+        return GetIsValidNode(limits, index, operand[0], HLSLNodeType_Declaration) &&
+               GetIsValidList(limits, index, operand[1], ListKind_Expression) &&
+               GetIsValidList(limits, index, operand[2], ListKind_Expression) &&
+               GetIsValidList(limits, index, operand[3], ListKind_Statement);
+    case HLSLNodeType_UnaryExpression:
+        return operand[0] <= HLSLUnaryOp_PostDecrement &&
+               GetIsValidList(limits, index, operand[1], ListKind_Expression);
+    case HLSLNodeType_BinaryExpression:
+        return operand[0] <= HLSLBinaryOp_DivAssign &&
+               GetIsValidList(limits, index, operand[1], ListKind_Expression) &&
+               GetIsValidList(limits, index, operand[2], ListKind_Expression);
+    case HLSLNodeType_ConditionalExpression:
+        return GetIsValidList(limits, index, operand[0], ListKind_Expression) &&
+               GetIsValidList(limits, index, operand[1], ListKind_Expression) &&
+               GetIsValidList(limits, index, operand[2], ListKind_Expression);
+    case HLSLNodeType_CastingExpression:
+    case HLSLNodeType_ConstructorExpression:
+        return operand[0] < limits.numTypes &&
+               GetIsValidList(limits, index, operand[1], ListKind_Expression);
+    case HLSLNodeType_LiteralExpression:
+        return operand[0] < HLSLBaseType_Count;
+    case HLSLNodeType_IdentifierExpression:
+        return GetIsValidString(limits, operand[0]);
+    case HLSLNodeType_MemberAccess:
+        return GetIsValidList(limits, index, operand[0], ListKind_Expression) &&
+               GetIsValidString(limits, operand[1]);
+    case HLSLNodeType_ArrayAccess:
+        return GetIsValidList(limits, index, operand[0], ListKind_Expression) &&
+               GetIsValidList(limits, index, operand[1], ListKind_Expression);
+    case HLSLNodeType_FunctionCall:
+        return GetIsValidNode(limits, 0, operand[0], HLSLNodeType_Function) &&
+               GetIsValidList(limits, index, operand[2], ListKind_Expression);
+    default:
+        // Statements without operands, and the reserved node which is never
+        // referenced.
+        return true;
+    }
+}
+
+bool HLSLCompactTree::Deserialize(const void* buffer, size_t size)
+{
+    return Read(static_cast<const char*>(buffer), size, false);
+}
+
+bool HLSLCompactTree::DeserializeInPlace(const void* buffer, size_t size)
+{
+    // The nodes only have 32-bit and smaller fields, and follow a header made of
+    // them, so they can only be read in place if the buffer is aligned for them.
+    if (reinterpret_cast<size_t>(buffer) % AlignOf<HLSLCompactNode>::value != 0)
+    {
+        return Read(static_cast<const char*>(buffer), size, false);
+    }
+    return Read(static_cast<const char*>(buffer), size, true);
+}
+
+bool HLSLCompactTree::Read(const char* data, size_t size, bool inPlace)
+{
+    ASSERT(m_numNodes == 0);
+
+    if (!ReadTables(data, size, inPlace))
+    {
+        // Leave the tree empty, so that it can be loaded again.
+        m_nodes.Resize(0);
+        m_types.Resize(0);
+        m_strings.Resize(0);
+        m_fileNames.Resize(0);
+        m_nodeData  = NULL;
+        m_numNodes  = 0;
+        m_root      = 0;
+        return false;
+    }
+    return true;
+}
+
+bool HLSLCompactTree::ReadTables(const char* data, size_t size, bool inPlace)
+{
+    // The header is copied out since the buffer may not be aligned.
+    SerializedHeader header;
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != _serializedMagic || header.version != _serializedVersion || header.byteOrder != _serializedByteOrder)
+    {
+        return false;
+    }
+
+    uint64_t numStrings = static_cast<uint64_t>(header.numStrings) + header.numFileNames;
+    uint64_t expectedSize = sizeof(header) +
+                            static_cast<uint64_t>(header.numNodes) * sizeof(HLSLCompactNode) +
+                            static_cast<uint64_t>(header.numTypes) * sizeof(SerializedType) +
+                            numStrings * sizeof(uint32_t) +
+                            header.stringDataSize;
+    if (expectedSize != size || header.numNodes == 0 || header.numNodes > 0x7FFFFFFF || header.root >= header.numNodes ||
+        header.numStrings == 0 || header.numFileNames == 0 || header.numFileNames > 0x10000 ||
+        Hash_Compute128(data + sizeof(header), size - sizeof(header)).low != header.checksum)
+    {
+        return false;
+    }
+
+    const char* p = data + sizeof(header);
+
+    if (inPlace)
+    {
+        m_nodeData = reinterpret_cast<const HLSLCompactNode*>(p);
+    }
+    else
+    {
+        m_nodes.Resize(header.numNodes);
+        memcpy(&m_nodes[0], p, header.numNodes * sizeof(HLSLCompactNode));
+        m_nodeData = &m_nodes[0];
+    }
+    p += header.numNodes * sizeof(HLSLCompactNode);
+
+    SerializedLimits limits;
+    limits.nodes        = m_nodeData;
+    limits.numNodes     = header.numNodes;
+    limits.numTypes     = header.numTypes;
+    limits.numStrings   = header.numStrings;
+    limits.numFileNames = header.numFileNames;
+
+    m_types.Resize(header.numTypes);
+    for (uint32_t i = 0; i < header.numTypes; ++i)
+    {
+        SerializedType type;
+        memcpy(&type, p, sizeof(type));
+        p += sizeof(type);
+        if (type.baseType >= HLSLBaseType_Count || !GetIsValidString(limits, type.typeName) || !GetIsValidList(limits, 0, type.arraySize, ListKind_Expression))
+        {
+            return false;
+        }
+        m_types[i].baseType     = static_cast<HLSLBaseType>(type.baseType);
+        m_types[i].typeName     = type.typeName;
+        m_types[i].arraySize    = type.arraySize;
+        m_types[i].array        = (type.flags & _serializedTypeArray) != 0;
+        m_types[i].constant     = (type.flags & _serializedTypeConstant) != 0;
+    }
+
+    if (m_nodeData[header.root].nodeType != HLSLNodeType_Root)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.numNodes; ++i)
+    {
+        if (!GetIsValidNode(limits, i))
+        {
+            return false;
+        }
+    }
+
+    const char* offsets = p;
+    const char* stringData = p + numStrings * sizeof(uint32_t);
+    if (header.stringDataSize > 0 && stringData[header.stringDataSize - 1] != 0)
+    {
+        return false;
+    }
+
+    // The strings are null terminated in the buffer, so when it's read in place
+    // they're interned without being copied.
+    m_strings.Resize(header.numStrings);
+    m_fileNames.Resize(header.numFileNames);
+    for (uint64_t i = 0; i < numStrings; ++i)
+    {
+        uint32_t offset;
+        memcpy(&offset, offsets + i * sizeof(uint32_t), sizeof(offset));
+        const char* string = NULL;
+        if (offset != _serializedNullString)
+        {
+            if (offset >= header.stringDataSize)
+            {
+                return false;
+            }
+            const char* source = stringData + offset;
+            string = inPlace ? m_stringPool.AddExternalString(source, strlen(source)) : m_stringPool.AddString(source);
+        }
+        if (i < header.numStrings)
+        {
+            m_strings[static_cast<int>(i)] = string;
+        }
+        else
+        {
+            m_fileNames[static_cast<int>(i - header.numStrings)] = string;
+        }
+    }
+
+    m_numNodes  = static_cast<int>(header.numNodes);
+    m_root      = header.root;
+    return true;
+}
+
+bool HLSLCompactTree::Save(const char* fileName) const
+{
+    size_t size = GetSerializedSize();
+    void* buffer = m_allocator->Allocate(size);
+    Serialize(buffer);
+    bool result = File_WriteAtomic(fileName, static_cast<const char*>(buffer), size);
+    m_allocator->Free(buffer, size);
+    return result;
+}
+
+bool HLSLCompactTree::Load(const char* fileName)
+{
+    ASSERT(m_file.contents == NULL);
+    if (!File_Map(m_allocator, fileName, m_file))
+    {
+        return false;
+    }
+    // The nodes and strings are used from the file, so it's kept until the tree
+    // is destroyed.
+    if (!DeserializeInPlace(m_file.contents, m_file.length))
+    {
+        File_Unmap(m_allocator, m_file);
+        return false;
+    }
+    return true;
+}
+
+}
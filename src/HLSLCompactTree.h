@@ -0,0 +1,200 @@
+#ifndef HLSL_COMPACT_TREE_H
+#define HLSL_COMPACT_TREE_H
+
+#include "Engine/Array.h"
+#include "Engine/Assert.h"
+#include "Engine/File.h"
+#include "Engine/StringPool.h"
+
+#include "HLSLTree.h"
+
+namespace M4
+{
+
+/** Index of a node in an HLSLCompactTree. 0 is used for no node. */
+typedef unsigned int HLSLNodeIndex;
+
+/** Index of an interned type in an HLSLCompactTree. */
+typedef unsigned int HLSLTypeId;
+
+/** Index of a string in an HLSLCompactTree. 0 is used for NULL. */
+typedef unsigned int HLSLStringId;
+
+struct HLSLCompactType
+{
+    HLSLBaseType        baseType;
+    HLSLStringId        typeName;       // For user defined types.
+    HLSLNodeIndex       arraySize;
+    bool                array;
+    bool                constant;
+};
+
+/**
+ * Node in an HLSLCompactTree. The meaning of the operands depends on the node type:
+ *
+ *  Root                    statement
+ *  Declaration             name, registerName, nextDeclaration, assignment
+ *  Struct                  name, field
+ *  StructField             name, semantic
+ *  Buffer                  name, registerName, field
+ *  BufferField             name
+ *  Function                name, semantic, argument, statement
+ *  Argument                name, modifier, semantic
+ *  ExpressionStatement     expression
+ *  ReturnStatement         expression
+ *  IfStatement             condition, statement, elseStatement
+ *  ForStatement            initialization, condition, increment, statement
+ *  UnaryExpression         unaryOp, expression
+ *  BinaryExpression        binaryOp, expression1, expression2
+ *  ConditionalExpression   condition, trueExpression, falseExpression
+ *  CastingExpression       type, expression
+ *  LiteralExpression       type, value (the bits of the float, int or bool)
+ *  IdentifierExpression    name, global
+ *  ConstructorExpression   type, argument
+ *  MemberAccess            object, field
+ *  ArrayAccess             array, index
+ *  FunctionCall            function, numArguments, argument
+ *
+ * Names are string ids, types (other than the literal type) are type ids and
+ * the rest are node indices.
+ */
+struct HLSLCompactNode
+{
+    unsigned char       nodeType;
+    unsigned char       reserved;
+    unsigned short      fileId;
+    int                 line;
+    HLSLTypeId          type;           // Expression type, declared type or return type.
+    HLSLNodeIndex       next;           // Next statement, expression, field or argument.
+    unsigned int        operand[4];
+};
+
+/**
+ * Alternative representation of an HLSLTree which uses about a third of the
+ * memory. The nodes are stored in a single array and reference each other by
+ * 32-bit index, file names are stored once in a table and types are interned.
+ *
+ * The generators read the nodes in place through HLSLCompactTreeAccessor, so
+ * a compact tree doesn't need to be expanded before it's translated.
+ */
+class HLSLCompactTree
+{
+
+public:
+
+    explicit HLSLCompactTree(Allocator* allocator);
+    ~HLSLCompactTree();
+
+    /** Builds the compact representation of a tree. The compact tree doesn't
+    reference the original tree, so the original can be destroyed afterwards. */
+    void Build(const HLSLTree* tree);
+
+    /** Recreates the nodes in a tree which hasn't had any statements added. */
+    void Expand(HLSLTree* tree) const;
+
+    HLSLNodeIndex GetRoot() const;
+    int GetNumNodes() const;
+
+    const HLSLCompactNode& GetNode(HLSLNodeIndex index) const;
+    const HLSLCompactType& GetType(HLSLTypeId typeId) const;
+    const char* GetString(HLSLStringId stringId) const;
+    const char* GetFileName(const HLSLCompactNode& node) const;
+
+    /** Returns true if the string is a name or file name in the tree. */
+    bool GetContainsString(const char* string) const;
+
+    /** Returns the number of bytes used by the nodes, types and tables. */
+    size_t GetMemorySize() const;
+
+    /** Returns the number of bytes written by Serialize. */
+    size_t GetSerializedSize() const;
+
+    /**
+     * Writes the tree in a binary format which Deserialize reads back without any
+     * parsing or type checking. The nodes and types reference each other by index,
+     * so they're stored as is, and strings are stored as offsets into a table. The
+     * format has a versioned header and uses the native byte order.
+     */
+    void Serialize(void* buffer) const;
+
+    /** Loads a tree written by Serialize into a tree which hasn't been built.
+    Returns false, leaving the tree empty, if the data is from another version
+    or is damaged. The data is copied, so the buffer can be freed afterwards. */
+    bool Deserialize(const void* buffer, size_t size);
+
+    /** Like Deserialize, but the nodes and strings are used from the buffer
+    rather than copied, so the buffer must outlive the tree. They're copied if
+    the buffer isn't aligned for the nodes. */
+    bool DeserializeInPlace(const void* buffer, size_t size);
+
+    /** Serializes the tree to a file. */
+    bool Save(const char* fileName) const;
+
+    /** Deserializes the tree from a file written by Save. The file is mapped
+    into memory where possible and read in place, so it's kept until the tree
+    is destroyed. */
+    bool Load(const char* fileName);
+
+private:
+
+    struct BuildContext;
+
+    HLSLNodeIndex CompactNode(BuildContext& context, const HLSLNode* node, HLSLNodeType nodeType);
+
+    template<typename T>
+    HLSLNodeIndex CompactList(BuildContext& context, const T* node, T* T::*next);
+
+    HLSLTypeId CompactType(BuildContext& context, const HLSLType& type);
+    HLSLStringId CompactString(BuildContext& context, const char* string);
+    unsigned short CompactFileName(BuildContext& context, const char* fileName);
+
+    HLSLNode* ExpandNode(HLSLTree* tree, Array<HLSLNode*>& nodes, HLSLNodeIndex index) const;
+    HLSLNode* ExpandList(HLSLTree* tree, Array<HLSLNode*>& nodes, HLSLNodeIndex index) const;
+    void ExpandType(HLSLTree* tree, Array<HLSLNode*>& nodes, HLSLTypeId typeId, HLSLType& type) const;
+    const char* ExpandString(HLSLTree* tree, HLSLStringId stringId) const;
+
+    struct SerializedHeader;
+    struct SerializedType;
+
+    bool Read(const char* data, size_t size, bool inPlace);
+    bool ReadTables(const char* data, size_t size, bool inPlace);
+
+private:
+
+    Allocator*                  m_allocator;
+    StringPool                  m_stringPool;
+    Array<HLSLCompactNode>      m_nodes;
+    const HLSLCompactNode*      m_nodeData;     // m_nodes, or the nodes in a buffer read in place.
+    int                         m_numNodes;
+    Array<HLSLCompactType>      m_types;
+    Array<const char*>          m_strings;
+    Array<const char*>          m_fileNames;
+    HLSLNodeIndex               m_root;
+    FileView                    m_file;         // Read in place by Load.
+
+};
+
+inline const HLSLCompactNode& HLSLCompactTree::GetNode(HLSLNodeIndex index) const
+{
+    ASSERT(index < static_cast<HLSLNodeIndex>(m_numNodes));
+    return m_nodeData[index];
+}
+
+inline const HLSLCompactType& HLSLCompactTree::GetType(HLSLTypeId typeId) const
+{
+    return m_types[typeId];
+}
+
+inline const char* HLSLCompactTree::GetString(HLSLStringId stringId) const
+{
+    return m_strings[stringId];
+}
+
+inline const char* HLSLCompactTree::GetFileName(const HLSLCompactNode& node) const
+{
+    return m_fileNames[node.fileId];
+}
+
+}
+
+#endif
@@ -14,11 +14,15 @@
 #include "HLSLGenerator.h"
 #include "HLSLParser.h"
 #include "HLSLTree.h"
+#include "HLSLTreeAccessor.h"
+
+#include <stdio.h>
 
 namespace M4
 {
 
-static const char* GetTypeName(const HLSLType& type)
+template<typename Type>
+static const char* GetTypeName(const Type& type)
 {
     switch (type.baseType)
     {
@@ -52,7 +56,8 @@ static const char* GetTypeName(const HLSLType& type)
     return "?";
 }
 
-static bool GetIsSamplerType(const HLSLType& type)
+template<typename Type>
+static bool GetIsSamplerType(const Type& type)
 {
     return type.baseType == HLSLBaseType_Sampler2D ||
            type.baseType == HLSLBaseType_SamplerCube;
@@ -77,7 +82,7 @@ static int GetFunctionArguments(HLSLFunctionCall* functionCall, HLSLExpression*
 HLSLGenerator::HLSLGenerator(Allocator* allocator) :
     m_writer(allocator)
 {
-    m_tree                          = NULL;
+    m_instrumentation               = NULL;
     m_entryName                     = NULL;
     m_legacy                        = false;
     m_textureSampler2DStruct[0]     = 0;
@@ -93,23 +98,31 @@ HLSLGenerator::HLSLGenerator(Allocator* allocator) :
 
 bool HLSLGenerator::Generate(const HLSLTree* tree, Target target, const char* entryName, bool legacy)
 {
+    return GenerateTree(HLSLTreeAccessor(tree), target, entryName, legacy);
+}
+
+bool HLSLGenerator::Generate(const HLSLCompactTree* tree, Target target, const char* entryName, bool legacy)
+{
+    return GenerateTree(HLSLCompactTreeAccessor(tree), target, entryName, legacy);
+}
+
+template<typename Tree>
+bool HLSLGenerator::GenerateTree(const Tree& tree, Target target, const char* entryName, bool legacy)
+{
+    HLSLPhaseScope phase(m_instrumentation, HLSLPhase_Generate);
 
-    m_tree      = tree;
     m_entryName = entryName;
     m_legacy    = legacy;
 
-    HLSLRoot* root = m_tree->GetRoot();
-    HLSLStatement* statement = root->statement;
-
-    ChooseUniqueName("TextureSampler2D",            m_textureSampler2DStruct,   sizeof(m_textureSampler2DStruct));
-    ChooseUniqueName("CreateTextureSampler2D",      m_textureSampler2DCtor,     sizeof(m_textureSampler2DCtor));
-    ChooseUniqueName("TextureSamplerCube",          m_textureSamplerCubeStruct, sizeof(m_textureSamplerCubeStruct));
-    ChooseUniqueName("CreateTextureSamplerCube",    m_textureSamplerCubeCtor,   sizeof(m_textureSamplerCubeCtor));
-    ChooseUniqueName("tex2D",                       m_tex2DFunction,            sizeof(m_tex2DFunction));
-    ChooseUniqueName("tex2Dproj",                   m_tex2DProjFunction,        sizeof(m_tex2DProjFunction));
-    ChooseUniqueName("tex2Dlod",                    m_tex2DLodFunction,         sizeof(m_tex2DLodFunction));
-    ChooseUniqueName("texCUBE",                     m_texCubeFunction,          sizeof(m_texCubeFunction));
-    ChooseUniqueName("texCUBEbias",                 m_texCubeBiasFunction,      sizeof(m_texCubeBiasFunction));
+    ChooseUniqueName(tree, "TextureSampler2D",            m_textureSampler2DStruct,   sizeof(m_textureSampler2DStruct));
+    ChooseUniqueName(tree, "CreateTextureSampler2D",      m_textureSampler2DCtor,     sizeof(m_textureSampler2DCtor));
+    ChooseUniqueName(tree, "TextureSamplerCube",          m_textureSamplerCubeStruct, sizeof(m_textureSamplerCubeStruct));
+    ChooseUniqueName(tree, "CreateTextureSamplerCube",    m_textureSamplerCubeCtor,   sizeof(m_textureSamplerCubeCtor));
+    ChooseUniqueName(tree, "tex2D",                       m_tex2DFunction,            sizeof(m_tex2DFunction));
+    ChooseUniqueName(tree, "tex2Dproj",                   m_tex2DProjFunction,        sizeof(m_tex2DProjFunction));
+    ChooseUniqueName(tree, "tex2Dlod",                    m_tex2DLodFunction,         sizeof(m_tex2DLodFunction));
+    ChooseUniqueName(tree, "texCUBE",                     m_texCubeFunction,          sizeof(m_texCubeFunction));
+    ChooseUniqueName(tree, "texCUBEbias",                 m_texCubeBiasFunction,      sizeof(m_texCubeBiasFunction));
 
     if (!m_legacy)
     {
@@ -157,9 +170,13 @@ bool HLSLGenerator::Generate(const HLSLTree* tree, Target target, const char* en
 
     }
 
-    OutputStatements(0, statement);
+    OutputStatements(tree, 0, tree.GetRootStatements());
 
-    m_tree = NULL;
+    if (!m_writer.Flush())
+    {
+        Log_Error("Couldn't write the output");
+        return false;
+    }
     return true;
 
 }
@@ -169,34 +186,47 @@ const char* HLSLGenerator::GetResult() const
     return m_writer.GetResult();
 }
 
-void HLSLGenerator::OutputExpressionList(HLSLExpression* expression)
+void HLSLGenerator::SetSink(CodeSink* sink)
+{
+    m_writer.SetSink(sink);
+}
+
+void HLSLGenerator::SetInstrumentation(HLSLInstrumentation* instrumentation)
+{
+    m_instrumentation = instrumentation;
+}
+
+template<typename Tree>
+void HLSLGenerator::OutputExpressionList(const Tree& tree, typename Tree::Node expression)
 {
     int numExpressions = 0;
-    while (expression != NULL)
+    while (expression)
     {
         if (numExpressions > 0)
         {
             m_writer.Write(", ");
         }
-        OutputExpression(expression);
-        expression = expression->nextExpression;
+        OutputExpression(tree, expression);
+        expression = tree.GetNextExpression(expression);
         ++numExpressions;
     }
 }
 
-void HLSLGenerator::OutputExpression(HLSLExpression* expression)
+template<typename Tree>
+void HLSLGenerator::OutputExpression(const Tree& tree, typename Tree::Node expression)
 {
-    if (expression->nodeType == HLSLNodeType_IdentifierExpression)
+    HLSLNodeType nodeType = tree.GetNodeType(expression);
+    if (nodeType == HLSLNodeType_IdentifierExpression)
     {
-        HLSLIdentifierExpression* identifierExpression = static_cast<HLSLIdentifierExpression*>(expression);
-        const char* name = identifierExpression->name;
-        if (!m_legacy && GetIsSamplerType(identifierExpression->expressionType) && identifierExpression->global)
+        const char* name = tree.GetIdentifierName(expression);
+        const typename Tree::Type& expressionType = tree.GetExpressionType(expression);
+        if (!m_legacy && GetIsSamplerType(expressionType) && tree.GetIdentifierGlobal(expression))
         {
-            if (identifierExpression->expressionType.baseType == HLSLBaseType_Sampler2D)
+            if (expressionType.baseType == HLSLBaseType_Sampler2D)
             {
                 m_writer.Write("%s(%s_texture, %s_sampler)", m_textureSampler2DCtor, name, name);
             }
-            else if (identifierExpression->expressionType.baseType == HLSLBaseType_SamplerCube)
+            else if (expressionType.baseType == HLSLBaseType_SamplerCube)
             {
                 m_writer.Write("%s(%s_texture, %s_sampler)", m_textureSamplerCubeCtor, name, name);
             }
@@ -206,52 +236,43 @@ void HLSLGenerator::OutputExpression(HLSLExpression* expression)
             m_writer.Write("%s", name);
         }
     }
-    else if (expression->nodeType == HLSLNodeType_CastingExpression)
+    else if (nodeType == HLSLNodeType_CastingExpression)
     {
-        HLSLCastingExpression* castingExpression = static_cast<HLSLCastingExpression*>(expression);
         m_writer.Write("(");
-        OutputDeclaration(castingExpression->type, "");
+        OutputDeclaration(tree, tree.GetCastType(expression), "");
         m_writer.Write(")(");
-        OutputExpression(castingExpression->expression);
+        OutputExpression(tree, tree.GetCastOperand(expression));
         m_writer.Write(")");
     }
-    else if (expression->nodeType == HLSLNodeType_ConstructorExpression)
+    else if (nodeType == HLSLNodeType_ConstructorExpression)
     {
-        HLSLConstructorExpression* constructorExpression = static_cast<HLSLConstructorExpression*>(expression);
-        m_writer.Write("%s(", GetTypeName(constructorExpression->type));
-        OutputExpressionList(constructorExpression->argument);
+        m_writer.Write("%s(", GetTypeName(tree.GetConstructorType(expression)));
+        OutputExpressionList(tree, tree.GetConstructorArguments(expression));
         m_writer.Write(")");
     }
-    else if (expression->nodeType == HLSLNodeType_LiteralExpression)
+    else if (nodeType == HLSLNodeType_LiteralExpression)
     {
-        HLSLLiteralExpression* literalExpression = static_cast<HLSLLiteralExpression*>(expression);
-        switch (literalExpression->type)
+        switch (tree.GetLiteralType(expression))
         {
         case HLSLBaseType_Half:
         case HLSLBaseType_Float:
-            {
-                // Don't use printf directly so that we don't use the system locale.
-                char buffer[64];
-                String_FormatFloat(buffer, sizeof(buffer), literalExpression->fValue);
-                m_writer.Write("%s", buffer);
-            }
+            m_writer.WriteFloat(tree.GetLiteralFloat(expression));
             break;        
         case HLSLBaseType_Int:
-            m_writer.Write("%d", literalExpression->iValue);
+            m_writer.Write("%d", tree.GetLiteralInt(expression));
             break;
         case HLSLBaseType_Bool:
-            m_writer.Write("%s", literalExpression->bValue ? "true" : "false");
+            m_writer.Write("%s", tree.GetLiteralBool(expression) ? "true" : "false");
             break;
         default:
             ASSERT(0);
         }
     }
-    else if (expression->nodeType == HLSLNodeType_UnaryExpression)
+    else if (nodeType == HLSLNodeType_UnaryExpression)
     {
-        HLSLUnaryExpression* unaryExpression = static_cast<HLSLUnaryExpression*>(expression);
         const char* op = "?";
         bool pre = true;
-        switch (unaryExpression->unaryOp)
+        switch (tree.GetUnaryOp(expression))
         {
         case HLSLUnaryOp_Negative:      op = "-";  break;
         case HLSLUnaryOp_Positive:      op = "+";  break;
@@ -265,22 +286,21 @@ void HLSLGenerator::OutputExpression(HLSLExpression* expression)
         if (pre)
         {
             m_writer.Write("%s", op);
-            OutputExpression(unaryExpression->expression);
+            OutputExpression(tree, tree.GetUnaryOperand(expression));
         }
         else
         {
-            OutputExpression(unaryExpression->expression);
+            OutputExpression(tree, tree.GetUnaryOperand(expression));
             m_writer.Write("%s", op);
         }
         m_writer.Write(")");
     }
-    else if (expression->nodeType == HLSLNodeType_BinaryExpression)
+    else if (nodeType == HLSLNodeType_BinaryExpression)
     {
-        HLSLBinaryExpression* binaryExpression = static_cast<HLSLBinaryExpression*>(expression);
         m_writer.Write("(");
-        OutputExpression(binaryExpression->expression1);
+        OutputExpression(tree, tree.GetBinaryOperand1(expression));
         const char* op = "?";
-        switch (binaryExpression->binaryOp)
+        switch (tree.GetBinaryOp(expression))
         {
         case HLSLBinaryOp_Add:          op = " + "; break;
         case HLSLBinaryOp_Sub:          op = " - "; break;
@@ -303,39 +323,35 @@ void HLSLGenerator::OutputExpression(HLSLExpression* expression)
             ASSERT(0);
         }
         m_writer.Write("%s", op);
-        OutputExpression(binaryExpression->expression2);
+        OutputExpression(tree, tree.GetBinaryOperand2(expression));
         m_writer.Write(")");
     }
-    else if (expression->nodeType == HLSLNodeType_ConditionalExpression)
+    else if (nodeType == HLSLNodeType_ConditionalExpression)
     {
-        HLSLConditionalExpression* conditionalExpression = static_cast<HLSLConditionalExpression*>(expression);
         m_writer.Write("((");
-        OutputExpression(conditionalExpression->condition);
+        OutputExpression(tree, tree.GetConditionalCondition(expression));
         m_writer.Write(")?(");
-        OutputExpression(conditionalExpression->trueExpression);
+        OutputExpression(tree, tree.GetConditionalTrue(expression));
         m_writer.Write("):(");
-        OutputExpression(conditionalExpression->falseExpression);
+        OutputExpression(tree, tree.GetConditionalFalse(expression));
         m_writer.Write("))");
     }
-    else if (expression->nodeType == HLSLNodeType_MemberAccess)
+    else if (nodeType == HLSLNodeType_MemberAccess)
     {
-        HLSLMemberAccess* memberAccess = static_cast<HLSLMemberAccess*>(expression);
         m_writer.Write("(");
-        OutputExpression(memberAccess->object);
-        m_writer.Write(").%s", memberAccess->field);
+        OutputExpression(tree, tree.GetMemberObject(expression));
+        m_writer.Write(").%s", tree.GetMemberField(expression));
     }
-    else if (expression->nodeType == HLSLNodeType_ArrayAccess)
+    else if (nodeType == HLSLNodeType_ArrayAccess)
     {
-        HLSLArrayAccess* arrayAccess = static_cast<HLSLArrayAccess*>(expression);
-        OutputExpression(arrayAccess->array);
+        OutputExpression(tree, tree.GetArrayAccessArray(expression));
         m_writer.Write("[");
-        OutputExpression(arrayAccess->index);
+        OutputExpression(tree, tree.GetArrayAccessIndex(expression));
         m_writer.Write("]");
     }
-    else if (expression->nodeType == HLSLNodeType_FunctionCall)
+    else if (nodeType == HLSLNodeType_FunctionCall)
     {
-        HLSLFunctionCall* functionCall = static_cast<HLSLFunctionCall*>(expression);
-        const char* name = functionCall->function->name;
+        const char* name = tree.GetFunctionName(tree.GetCalledFunction(expression));
         if (!m_legacy)
         {
             if (String_Equal(name, "tex2D"))
@@ -360,7 +376,7 @@ void HLSLGenerator::OutputExpression(HLSLExpression* expression)
             }
         }
         m_writer.Write("%s(", name);
-        OutputExpressionList(functionCall->argument);
+        OutputExpressionList(tree, tree.GetCallArguments(expression));
         m_writer.Write(")");
     }
     else
@@ -369,17 +385,18 @@ void HLSLGenerator::OutputExpression(HLSLExpression* expression)
     }
 }
 
-void HLSLGenerator::OutputArguments(HLSLArgument* argument)
+template<typename Tree>
+void HLSLGenerator::OutputArguments(const Tree& tree, typename Tree::Node argument)
 {
     int numArgs = 0;
-    while (argument != NULL)
+    while (argument)
     {
         if (numArgs > 0)
         {
             m_writer.Write(", ");
         }
 
-        switch (argument->modifier)
+        switch (tree.GetArgumentModifier(argument))
         {
         case HLSLArgumentModifier_In:
             m_writer.Write("in ");
@@ -392,63 +409,66 @@ void HLSLGenerator::OutputArguments(HLSLArgument* argument)
             break;
         }
 
-        OutputDeclaration(argument->type, argument->name, argument->semantic);
-        argument = argument->nextArgument;
+        OutputDeclaration(tree, tree.GetArgumentType(argument), tree.GetArgumentName(argument), tree.GetArgumentSemantic(argument));
+        argument = tree.GetNextArgument(argument);
         ++numArgs;
     }
 }
 
-void HLSLGenerator::OutputStatements(int indent, HLSLStatement* statement)
+template<typename Tree>
+void HLSLGenerator::OutputStatements(const Tree& tree, int indent, typename Tree::Node statement)
 {
 
-    while (statement != NULL)
+    while (statement)
     {
 
-        if (statement->nodeType == HLSLNodeType_Declaration)
+        HLSLNodeType nodeType = tree.GetNodeType(statement);
+        const char* fileName  = tree.GetFileName(statement);
+        int line              = tree.GetLine(statement);
+
+        if (nodeType == HLSLNodeType_Declaration)
         {
-            HLSLDeclaration* declaration = static_cast<HLSLDeclaration*>(statement);
-            m_writer.BeginLine(indent, declaration->fileName, declaration->line);
-            OutputDeclaration(declaration);
+            m_writer.BeginLine(indent, fileName, line);
+            OutputDeclaration(tree, statement);
             m_writer.EndLine(";");
         }
-        else if (statement->nodeType == HLSLNodeType_Struct)
+        else if (nodeType == HLSLNodeType_Struct)
         {
-            HLSLStruct* structure = static_cast<HLSLStruct*>(statement);
-            m_writer.WriteLine(indent, "struct %s {", structure->name);
-            HLSLStructField* field = structure->field;
-            while (field != NULL)
+            m_writer.WriteLine(indent, "struct %s {", tree.GetStructName(statement));
+            typename Tree::Node field = tree.GetStructFields(statement);
+            while (field)
             {
-                m_writer.BeginLine(indent + 1, field->fileName, field->line);
-                OutputDeclaration(field->type, field->name, field->semantic);
+                m_writer.BeginLine(indent + 1, tree.GetFileName(field), tree.GetLine(field));
+                OutputDeclaration(tree, tree.GetStructFieldType(field), tree.GetStructFieldName(field), tree.GetStructFieldSemantic(field));
                 m_writer.Write(";");
                 m_writer.EndLine();
-                field = field->nextField;
+                field = tree.GetNextStructField(field);
             }
             m_writer.WriteLine(indent, "};");
         }
-        else if (statement->nodeType == HLSLNodeType_Buffer)
+        else if (nodeType == HLSLNodeType_Buffer)
         {
-            HLSLBuffer* buffer = static_cast<HLSLBuffer*>(statement);
-            HLSLBufferField* field = buffer->field;
+            typename Tree::Node field = tree.GetBufferFields(statement);
 
             if (!m_legacy)
             {
-                m_writer.BeginLine(indent, buffer->fileName, buffer->line);
-                m_writer.Write("cbuffer %s", buffer->name);
-                if (buffer->registerName != NULL)
+                const char* registerName = tree.GetBufferRegister(statement);
+                m_writer.BeginLine(indent, fileName, line);
+                m_writer.Write("cbuffer %s", tree.GetBufferName(statement));
+                if (registerName != NULL)
                 {
-                    m_writer.Write(" : register(%s)", buffer->registerName);
+                    m_writer.Write(" : register(%s)", registerName);
                 }
                 m_writer.EndLine(" {");
             }
 
-            while (field != NULL)
+            while (field)
             {
-                m_writer.BeginLine(indent + 1, field->fileName, field->line);
-                OutputDeclaration(field->type, field->name);
+                m_writer.BeginLine(indent + 1, tree.GetFileName(field), tree.GetLine(field));
+                OutputDeclaration(tree, tree.GetBufferFieldType(field), tree.GetBufferFieldName(field));
                 m_writer.Write(";");
                 m_writer.EndLine();
-                field = field->nextField;
+                field = tree.GetNextBufferField(field);
             }
 
             if (!m_legacy)
@@ -456,23 +476,22 @@ void HLSLGenerator::OutputStatements(int indent, HLSLStatement* statement)
                 m_writer.WriteLine(indent, "};");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_Function)
+        else if (nodeType == HLSLNodeType_Function)
         {
-            HLSLFunction* function = static_cast<HLSLFunction*>(statement);
-
             // Use an alternate name for the function which is supposed to be entry point
             // so that we can supply our own function which will be the actual entry point.
-            const char* functionName   = function->name;
-            const char* returnTypeName = GetTypeName(function->returnType);
+            const char* functionName   = tree.GetFunctionName(statement);
+            const char* returnTypeName = GetTypeName(tree.GetFunctionReturnType(statement));
+            const char* semantic       = tree.GetFunctionSemantic(statement);
 
-            m_writer.BeginLine(indent, function->fileName, function->line);
+            m_writer.BeginLine(indent, fileName, line);
             m_writer.Write("%s %s(", returnTypeName, functionName);
 
-            OutputArguments(function->argument);
+            OutputArguments(tree, tree.GetFunctionArguments(statement));
 
-            if (function->semantic != NULL)
+            if (semantic != NULL)
             {
-                m_writer.Write(") : %s {", function->semantic);
+                m_writer.Write(") : %s {", semantic);
             }
             else
             {
@@ -481,78 +500,73 @@ void HLSLGenerator::OutputStatements(int indent, HLSLStatement* statement)
 
             m_writer.EndLine();
 
-            OutputStatements(indent + 1, function->statement);
+            OutputStatements(tree, indent + 1, tree.GetFunctionStatements(statement));
             m_writer.WriteLine(indent, "};");
 
 
         }
-        else if (statement->nodeType == HLSLNodeType_ExpressionStatement)
+        else if (nodeType == HLSLNodeType_ExpressionStatement)
         {
-            HLSLExpressionStatement* expressionStatement = static_cast<HLSLExpressionStatement*>(statement);
-            m_writer.BeginLine(indent, statement->fileName, statement->line);
-            OutputExpression(expressionStatement->expression);
+            m_writer.BeginLine(indent, fileName, line);
+            OutputExpression(tree, tree.GetExpressionStatementExpression(statement));
             m_writer.EndLine(";");
         }
-        else if (statement->nodeType == HLSLNodeType_ReturnStatement)
+        else if (nodeType == HLSLNodeType_ReturnStatement)
         {
-            HLSLReturnStatement* returnStatement = static_cast<HLSLReturnStatement*>(statement);
-            if (returnStatement->expression != NULL)
+            typename Tree::Node expression = tree.GetReturnExpression(statement);
+            if (expression)
             {
-                m_writer.BeginLine(indent, returnStatement->fileName, returnStatement->line);
+                m_writer.BeginLine(indent, fileName, line);
                 m_writer.Write("return ");
-                OutputExpression(returnStatement->expression);
+                OutputExpression(tree, expression);
                 m_writer.EndLine(";");
             }
             else
             {
-                m_writer.WriteLine(indent, returnStatement->fileName, returnStatement->line, "return;");
+                m_writer.WriteLine(indent, fileName, line, "return;");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_DiscardStatement)
+        else if (nodeType == HLSLNodeType_DiscardStatement)
         {
-            HLSLDiscardStatement* discardStatement = static_cast<HLSLDiscardStatement*>(statement);
-            m_writer.WriteLine(indent, discardStatement->fileName, discardStatement->line, "discard;");
+            m_writer.WriteLine(indent, fileName, line, "discard;");
         }
-        else if (statement->nodeType == HLSLNodeType_BreakStatement)
+        else if (nodeType == HLSLNodeType_BreakStatement)
         {
-            HLSLBreakStatement* breakStatement = static_cast<HLSLBreakStatement*>(statement);
-            m_writer.WriteLine(indent, breakStatement->fileName, breakStatement->line, "break;");
+            m_writer.WriteLine(indent, fileName, line, "break;");
         }
-        else if (statement->nodeType == HLSLNodeType_ContinueStatement)
+        else if (nodeType == HLSLNodeType_ContinueStatement)
         {
-            HLSLContinueStatement* continueStatement = static_cast<HLSLContinueStatement*>(statement);
-            m_writer.WriteLine(indent, continueStatement->fileName, continueStatement->line, "continue;");
+            m_writer.WriteLine(indent, fileName, line, "continue;");
         }
-        else if (statement->nodeType == HLSLNodeType_IfStatement)
+        else if (nodeType == HLSLNodeType_IfStatement)
         {
-            HLSLIfStatement* ifStatement = static_cast<HLSLIfStatement*>(statement);
-            m_writer.BeginLine(indent, ifStatement->fileName, ifStatement->line);
+            typename Tree::Node elseStatement = tree.GetElseStatements(statement);
+            m_writer.BeginLine(indent, fileName, line);
             m_writer.Write("if (");
-            OutputExpression(ifStatement->condition);
+            OutputExpression(tree, tree.GetIfCondition(statement));
             m_writer.Write(") {");
             m_writer.EndLine();
-            OutputStatements(indent + 1, ifStatement->statement);
+            OutputStatements(tree, indent + 1, tree.GetIfStatements(statement));
             m_writer.WriteLine(indent, "}");
-            if (ifStatement->elseStatement != NULL)
+            if (elseStatement)
             {
                 m_writer.WriteLine(indent, "else {");
-                OutputStatements(indent + 1, ifStatement->elseStatement);
+                OutputStatements(tree, indent + 1, elseStatement);
                 m_writer.WriteLine(indent, "}");
             }
         }
-        else if (statement->nodeType == HLSLNodeType_ForStatement)
+        else if (nodeType == HLSLNodeType_ForStatement)
         {
-            HLSLForStatement* forStatement = static_cast<HLSLForStatement*>(statement);
-            m_writer.BeginLine(indent, forStatement->fileName, forStatement->line);
+            m_writer.BeginLine(indent, fileName, line);
             m_writer.Write("for (");
-            OutputDeclaration(forStatement->initialization);
+            OutputDeclaration(tree, tree.GetForInitialization(statement));
             m_writer.Write("; ");
-            OutputExpression(forStatement->condition);
+            OutputExpression(tree, tree.GetForCondition(statement));
             m_writer.Write("; ");
-            OutputExpression(forStatement->increment);
+            OutputExpression(tree, tree.GetForIncrement(statement));
             m_writer.Write(") {");
             m_writer.EndLine();
-            OutputStatements(indent + 1, forStatement->statement);
+            OutputStatements(tree, indent + 1, tree.GetForStatements(statement));
             m_writer.WriteLine(indent, "}");
         }
         else
@@ -561,68 +575,75 @@ void HLSLGenerator::OutputStatements(int indent, HLSLStatement* statement)
             ASSERT(0);
         }
 
-        statement = statement->nextStatement;
+        statement = tree.GetNextStatement(statement);
 
     }
 
 }
 
-void HLSLGenerator::OutputDeclaration(HLSLDeclaration* declaration)
+template<typename Tree>
+void HLSLGenerator::OutputDeclaration(const Tree& tree, typename Tree::Node declaration)
 {
 
-    if (!m_legacy && GetIsSamplerType(declaration->type))
+    const typename Tree::Type& type = tree.GetDeclarationType(declaration);
+    const char* name                = tree.GetDeclarationName(declaration);
+    const char* registerName        = tree.GetDeclarationRegister(declaration);
+
+    if (!m_legacy && GetIsSamplerType(type))
     {
         int reg = -1;
-        if (declaration->registerName != NULL)
+        if (registerName != NULL)
         {
-            sscanf(declaration->registerName, "s%d", &reg);
+            sscanf(registerName, "s%d", &reg);
         }
 
         const char* textureType = NULL;
-        if (declaration->type.baseType == HLSLBaseType_Sampler2D)
+        if (type.baseType == HLSLBaseType_Sampler2D)
         {
             textureType = "Texture2D";
         }
-        else if (declaration->type.baseType == HLSLBaseType_SamplerCube)
+        else if (type.baseType == HLSLBaseType_SamplerCube)
         {
             textureType = "TextureCube";
         }
 
         if (reg != -1)
         {
-            m_writer.Write("%s %s_texture : register(t%d); SamplerState %s_sampler : register(s%d)", textureType, declaration->name, reg, declaration->name, reg);
+            m_writer.Write("%s %s_texture : register(t%d); SamplerState %s_sampler : register(s%d)", textureType, name, reg, name, reg);
         }
         else
         {
-            m_writer.Write("%s %s_texture; SamplerState %s_sampler", textureType, declaration->name, declaration->name);
+            m_writer.Write("%s %s_texture; SamplerState %s_sampler", textureType, name, name);
         }
         return;
     }
 
 
-    OutputDeclaration(declaration->type, declaration->name);
+    OutputDeclaration(tree, type, name);
     // Registers only really matter for our samplers.
-    if (GetIsSamplerType(declaration->type) && declaration->registerName != NULL)
+    if (GetIsSamplerType(type) && registerName != NULL)
     {
-        m_writer.Write(" : register(%s)", declaration->registerName);
+        m_writer.Write(" : register(%s)", registerName);
     }
-    if (declaration->assignment != NULL)
+    typename Tree::Node assignment = tree.GetDeclarationAssignment(declaration);
+    if (assignment)
     {
         m_writer.Write(" = ");
-        if (declaration->type.array)
+        if (type.array)
         {
             m_writer.Write("{ ");
-            OutputExpressionList(declaration->assignment);
+            OutputExpressionList(tree, assignment);
             m_writer.Write(" }");
         }
         else
         {
-            OutputExpression(declaration->assignment);
+            OutputExpression(tree, assignment);
         }
     }
 }
 
-void HLSLGenerator::OutputDeclaration(const HLSLType& type, const char* name, const char* semantic)
+template<typename Tree>
+void HLSLGenerator::OutputDeclaration(const Tree& tree, const typename Tree::Type& type, const char* name, const char* semantic)
 {
     const char* typeName = GetTypeName(type);
     if (!m_legacy)
@@ -656,20 +677,25 @@ void HLSLGenerator::OutputDeclaration(const HLSLType& type, const char* name, co
     {
         ASSERT(semantic == NULL);
         m_writer.Write("%s %s[", typeName, name);
-        if (type.arraySize != NULL)
+        if (type.arraySize)
         {
-            OutputExpression(type.arraySize);
+            OutputExpression(tree, type.arraySize);
         }
         m_writer.Write("]");
     }
 }
 
-bool HLSLGenerator::ChooseUniqueName(const char* base, char* dst, int dstLength) const
+template<typename Tree>
+bool HLSLGenerator::ChooseUniqueName(const Tree& tree, const char* base, char* dst, int dstLength) const
 {
     for (int i = 0; i < 1024; ++i)
     {
         String_Printf(dst, dstLength, "%s%d", base, i);
-        if (!m_tree->GetContainsString(dst))
+        if (m_instrumentation != NULL)
+        {
+            m_instrumentation->AddCount(HLSLCounter_UniqueNameProbes, 1);
+        }
+        if (!tree.GetContainsString(dst))
         {
             return true;
         }
@@ -677,4 +703,4 @@ bool HLSLGenerator::ChooseUniqueName(const char* base, char* dst, int dstLength)
     return false;
 }
 
-}
\ No newline at end of file
+}
@@ -11,14 +11,14 @@
 #define HLSL_GENERATOR_H
 
 #include "CodeWriter.h"
+#include "HLSLInstrumentation.h"
 #include "HLSLTree.h"
 
 namespace M4
 {
 
 class  HLSLTree;
-struct HLSLFunction;
-struct HLSLStruct;
+class  HLSLCompactTree;
 
 /**
  * This class is used to generate HLSL which is compatible with the D3D9
@@ -37,27 +37,52 @@ public:
 
     explicit HLSLGenerator(Allocator* allocator);
     
+    /** The tree is only read, so one frozen tree can be shared by generators on
+    several threads (see HLSLTree::Freeze). */
     bool Generate(const HLSLTree* tree, Target target, const char* entryName, bool legacy);
+
+    /** Generates the output from a compact tree without expanding it first. */
+    bool Generate(const HLSLCompactTree* tree, Target target, const char* entryName, bool legacy);
+
     const char* GetResult() const;
 
+    /** Streams the output to the sink as it's generated instead of keeping it
+    for GetResult (see CodeWriter::SetSink). */
+    void SetSink(CodeSink* sink);
+
+    /** Reports timings and counts to the instrumentation, which is optional. */
+    void SetInstrumentation(HLSLInstrumentation* instrumentation);
+
 private:
 
-    void OutputExpressionList(HLSLExpression* expression);
-    void OutputExpression(HLSLExpression* expression);
-    void OutputArguments(HLSLArgument* argument);
-    void OutputStatements(int indent, HLSLStatement* statement);
-    void OutputDeclaration(const HLSLType& type, const char* name, const char* semantic = NULL);
-    void OutputDeclaration(HLSLDeclaration* declaration);
+    /** The tree is read through an HLSLTreeAccessor or HLSLCompactTreeAccessor,
+    so the same code generates from either layout. */
+    template<typename Tree>
+    bool GenerateTree(const Tree& tree, Target target, const char* entryName, bool legacy);
+
+    template<typename Tree>
+    void OutputExpressionList(const Tree& tree, typename Tree::Node expression);
+    template<typename Tree>
+    void OutputExpression(const Tree& tree, typename Tree::Node expression);
+    template<typename Tree>
+    void OutputArguments(const Tree& tree, typename Tree::Node argument);
+    template<typename Tree>
+    void OutputStatements(const Tree& tree, int indent, typename Tree::Node statement);
+    template<typename Tree>
+    void OutputDeclaration(const Tree& tree, const typename Tree::Type& type, const char* name, const char* semantic = NULL);
+    template<typename Tree>
+    void OutputDeclaration(const Tree& tree, typename Tree::Node declaration);
 
     /** Generates a name of the format "base+n" where n is an integer such that the name
      * isn't used in the syntax tree. */
-    bool ChooseUniqueName(const char* base, char* dst, int dstLength) const;
+    template<typename Tree>
+    bool ChooseUniqueName(const Tree& tree, const char* base, char* dst, int dstLength) const;
 
 private:
 
     CodeWriter      m_writer;
+    HLSLInstrumentation* m_instrumentation;
 
-    const HLSLTree* m_tree;
     const char*     m_entryName;
     bool            m_legacy;
 
@@ -0,0 +1,172 @@
+#include "Engine/Allocator.h"
+#include "Engine/Assert.h"
+#include "Engine/Time.h"
+
+#include "HLSLInstrumentation.h"
+
+namespace M4
+{
+
+static const char* const _phaseName[HLSLPhase_Count] =
+    {
+        "tokenize",
+        "parse",
+        "type check",
+        "overload resolution",
+        "generate",
+    };
+
+static const char* const _counterName[HLSLCounter_Count] =
+    {
+        "tokens",
+        "interned strings",
+        "overload candidates",
+        "unique name probes",
+    };
+
+static const char* const _nodeTypeName[HLSLNodeType_Count] =
+    {
+        "Root",
+        "Declaration",
+        "Struct",
+        "StructField",
+        "Buffer",
+        "BufferField",
+        "Function",
+        "Argument",
+        "ExpressionStatement",
+        "Expression",
+        "ReturnStatement",
+        "DiscardStatement",
+        "BreakStatement",
+        "ContinueStatement",
+        "IfStatement",
+        "ForStatement",
+        "UnaryExpression",
+        "BinaryExpression",
+        "ConditionalExpression",
+        "CastingExpression",
+        "LiteralExpression",
+        "IdentifierExpression",
+        "ConstructorExpression",
+        "MemberAccess",
+        "ArrayAccess",
+        "FunctionCall",
+    };
+
+HLSLStats::HLSLStats()
+{
+    for (int i = 0; i < HLSLPhase_Count; ++i)
+    {
+        m_phaseStart[i] = 0;
+        m_phaseTime[i]  = 0;
+        m_phaseCalls[i] = 0;
+        m_phaseDepth[i] = 0;
+    }
+    for (int i = 0; i < HLSLCounter_Count; ++i)
+    {
+        m_count[i] = 0;
+    }
+    for (int i = 0; i < HLSLNodeType_Count; ++i)
+    {
+        m_nodeCount[i] = 0;
+    }
+}
+
+void HLSLStats::BeginPhase(HLSLPhase phase)
+{
+    if (m_phaseDepth[phase]++ == 0)
+    {
+        m_phaseStart[phase] = Time_GetNanoseconds();
+        ++m_phaseCalls[phase];
+    }
+}
+
+void HLSLStats::EndPhase(HLSLPhase phase)
+{
+    ASSERT(m_phaseDepth[phase] > 0);
+    if (--m_phaseDepth[phase] == 0)
+    {
+        m_phaseTime[phase] += Time_GetNanoseconds() - m_phaseStart[phase];
+    }
+}
+
+void HLSLStats::AddCount(HLSLCounter counter, int count)
+{
+    m_count[counter] += count;
+}
+
+void HLSLStats::AddNodeCount(HLSLNodeType nodeType, int count)
+{
+    m_nodeCount[nodeType] += count;
+}
+
+uint64_t HLSLStats::GetPhaseNanoseconds(HLSLPhase phase) const
+{
+    return m_phaseTime[phase];
+}
+
+int HLSLStats::GetPhaseCalls(HLSLPhase phase) const
+{
+    return m_phaseCalls[phase];
+}
+
+uint64_t HLSLStats::GetCount(HLSLCounter counter) const
+{
+    return m_count[counter];
+}
+
+uint64_t HLSLStats::GetNodeCount(HLSLNodeType nodeType) const
+{
+    return m_nodeCount[nodeType];
+}
+
+void HLSLStats::Print(FILE* file, const Allocator* allocator) const
+{
+    fprintf(file, "%-24s %12s %10s\n", "phase", "ms", "calls");
+    for (int i = 0; i < HLSLPhase_Count; ++i)
+    {
+        fprintf(file, "%-24s %12.3f %10d\n", _phaseName[i], m_phaseTime[i] * 1e-6, m_phaseCalls[i]);
+    }
+
+    fprintf(file, "\n%-24s %12s\n", "counter", "count");
+    for (int i = 0; i < HLSLCounter_Count; ++i)
+    {
+        fprintf(file, "%-24s %12lu\n", _counterName[i], static_cast<unsigned long>(m_count[i]));
+    }
+
+    fprintf(file, "\n%-24s %12s\n", "nodes", "count");
+    for (int i = 0; i < HLSLNodeType_Count; ++i)
+    {
+        if (m_nodeCount[i] > 0)
+        {
+            fprintf(file, "%-24s %12lu\n", _nodeTypeName[i], static_cast<unsigned long>(m_nodeCount[i]));
+        }
+    }
+
+    if (allocator != NULL)
+    {
+        const AllocatorStats& stats = allocator->GetStats();
+        fprintf(file, "\n%-24s %12s\n", "allocator", "");
+        fprintf(file, "%-24s %12lu\n", "allocations", static_cast<unsigned long>(stats.numAllocations));
+        fprintf(file, "%-24s %12lu\n", "bytes allocated", static_cast<unsigned long>(stats.bytesAllocated));
+        fprintf(file, "%-24s %12lu\n", "peak bytes allocated", static_cast<unsigned long>(stats.peakBytesAllocated));
+    }
+}
+
+const char* HLSLStats::GetPhaseName(HLSLPhase phase)
+{
+    return _phaseName[phase];
+}
+
+const char* HLSLStats::GetCounterName(HLSLCounter counter)
+{
+    return _counterName[counter];
+}
+
+const char* HLSLStats::GetNodeTypeName(HLSLNodeType nodeType)
+{
+    return _nodeTypeName[nodeType];
+}
+
+}
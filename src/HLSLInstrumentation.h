@@ -0,0 +1,113 @@
+#ifndef HLSL_INSTRUMENTATION_H
+#define HLSL_INSTRUMENTATION_H
+
+#include "HLSLTree.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace M4
+{
+
+class Allocator;
+
+enum HLSLPhase
+{
+    HLSLPhase_Tokenize,
+    HLSLPhase_Parse,
+    HLSLPhase_TypeCheck,
+    HLSLPhase_OverloadResolution,
+    HLSLPhase_Generate,
+    HLSLPhase_Count
+};
+
+enum HLSLCounter
+{
+    HLSLCounter_Tokens,
+    HLSLCounter_InternedStrings,
+    HLSLCounter_OverloadCandidates,     // Overloads ranked against a call.
+    HLSLCounter_UniqueNameProbes,       // Names tried by the generators' ChooseUniqueName.
+    HLSLCounter_Count
+};
+
+/**
+ * Receives timings and counts from the parser and the generators. They only
+ * call it if one has been set, so there's no cost when it isn't used. Phases
+ * nest: parsing includes the type checking and overload resolution done while
+ * parsing, and also the tokenizing unless HLSLParser::Tokenize was used.
+ */
+class HLSLInstrumentation
+{
+public:
+    virtual ~HLSLInstrumentation() {}
+    virtual void BeginPhase(HLSLPhase phase) = 0;
+    virtual void EndPhase(HLSLPhase phase) = 0;
+    virtual void AddCount(HLSLCounter counter, int count) = 0;
+    virtual void AddNodeCount(HLSLNodeType nodeType, int count) = 0;
+};
+
+/** Reports a phase for the lifetime of the object, if there's instrumentation. */
+class HLSLPhaseScope
+{
+public:
+    HLSLPhaseScope(HLSLInstrumentation* instrumentation, HLSLPhase phase) :
+        m_instrumentation(instrumentation), m_phase(phase)
+    {
+        if (m_instrumentation != NULL)
+        {
+            m_instrumentation->BeginPhase(m_phase);
+        }
+    }
+    ~HLSLPhaseScope()
+    {
+        if (m_instrumentation != NULL)
+        {
+            m_instrumentation->EndPhase(m_phase);
+        }
+    }
+private:
+    HLSLInstrumentation*    m_instrumentation;
+    HLSLPhase               m_phase;
+};
+
+/** Instrumentation which adds up the wall time of each phase and the counts. */
+class HLSLStats : public HLSLInstrumentation
+{
+
+public:
+
+    HLSLStats();
+
+    virtual void BeginPhase(HLSLPhase phase);
+    virtual void EndPhase(HLSLPhase phase);
+    virtual void AddCount(HLSLCounter counter, int count);
+    virtual void AddNodeCount(HLSLNodeType nodeType, int count);
+
+    /** Time spent in the phase, not counting nested calls to the same phase twice. */
+    uint64_t GetPhaseNanoseconds(HLSLPhase phase) const;
+    int GetPhaseCalls(HLSLPhase phase) const;
+
+    uint64_t GetCount(HLSLCounter counter) const;
+    uint64_t GetNodeCount(HLSLNodeType nodeType) const;
+
+    /** Writes a table of the totals, followed by the allocator stats if one is given. */
+    void Print(FILE* file, const Allocator* allocator = NULL) const;
+
+    static const char* GetPhaseName(HLSLPhase phase);
+    static const char* GetCounterName(HLSLCounter counter);
+    static const char* GetNodeTypeName(HLSLNodeType nodeType);
+
+private:
+
+    uint64_t        m_phaseStart[HLSLPhase_Count];
+    uint64_t        m_phaseTime[HLSLPhase_Count];
+    int             m_phaseCalls[HLSLPhase_Count];
+    int             m_phaseDepth[HLSLPhase_Count];
+    uint64_t        m_count[HLSLCounter_Count];
+    uint64_t        m_nodeCount[HLSLNodeType_Count];
+
+};
+
+}
+
+#endif
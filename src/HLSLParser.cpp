@@ -14,6 +14,8 @@
 #include "HLSLTree.h"
 
 #include <algorithm>
+#include <ctype.h>
+#include <string.h>
 
 namespace M4
 {
@@ -245,6 +247,39 @@ const Intrinsic _intrinsic[] =
 
 const int _numIntrinsics = sizeof(_intrinsic) / sizeof(Intrinsic);
 
+/**
+ * Intrinsic overloads by name. The intrinsics never change, so the index is
+ * built once during static initialization instead of by each parser. Each
+ * bucket is a list of the intrinsics whose name hashes to it, linked through
+ * next, with the overloads of a name in table order.
+ */
+struct IntrinsicIndex
+{
+    enum { numBuckets = 256 };
+    IntrinsicIndex()
+    {
+        for (int i = 0; i < numBuckets; ++i)
+        {
+            first[i] = -1;
+        }
+        // Walk backwards so that prepending keeps the table order.
+        for (int i = _numIntrinsics - 1; i >= 0; --i)
+        {
+            int bucket = GetBucket(_intrinsic[i].function.name);
+            next[i] = first[bucket];
+            first[bucket] = i;
+        }
+    }
+    static int GetBucket(const char* name)
+    {
+        return StringPool::GetHash(name, strlen(name)) & (numBuckets - 1);
+    }
+    int first[numBuckets];
+    int next[_numIntrinsics];   // Index of the next intrinsic in the bucket, or -1.
+};
+
+static const IntrinsicIndex _intrinsicIndex;
+
 // The order in this array must match up with HLSLBinaryOp
 const int _binaryOpPriority[] =
     {
@@ -292,7 +327,7 @@ const BaseTypeDescription _baseTypeDescriptions[HLSLBaseType_Count] =
         { "user defined",   NumericType_NaN,         1, 0, 0, -1 }      // HLSLBaseType_UserDefined
     };
 
-HLSLBaseType _binaryOpTypeLookup[HLSLBaseType_NumericCount][HLSLBaseType_NumericCount] = 
+const HLSLBaseType _binaryOpTypeLookup[HLSLBaseType_NumericCount][HLSLBaseType_NumericCount] = 
     {
         {
             HLSLBaseType_Float, HLSLBaseType_Float2, HLSLBaseType_Float3, HLSLBaseType_Float4,
@@ -514,26 +549,16 @@ static const char* GetBinaryOpName(HLSLBinaryOp binaryOp)
  * 5.) Truncation (vector -> scalar or lower component vector, matrix -> scalar or lower component matrix)
  * 6.) Conversion + truncation
  */    
-static int GetTypeCastRank(const HLSLType& srcType, const HLSLType& dstType)
+static int ComputeTypeCastRank(HLSLBaseType srcType, HLSLBaseType dstType)
 {
 
-    if (srcType.array != dstType.array || srcType.arraySize != dstType.arraySize)
-    {
-        return -1;
-    }
-
-    if (srcType.baseType == HLSLBaseType_UserDefined && dstType.baseType == HLSLBaseType_UserDefined)
-    {
-        return strcmp(srcType.typeName, dstType.typeName) == 0 ? 0 : -1;
-    }
-
-    if (srcType.baseType == dstType.baseType)
+    if (srcType == dstType)
     {
         return 0;
     }
 
-    const BaseTypeDescription& srcDesc = _baseTypeDescriptions[srcType.baseType];
-    const BaseTypeDescription& dstDesc = _baseTypeDescriptions[dstType.baseType];
+    const BaseTypeDescription& srcDesc = _baseTypeDescriptions[srcType];
+    const BaseTypeDescription& dstDesc = _baseTypeDescriptions[dstType];
     if (srcDesc.numericType == NumericType_NaN || dstDesc.numericType == NumericType_NaN)
     {
         return -1;
@@ -564,6 +589,64 @@ static int GetTypeCastRank(const HLSLType& srcType, const HLSLType& dstType)
     
 }
 
+/**
+ * Cast rank between each pair of base types, since this is checked for every
+ * argument of every overload considered. It's filled in from the descriptions
+ * during static initialization so that it can't get out of sync with them.
+ */
+struct TypeCastRankTable
+{
+    TypeCastRankTable()
+    {
+        for (int srcType = 0; srcType < HLSLBaseType_Count; ++srcType)
+        {
+            for (int dstType = 0; dstType < HLSLBaseType_Count; ++dstType)
+            {
+                rank[srcType][dstType] = static_cast<signed char>(ComputeTypeCastRank(static_cast<HLSLBaseType>(srcType), static_cast<HLSLBaseType>(dstType)));
+            }
+        }
+    }
+    signed char rank[HLSLBaseType_Count][HLSLBaseType_Count];
+};
+
+static const TypeCastRankTable _typeCastRank;
+
+/** Component selected by each character in a vector swizzle, or -1. */
+struct SwizzleComponentTable
+{
+    SwizzleComponentTable()
+    {
+        memset(component, -1, sizeof(component));
+        const char* xyzw = "xyzw";
+        const char* rgba = "rgba";
+        for (int i = 0; i < 4; ++i)
+        {
+            component[static_cast<unsigned char>(xyzw[i])] = static_cast<signed char>(i);
+            component[static_cast<unsigned char>(rgba[i])] = static_cast<signed char>(i);
+        }
+    }
+    signed char component[256];
+};
+
+static const SwizzleComponentTable _swizzleComponent;
+
+static int GetTypeCastRank(const HLSLType& srcType, const HLSLType& dstType)
+{
+
+    if (srcType.array != dstType.array || srcType.arraySize != dstType.arraySize)
+    {
+        return -1;
+    }
+
+    if (srcType.baseType == HLSLBaseType_UserDefined && dstType.baseType == HLSLBaseType_UserDefined)
+    {
+        return strcmp(srcType.typeName, dstType.typeName) == 0 ? 0 : -1;
+    }
+
+    return _typeCastRank.rank[srcType.baseType][dstType.baseType];
+    
+}
+
 static bool GetFunctionCallCastRanks(const HLSLFunctionCall* call, const HLSLFunction* function, int* rankBuffer)
 {
 
@@ -680,11 +763,43 @@ static bool GetBinaryOpResultType(HLSLBinaryOp binaryOp, const HLSLType& type1,
 
 HLSLParser::HLSLParser(Allocator* allocator, const char* fileName, const char* buffer, size_t length) : 
     m_tokenizer(fileName, buffer, length),
+    m_tokenBuffer(allocator),
     m_userTypes(allocator),
+    m_structFields(allocator),
+    m_structFieldIndex(allocator),
     m_variables(allocator),
-    m_functions(allocator)
+    m_scopes(allocator),
+    m_variableIndex(allocator),
+    m_overloads(allocator),
+    m_functionIndex(allocator),
+    m_cachedOverloads(allocator),
+    m_cachedArguments(allocator),
+    m_overloadCache(allocator)
 {
-    m_numGlobals = 0;
+    m_numGlobals        = 0;
+    m_tree              = NULL;
+    m_instrumentation   = NULL;
+}
+
+void HLSLParser::SetInstrumentation(HLSLInstrumentation* instrumentation)
+{
+    m_instrumentation = instrumentation;
+}
+
+bool HLSLParser::Tokenize()
+{
+    HLSLPhaseScope phase(m_instrumentation, HLSLPhase_Tokenize);
+    bool result = m_tokenizer.Tokenize(&m_tokenBuffer);
+    if (m_instrumentation != NULL)
+    {
+        m_instrumentation->AddCount(HLSLCounter_Tokens, m_tokenBuffer.GetNumTokens());
+    }
+    return result;
+}
+
+int HLSLParser::GetNumTokens() const
+{
+    return m_tokenBuffer.GetNumTokens();
 }
 
 bool HLSLParser::Accept(int token)
@@ -699,10 +814,15 @@ bool HLSLParser::Accept(int token)
 
 bool HLSLParser::Accept(const char* token)
 {
-    if (m_tokenizer.GetToken() == HLSLToken_Identifier && String_Equal( token, m_tokenizer.GetIdentifier() ) )
+    if (m_tokenizer.GetToken() == HLSLToken_Identifier)
     {
-        m_tokenizer.Next();
-        return true;
+        // The identifier isn't null terminated, so compare against the span.
+        HLSLTokenSpan span = m_tokenizer.GetSpan();
+        if (strncmp(token, m_tokenizer.GetSpanText(span), span.length) == 0 && token[span.length] == 0)
+        {
+            m_tokenizer.Next();
+            return true;
+        }
     }
     return false;
 }
@@ -725,7 +845,8 @@ bool HLSLParser::AcceptIdentifier(const char*& identifier)
 {
     if (m_tokenizer.GetToken() == HLSLToken_Identifier)
     {
-        identifier = m_tree->AddString( m_tokenizer.GetIdentifier() );
+        HLSLTokenSpan span = m_tokenizer.GetSpan();
+        identifier = m_tree->AddString( m_tokenizer.GetSpanText(span), span.length );
         m_tokenizer.Next();
         return true;
     }
@@ -800,7 +921,7 @@ bool HLSLParser::ParseTopLevel(HLSLStatement*& statement)
         HLSLStruct* structure = m_tree->AddNode<HLSLStruct>(fileName, line);
         structure->name = structName;
 
-        m_userTypes.PushBack(structure);
+        m_userTypes.Insert(structName, structure);
  
         HLSLStructField* lastField = NULL;
 
@@ -817,6 +938,7 @@ bool HLSLParser::ParseTopLevel(HLSLStatement*& statement)
                 return false;
             }
             ASSERT(field != NULL);
+            DeclareStructField(structure, field);
             if (lastField == NULL)
             {
                 structure->field = field;
@@ -911,7 +1033,7 @@ bool HLSLParser::ParseTopLevel(HLSLStatement*& statement)
                 return false;
             }
             
-            m_functions.PushBack( function );
+            DeclareFunction( function );
 
             if (!Expect('{') || !ParseBlock(function->statement, function->returnType))
             {
@@ -1233,6 +1355,7 @@ bool HLSLParser::ParseBufferFieldDeclaration(HLSLBufferField*& field)
 
 bool HLSLParser::CheckTypeCast(const HLSLType& srcType, const HLSLType& dstType)
 {
+    HLSLPhaseScope phase(m_instrumentation, HLSLPhase_TypeCheck);
     if (GetTypeCastRank(srcType, dstType) == -1)
     {
         const char* srcTypeName = GetTypeName(srcType);
@@ -1392,7 +1515,12 @@ bool HLSLParser::ParseBinaryExpression(int priority, HLSLExpression*& expression
             binaryExpression->binaryOp    = binaryOp;
             binaryExpression->expression1 = expression;
             binaryExpression->expression2 = expression2;
-            if (!GetBinaryOpResultType( binaryOp, expression->expressionType, expression2->expressionType, binaryExpression->expressionType ))
+            bool validTypes;
+            {
+                HLSLPhaseScope phase(m_instrumentation, HLSLPhase_TypeCheck);
+                validTypes = GetBinaryOpResultType( binaryOp, expression->expressionType, expression2->expressionType, binaryExpression->expressionType );
+            }
+            if (!validTypes)
             {
                 const char* typeName1 = GetTypeName( binaryExpression->expression1->expressionType );
                 const char* typeName2 = GetTypeName( binaryExpression->expression2->expressionType );
@@ -1834,17 +1962,21 @@ bool HLSLParser::ParseArgumentList(int endToken, HLSLArgument*& firstArgument, i
 
 bool HLSLParser::Parse(HLSLTree* tree)
 {
+    HLSLPhaseScope phase(m_instrumentation, HLSLPhase_Parse);
+
     m_tree = tree;
-    
+
     HLSLRoot* root = m_tree->GetRoot();
     HLSLStatement* lastStatement = NULL;
+    bool result = true;
 
     while (!Accept(HLSLToken_EndOfStream))
     {
         HLSLStatement* statement = NULL;
         if (!ParseTopLevel(statement))
         {
-            return false;
+            result = false;
+            break;
         }
         if (statement != NULL)
         {   
@@ -1860,7 +1992,17 @@ bool HLSLParser::Parse(HLSLTree* tree)
         }
 
     }
-    return true;
+
+    if (m_instrumentation != NULL)
+    {
+        for (int i = 0; i < HLSLNodeType_Count; ++i)
+        {
+            m_instrumentation->AddNodeCount(static_cast<HLSLNodeType>(i), m_tree->GetNumNodes(static_cast<HLSLNodeType>(i)));
+        }
+        m_instrumentation->AddCount(HLSLCounter_InternedStrings, m_tree->GetNumStrings());
+    }
+
+    return result;
 }
 
 bool HLSLParser::AcceptType(bool allowVoid, HLSLBaseType& type, const char*& typeName, bool* constant)
@@ -1970,7 +2112,16 @@ bool HLSLParser::AcceptType(bool allowVoid, HLSLBaseType& type, const char*& typ
     }
     if (token == HLSLToken_Identifier)
     {
-        const char* identifier = m_tree->AddString( m_tokenizer.GetIdentifier() );
+        // Only user defined types that have already been added to the string pool
+        // can match, so avoid interning identifiers that aren't types.
+        HLSLTokenSpan span = m_tokenizer.GetSpan();
+        const char* spanText = m_tokenizer.GetSpanText(span);
+        unsigned int hash = StringPool::GetHash(spanText, span.length);
+        if (!m_tree->GetContainsString(spanText, span.length, hash))
+        {
+            return false;
+        }
+        const char* identifier = m_tree->AddString( spanText, span.length, hash );
         if (FindUserDefinedType(identifier) != NULL)
         {
             m_tokenizer.Next();
@@ -2035,11 +2186,43 @@ const HLSLStruct* HLSLParser::FindUserDefinedType(const char* name) const
 {
     // Pointer comparison is sufficient for strings since they exist in the
     // string pool.
-    for (int i = 0; i < m_userTypes.GetSize(); ++i)
+    const HLSLStruct* const* structure = m_userTypes.Find(name);
+    return (structure != NULL) ? *structure : NULL;
+}
+
+static unsigned int GetStructFieldHash(const HLSLStruct* structure, const char* name)
+{
+    return HashMap_GetHash((static_cast<uint64_t>(HashMap_GetHash(structure)) << 32) ^ HashMap_GetHash(name));
+}
+
+void HLSLParser::DeclareStructField(const HLSLStruct* structure, const HLSLStructField* field)
+{
+    if (FindStructField(structure, field->name) != NULL)
+    {
+        // Member access finds the first field with a name.
+        return;
+    }
+
+    unsigned int hash = GetStructFieldHash(structure, field->name);
+    const int* first = m_structFieldIndex.Find(hash);
+
+    StructFieldEntry& entry = m_structFields.PushBackNew();
+    entry.structure = structure;
+    entry.field     = field;
+    entry.next      = (first != NULL) ? *first : -1;
+
+    m_structFieldIndex.Insert(hash, m_structFields.GetSize() - 1);
+}
+
+const HLSLStructField* HLSLParser::FindStructField(const HLSLStruct* structure, const char* name) const
+{
+    const int* first = m_structFieldIndex.Find(GetStructFieldHash(structure, name));
+    for (int i = (first != NULL) ? *first : -1; i != -1; i = m_structFields[i].next)
     {
-        if (m_userTypes[i]->name == name)
+        const StructFieldEntry& entry = m_structFields[i];
+        if (entry.structure == structure && entry.field->name == name)
         {
-            return m_userTypes[i];
+            return entry.field;
         }
     }
     return NULL;
@@ -2069,174 +2252,311 @@ const char* HLSLParser::GetFileName()
 
 void HLSLParser::BeginScope()
 {
-    // Use NULL as a sentinel that indices a new scope level.
-    Variable& variable = m_variables.PushBackNew();
-    variable.name = NULL;
+    m_scopes.PushBack(m_variables.GetSize());
 }
 
 void HLSLParser::EndScope()
 {
-    int numVariables = m_variables.GetSize() - 1;
-    while (m_variables[numVariables].name != NULL)
+    ASSERT(m_scopes.GetSize() > 0);
+    int firstVariable = m_scopes[m_scopes.GetSize() - 1];
+    m_scopes.Resize(m_scopes.GetSize() - 1);
+
+    // Make the variables that were hidden by this scope visible again.
+    for (int i = m_variables.GetSize() - 1; i >= firstVariable; --i)
     {
-        --numVariables;
-        ASSERT(numVariables >= 0);
+        m_variableIndex.Insert(m_variables[i].name, m_variables[i].shadowed);
     }
-    m_variables.Resize(numVariables);
+    m_variables.Resize(firstVariable);
 }
 
 const HLSLType* HLSLParser::FindVariable(const char* name, bool& global) const
 {
-    for (int i = m_variables.GetSize() - 1; i >= 0; --i)
+    // The names are from the string pool, so they can be looked up by pointer.
+    const int* index = m_variableIndex.Find(name);
+    if (index == NULL || *index < 0)
     {
-        if (m_variables[i].name == name)
-        {
-            global = (i < m_numGlobals);
-            return &m_variables[i].type;
-        }
+        return NULL;
     }
-    return NULL;
+    global = (*index < m_numGlobals);
+    return &m_variables[*index].type;
 }
 
 const HLSLFunction* HLSLParser::FindFunction(const char* name) const
 {
-    for (int i = 0; i < m_functions.GetSize(); ++i)
+    const FunctionOverloads* overloads = m_functionIndex.Find(name);
+    if (overloads == NULL)
     {
-        if (m_functions[i]->name == name)
+        return NULL;
+    }
+    return m_overloads[overloads->first].function;
+}
+
+void HLSLParser::DeclareFunction(const HLSLFunction* function)
+{
+    int index = m_overloads.GetSize();
+
+    FunctionOverload& overload = m_overloads.PushBackNew();
+    overload.function = function;
+    overload.next     = -1;
+
+    FunctionOverloads* overloads = m_functionIndex.Find(function->name);
+    if (overloads == NULL)
+    {
+        FunctionOverloads first;
+        first.first = index;
+        first.last  = index;
+        first.count = 1;
+        m_functionIndex.Insert(function->name, first);
+    }
+    else
+    {
+        m_overloads[overloads->last].next = index;
+        overloads->last = index;
+        ++overloads->count;
+    }
+}
+
+int HLSLParser::FindIntrinsics(const char* name) const
+{
+    // Skip over any names which share the bucket with this one.
+    for (int i = _intrinsicIndex.first[IntrinsicIndex::GetBucket(name)]; i != -1; i = _intrinsicIndex.next[i])
+    {
+        if (String_Equal(_intrinsic[i].function.name, name))
         {
-            return m_functions[i];
+            return i;
         }
     }
-    return NULL;
+    return -1;
 }
 
 void HLSLParser::DeclareVariable(const char* name, const HLSLType& type)
 {
-    if (m_variables.GetSize() == m_numGlobals)
+    if (m_scopes.GetSize() == 0)
     {
         ++m_numGlobals;
     }
+
+    const int* visible = m_variableIndex.Find(name);
+    int shadowed = (visible != NULL) ? *visible : -1;
+    m_variableIndex.Insert(name, m_variables.GetSize());
+
     Variable& variable = m_variables.PushBackNew();
-    variable.name = name;
-    variable.type = type;
+    variable.name     = name;
+    variable.type     = type;
+    variable.shadowed = shadowed;
 }
 
 bool HLSLParser::GetIsFunction(const char* name) const
 {
-    for (int i = 0; i < m_functions.GetSize(); ++i)
+    // User functions are looked up by pointer since the name was passed through
+    // the string pool.
+    return m_functionIndex.Find(name) != NULL || FindIntrinsics(name) != -1;
+}
+
+const HLSLFunction* HLSLParser::MatchFunctionCall(const HLSLFunctionCall* functionCall, const char* name)
+{
+    HLSLPhaseScope phase(m_instrumentation, HLSLPhase_OverloadResolution);
+
+    const FunctionOverloads* overloads = m_functionIndex.Find(name);
+    int numFunctions = (overloads != NULL) ? overloads->count : 0;
+
+    const HLSLFunction* matchedFunction = NULL;
+    int numMatchedOverloads             = 0;
+
+    // Calls with the same argument types resolve the same way, so reuse the result
+    // unless more overloads have been declared since.
+    unsigned int hash = 0;
+    bool cacheable = GetCallSignatureHash(functionCall, name, hash);
+
+    CachedOverload* cached = cacheable ? FindCachedOverload(functionCall, name, hash) : NULL;
+    if (cached != NULL && cached->numFunctions == numFunctions)
     {
-        // == is ok here because we're passed the strings through the string pool.
-        if (m_functions[i]->name == name)
-        {
-            return true;
-        }
+        matchedFunction     = cached->function;
+        numMatchedOverloads = cached->numMatchedOverloads;
     }
-    for (int i = 0; i < _numIntrinsics; ++i)
+    else
     {
-        // Intrinsic names are not in the string pool (since they are compile time
-        // constants, so we need full string compare).
-        if (String_Equal(name, _intrinsic[i].function.name))
+        int firstIntrinsic = FindIntrinsics(name);
+        if (overloads == NULL && firstIntrinsic == -1)
         {
-            return true;
+            m_tokenizer.Error("Undeclared identifier '%s'", name);
+            return NULL;
+        }
+
+        matchedFunction = ResolveOverload(functionCall, name, overloads, firstIntrinsic, numMatchedOverloads);
+        if (cached != NULL)
+        {
+            cached->numFunctions        = numFunctions;
+            cached->function            = matchedFunction;
+            cached->numMatchedOverloads = numMatchedOverloads;
+        }
+        else if (cacheable)
+        {
+            AddCachedOverload(functionCall, name, hash, numFunctions, matchedFunction, numMatchedOverloads);
         }
     }
 
-    return false;
+    if (matchedFunction != NULL && numMatchedOverloads > 1)
+    {
+        // Multiple overloads match.
+        m_tokenizer.Error("'%s' %d overloads have similar conversions", name, numMatchedOverloads);
+        return NULL;
+    }
+    else if (matchedFunction == NULL)
+    {
+        m_tokenizer.Error("'%s' no overloaded function matched all of the arguments", name);
+    }
+
+    return matchedFunction;
+
 }
 
-const HLSLFunction* HLSLParser::MatchFunctionCall(const HLSLFunctionCall* functionCall, const char* name)
+const HLSLFunction* HLSLParser::ResolveOverload(const HLSLFunctionCall* functionCall, const char* name,
+    const FunctionOverloads* overloads, int firstIntrinsic, int& numMatchedOverloads) const
 {
 
-    const HLSLFunction* matchedFunction     = NULL;
+    const HLSLFunction* matchedFunction = NULL;
 
-    int  numArguments           = functionCall->numArguments;
-    int  numMatchedOverloads    = 0;
-    bool nameMatches            = false;
+    numMatchedOverloads = 0;
+    int numCandidates   = 0;
 
-    // Get the user defined functions with the specified name.
-    for (int i = 0; i < m_functions.GetSize(); ++i)
+    // Visit the user defined functions with the specified name, then the intrinsics.
+    for (int i = (overloads != NULL) ? overloads->first : -1; i != -1; i = m_overloads[i].next)
     {
-        const HLSLFunction* function = m_functions[i];
-        if (function->name == name)
-        {
-            nameMatches = true;
-            
-            CompareFunctionsResult result = CompareFunctions( functionCall, function, matchedFunction );
-            if (result == Function1Better)
-            {
-                matchedFunction = function;
-                numMatchedOverloads = 1;
-            }
-            else if (result == FunctionsEqual)
-            {
-                ++numMatchedOverloads;
-            }
-        }
+        RankOverload(functionCall, m_overloads[i].function, matchedFunction, numMatchedOverloads, numCandidates);
     }
-
-    // Get the intrinsic functions with the specified name.
-    for (int i = 0; i < _numIntrinsics; ++i)
+    for (int i = firstIntrinsic; i != -1; i = _intrinsicIndex.next[i])
     {
+        // Intrinsics with other names can share the bucket.
         const HLSLFunction* function = &_intrinsic[i].function;
         if (String_Equal(function->name, name))
         {
-            nameMatches = true;
-
-            CompareFunctionsResult result = CompareFunctions( functionCall, function, matchedFunction );
-            if (result == Function1Better)
-            {
-                matchedFunction = function;
-                numMatchedOverloads = 1;
-            }
-            else if (result == FunctionsEqual)
-            {
-                ++numMatchedOverloads;
-            }
+            RankOverload(functionCall, function, matchedFunction, numMatchedOverloads, numCandidates);
         }
     }
 
-    if (matchedFunction != NULL && numMatchedOverloads > 1)
+    if (m_instrumentation != NULL)
     {
-        // Multiple overloads match.
-        m_tokenizer.Error("'%s' %d overloads have similar conversions", name, numMatchedOverloads);
-        return NULL;
+        m_instrumentation->AddCount(HLSLCounter_OverloadCandidates, numCandidates);
     }
-    else if (matchedFunction == NULL)
+
+    return matchedFunction;
+
+}
+
+void HLSLParser::RankOverload(const HLSLFunctionCall* functionCall, const HLSLFunction* function,
+    const HLSLFunction*& matchedFunction, int& numMatchedOverloads, int& numCandidates) const
+{
+    if (function->numArguments != functionCall->numArguments)
+    {
+        // Can't be viable, so don't bother ranking the arguments.
+        return;
+    }
+
+    ++numCandidates;
+    CompareFunctionsResult result = CompareFunctions( functionCall, function, matchedFunction );
+    if (result == Function1Better)
+    {
+        matchedFunction = function;
+        numMatchedOverloads = 1;
+    }
+    else if (result == FunctionsEqual)
     {
-        if (nameMatches)
+        ++numMatchedOverloads;
+    }
+}
+
+bool HLSLParser::GetCallSignatureHash(const HLSLFunctionCall* functionCall, const char* name, unsigned int& hash) const
+{
+    hash = HashMap_GetHash(name);
+    for (const HLSLExpression* argument = functionCall->argument; argument != NULL; argument = argument->nextExpression)
+    {
+        const HLSLType& type = argument->expressionType;
+        if (type.array)
         {
-            m_tokenizer.Error("'%s' no overloaded function matched all of the arguments", name);
+            // Array arguments are matched by their size expression, which is
+            // different for every declaration.
+            return false;
         }
-        else
+        uint64_t key = (static_cast<uint64_t>(hash) << 32) ^ HashMap_GetHash(type.typeName) ^ type.baseType;
+        hash = HashMap_GetHash(key);
+    }
+    return true;
+}
+
+HLSLParser::CachedOverload* HLSLParser::FindCachedOverload(const HLSLFunctionCall* functionCall, const char* name, unsigned int hash)
+{
+    const int* first = m_overloadCache.Find(hash);
+    for (int i = (first != NULL) ? *first : -1; i != -1; i = m_cachedOverloads[i].next)
+    {
+        CachedOverload& cached = m_cachedOverloads[i];
+        if (cached.name != name || cached.numArguments != functionCall->numArguments)
         {
-            m_tokenizer.Error("Undeclared identifier '%s'", name);
+            continue;
+        }
+
+        const HLSLExpression* argument = functionCall->argument;
+        int j = 0;
+        while (j < cached.numArguments)
+        {
+            const CachedArgument& cachedArgument = m_cachedArguments[cached.firstArgument + j];
+            if (cachedArgument.baseType != argument->expressionType.baseType ||
+                cachedArgument.typeName != argument->expressionType.typeName)
+            {
+                break;
+            }
+            argument = argument->nextExpression;
+            ++j;
+        }
+        if (j == cached.numArguments)
+        {
+            return &cached;
         }
     }
+    return NULL;
+}
 
-    return matchedFunction;
+void HLSLParser::AddCachedOverload(const HLSLFunctionCall* functionCall, const char* name, unsigned int hash,
+    int numFunctions, const HLSLFunction* function, int numMatchedOverloads)
+{
+    const int* first = m_overloadCache.Find(hash);
+
+    CachedOverload& cached = m_cachedOverloads.PushBackNew();
+    cached.name                 = name;
+    cached.numArguments         = functionCall->numArguments;
+    cached.firstArgument        = m_cachedArguments.GetSize();
+    cached.numFunctions         = numFunctions;
+    cached.function             = function;
+    cached.numMatchedOverloads  = numMatchedOverloads;
+    cached.next                 = (first != NULL) ? *first : -1;
+
+    for (const HLSLExpression* argument = functionCall->argument; argument != NULL; argument = argument->nextExpression)
+    {
+        CachedArgument& cachedArgument = m_cachedArguments.PushBackNew();
+        cachedArgument.baseType = argument->expressionType.baseType;
+        cachedArgument.typeName = argument->expressionType.typeName;
+    }
 
+    m_overloadCache.Insert(hash, m_cachedOverloads.GetSize() - 1);
 }
 
 bool HLSLParser::GetMemberType(const HLSLType& objectType, const char* fieldName, HLSLType& memberType)
 {
+    HLSLPhaseScope phase(m_instrumentation, HLSLPhase_TypeCheck);
 
     if (objectType.baseType == HLSLBaseType_UserDefined)
     {
         const HLSLStruct* structure = FindUserDefinedType( objectType.typeName );
         ASSERT(structure != NULL);
 
-        const HLSLStructField* field = structure->field;
-        while (field != NULL)
+        const HLSLStructField* field = FindStructField( structure, fieldName );
+        if (field == NULL)
         {
-            if (field->name == fieldName)
-            {
-                memberType = field->type;
-                return true;
-            }
-            field = field->nextField;
+            return false;
         }
 
-        return false;
+        memberType = field->type;
+        return true;
     }
 
     if (_baseTypeDescriptions[objectType.baseType].numericType == NumericType_NaN)
@@ -2252,8 +2572,7 @@ bool HLSLParser::GetMemberType(const HLSLType& objectType, const char* fieldName
         // Check for a swizzle on the scalar/vector types.
         for (int i = 0; fieldName[i] != 0; ++i)
         {
-            if (fieldName[i] != 'x' && fieldName[i] != 'y' && fieldName[i] != 'z' && fieldName[i] != 'w' &&
-                fieldName[i] != 'r' && fieldName[i] != 'g' && fieldName[i] != 'b' && fieldName[i] != 'a')
+            if (_swizzleComponent.component[static_cast<unsigned char>(fieldName[i])] == -1)
             {
                 m_tokenizer.Error("Invalid swizzle '%s'", fieldName);
                 return false;
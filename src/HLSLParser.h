@@ -11,8 +11,10 @@
 #define HLSL_PARSER_H
 
 #include "Engine/StringPool.h"
+#include "Engine/HashMap.h"
 #include "Engine/Array.h"
 
+#include "HLSLInstrumentation.h"
 #include "HLSLTokenizer.h"
 #include "HLSLTree.h"
 
@@ -26,10 +28,69 @@ public:
 
     HLSLParser(Allocator* allocator, const char* fileName, const char* buffer, size_t length);
 
+    /**
+     * Optionally tokenizes the entire buffer before parsing, so that Parse walks
+     * the stored tokens rather than scanning the source as it goes. This must be
+     * called before Parse. Returns false if there was an error; note that
+     * tokenizer errors are then reported before any parse errors.
+     */
+    bool Tokenize();
+
+    /** Returns the number of tokens stored by Tokenize. */
+    int GetNumTokens() const;
+
     bool Parse(HLSLTree* tree);
 
+    /** Reports timings and counts to the instrumentation, which is optional. */
+    void SetInstrumentation(HLSLInstrumentation* instrumentation);
+
 private:
 
+    struct Variable
+    {
+        const char*     name;
+        HLSLType        type;
+        int             shadowed;       // Index of the variable this one hides, or -1.
+    };
+
+    struct FunctionOverload
+    {
+        const HLSLFunction* function;
+        int                 next;           // Index of the next overload in the list, or -1.
+    };
+
+    struct FunctionOverloads
+    {
+        int                 first;
+        int                 last;
+        int                 count;
+    };
+
+    /** Result of resolving a call, reused by later calls with the same signature. */
+    struct CachedOverload
+    {
+        const char*         name;
+        int                 numArguments;
+        int                 firstArgument;      // Index into m_cachedArguments.
+        int                 numFunctions;       // Number of user overloads when resolved.
+        const HLSLFunction* function;
+        int                 numMatchedOverloads;
+        int                 next;               // Index of the next entry with the same hash, or -1.
+    };
+
+    struct CachedArgument
+    {
+        HLSLBaseType        baseType;
+        const char*         typeName;
+    };
+
+    struct StructFieldEntry
+    {
+        const HLSLStruct*       structure;
+        const HLSLStructField*  field;
+        int                     next;       // Index of the next entry with the same hash, or -1.
+    };
+
     bool Accept(int token);
     bool Expect(int token);
 
@@ -76,6 +137,11 @@ private:
 
     const HLSLStruct* FindUserDefinedType(const char* name) const;
 
+    /** Adds a field to the index used by FindStructField; called as the struct is parsed. */
+    void DeclareStructField(const HLSLStruct* structure, const HLSLStructField* field);
+
+    const HLSLStructField* FindStructField(const HLSLStruct* structure, const char* name) const;
+
     void BeginScope();
     void EndScope();
 
@@ -84,6 +150,12 @@ private:
     /** Returned pointer is only valid until Declare or Begin/EndScope is called. */
     const HLSLType* FindVariable(const char* name, bool& global) const;
 
+    /** Adds a user defined function to the overload table. */
+    void DeclareFunction(const HLSLFunction* function);
+
+    /** Returns the index in the intrinsic table of the first overload with the name, or -1. */
+    int FindIntrinsics(const char* name) const;
+
     const HLSLFunction* FindFunction(const char* name) const;
     
     bool GetIsFunction(const char* name) const;
@@ -91,6 +163,29 @@ private:
     /** Finds the overloaded function that matches the specified call. */
     const HLSLFunction* MatchFunctionCall(const HLSLFunctionCall* functionCall, const char* name);
 
+    /**
+     * Ranks the overloads with the specified name against the call. Returns the best
+     * match (or NULL) and the number of overloads which are equally good.
+     */
+    const HLSLFunction* ResolveOverload(const HLSLFunctionCall* functionCall, const char* name,
+        const FunctionOverloads* overloads, int firstIntrinsic, int& numMatchedOverloads) const;
+
+    /** Compares one overload against the best match found so far by ResolveOverload. */
+    void RankOverload(const HLSLFunctionCall* functionCall, const HLSLFunction* function,
+        const HLSLFunction*& matchedFunction, int& numMatchedOverloads, int& numCandidates) const;
+
+    /**
+     * Computes the hash used to cache the resolution of a call from the function name
+     * and argument types. Returns false if the call can't be cached.
+     */
+    bool GetCallSignatureHash(const HLSLFunctionCall* functionCall, const char* name, unsigned int& hash) const;
+
+    /** Returns the cached resolution of a call with the same signature, or NULL. */
+    CachedOverload* FindCachedOverload(const HLSLFunctionCall* functionCall, const char* name, unsigned int hash);
+
+    void AddCachedOverload(const HLSLFunctionCall* functionCall, const char* name, unsigned int hash,
+        int numFunctions, const HLSLFunction* function, int numMatchedOverloads);
+
     /** Gets the type of the named field on the specified object type (fieldName can also specify a swizzle. ) */
     bool GetMemberType(const HLSLType& objectType, const char* fieldName, HLSLType& memberType);
 
@@ -101,19 +196,23 @@ private:
 
 private:
 
-    struct Variable
-    {
-        const char*     name;
-        HLSLType        type;
-    };
-
     HLSLTokenizer           m_tokenizer;
-    Array<HLSLStruct*>      m_userTypes;
+    HLSLTokenBuffer         m_tokenBuffer;
+    HashMap<const char*, const HLSLStruct*> m_userTypes;    // Keyed by interned struct name.
+    Array<StructFieldEntry> m_structFields;
+    HashMap<unsigned int, int> m_structFieldIndex;              // Fields by struct and name hash.
     Array<Variable>         m_variables;
-    Array<HLSLFunction*>    m_functions;
+    Array<int>              m_scopes;           // Index of the first variable in each open scope.
+    HashMap<const char*, int> m_variableIndex;  // Index of the visible variable with a name, or -1.
+    Array<FunctionOverload> m_overloads;        // User functions; the intrinsics have a static index.
+    HashMap<const char*, FunctionOverloads> m_functionIndex;    // User functions by interned name.
+    Array<CachedOverload>   m_cachedOverloads;
+    Array<CachedArgument>   m_cachedArguments;
+    HashMap<unsigned int, int> m_overloadCache;                 // Calls by signature hash.
     int                     m_numGlobals;
 
     HLSLTree*               m_tree;
+    HLSLInstrumentation*    m_instrumentation;
 
 };
 
@@ -1,13 +1,30 @@
+#include "Engine/Assert.h"
 #include "Engine/Log.h"
 #include "Engine/String.h"
 
 #include "HLSLTokenizer.h"
 
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HLSL_TOKENIZER_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define HLSL_TOKENIZER_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && HLSL_TOKENIZER_SSE2
+#include <intrin.h>
+#endif
+
+#define HLSL_TOKENIZER_SIMD (HLSL_TOKENIZER_SSE2 || HLSL_TOKENIZER_NEON)
 
 namespace M4
 {
@@ -61,59 +78,337 @@ static const char* _reservedWords[] =
         "inout",
     };
 
-static bool GetIsSymbol(char c)
+// Compile time check that _reservedWords has an entry for every reserved word token.
+typedef char _reservedWordsCountCheck[(sizeof(_reservedWords) / sizeof(const char*) == HLSLToken_LessEqual - HLSLToken_Float) ? 1 : -1];
+
+/** Returns true if the identifier matches the reserved word for the specified token. */
+static bool GetIsReservedWord(const char* identifier, size_t length, int token)
 {
-    switch (c)
-    {
-    case ';':
-    case ':':
-    case '(': case ')':
-    case '[': case ']':
-    case '{': case '}':
-    case '-': case '+':
-    case '*': case '/':
-    case '?':
-    case '!':
-    case ',':
-    case '=':
-    case '.':
-    case '<': case '>':
-        return true;
+    const char* reservedWord = _reservedWords[token - HLSLToken_Float];
+    return strncmp(reservedWord, identifier, length) == 0 && reservedWord[length] == 0;
+}
+
+/**
+ * Returns the token for the reserved word or HLSLToken_Identifier if the string
+ * is not a reserved word. The candidate token is selected by the length and the
+ * first character of the identifier (with the last character distinguishing the
+ * vector sizes), so at most one string compare is performed.
+ */
+static int GetReservedWordToken(const char* identifier, size_t length)
+{
+    int token = HLSLToken_Identifier;
+    const char last = (length > 0) ? identifier[length - 1] : 0;
+    switch (length)
+    {
+    case 2:
+        switch (identifier[0])
+        {
+        case 'i': token = (last == 'f') ? HLSLToken_If : HLSLToken_In; break;
+        }
+        break;
+    case 3:
+        switch (identifier[0])
+        {
+        case 'i': token = HLSLToken_Int; break;
+        case 'f': token = HLSLToken_For; break;
+        }
+        break;
+    case 4:
+        switch (identifier[0])
+        {
+        case 'h': token = HLSLToken_Half; break;
+        case 'b': token = HLSLToken_Bool; break;
+        case 'i': if (last >= '2' && last <= '4') token = HLSLToken_Int2 + (last - '2'); break;
+        case 'u': token = HLSLToken_Uint; break;
+        case 'e': token = HLSLToken_Else; break;
+        case 't': token = HLSLToken_True; break;
+        case 'v': token = HLSLToken_Void; break;
+        }
+        break;
+    case 5:
+        switch (identifier[0])
+        {
+        case 'f': token = (last == 't') ? HLSLToken_Float : HLSLToken_False; break;
+        case 'h': if (last >= '2' && last <= '4') token = HLSLToken_Half2 + (last - '2'); break;
+        case 'u': if (last >= '2' && last <= '4') token = HLSLToken_Uint2 + (last - '2'); break;
+        case 'w': token = HLSLToken_While; break;
+        case 'b': token = HLSLToken_Break; break;
+        case 'c': token = HLSLToken_Const; break;
+        case 'i': token = HLSLToken_InOut; break;
+        }
+        break;
+    case 6:
+        switch (identifier[0])
+        {
+        case 'f': if (last >= '2' && last <= '4') token = HLSLToken_Float2 + (last - '2'); break;
+        case 's': token = HLSLToken_Struct; break;
+        case 'r': token = HLSLToken_Return; break;
+        }
+        break;
+    case 7:
+        switch (identifier[0])
+        {
+        case 't': token = (identifier[1] == 'e') ? HLSLToken_Texture : HLSLToken_TBuffer; break;
+        case 'h': token = (identifier[4] == '3') ? HLSLToken_Half3x3 : HLSLToken_Half4x4; break;
+        case 'c': token = HLSLToken_CBuffer; break;
+        case 'd': token = HLSLToken_Discard; break;
+        case 'u': token = HLSLToken_Uniform; break;
+        }
+        break;
+    case 8:
+        switch (identifier[0])
+        {
+        case 'f': token = (identifier[5] == '3') ? HLSLToken_Float3x3 : HLSLToken_Float4x4; break;
+        case 'r': token = HLSLToken_Register; break;
+        case 'c': token = HLSLToken_Continue; break;
+        }
+        break;
+    case 9:
+        if (identifier[0] == 's') token = HLSLToken_Sampler2D;
+        break;
+    case 10:
+        if (identifier[0] == 'p') token = HLSLToken_PackOffset;
+        break;
+    case 11:
+        if (identifier[0] == 's') token = HLSLToken_SamplerCube;
+        break;
     }
-    return false;
+    if (token != HLSLToken_Identifier && !GetIsReservedWord(identifier, length, token))
+    {
+        token = HLSLToken_Identifier;
+    }
+    return token;
 }
 
-/** Returns true if the character is a valid token separator at the end of a number type token */
+#ifdef DEBUG
+/** Verifies that every entry in _reservedWords is classified as its own token. */
+static bool CheckReservedWordTokens()
+{
+    const int numReservedWords = sizeof(_reservedWords) / sizeof(const char*);
+    for (int i = 0; i < numReservedWords; ++i)
+    {
+        const char* reservedWord = _reservedWords[i];
+        if (GetReservedWordToken(reservedWord, strlen(reservedWord)) != HLSLToken_Float + i)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+enum CharClass
+{
+    CharClass_Whitespace    = 1 << 0,
+    CharClass_Symbol        = 1 << 1,
+    CharClass_Separator     = 1 << 2,   // Ends an identifier or number (whitespace, symbols and 0)
+    CharClass_Digit         = 1 << 3,
+    CharClass_HexDigit      = 1 << 4,
+};
+
+#define N (CharClass_Separator)
+#define W (CharClass_Whitespace | CharClass_Separator)
+#define S (CharClass_Symbol | CharClass_Separator)
+#define D (CharClass_Digit | CharClass_HexDigit)
+#define H (CharClass_HexDigit)
+#define O 0
+
+/** Classification of every character, shared by all of the scanning loops. Whitespace
+matches isspace in the "C" locale. */
+static const unsigned char _charClass[256] =
+    {
+        N, O, O, O, O, O, O, O, O, W, W, W, W, W, O, O,   // 00 - 0F
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // 10 - 1F
+        W, S, O, O, O, O, O, O, S, S, S, S, S, S, S, S,   // 20 - 2F
+        D, D, D, D, D, D, D, D, D, D, S, S, S, S, S, S,   // 30 - 3F
+        O, H, H, H, H, H, H, O, O, O, O, O, O, O, O, O,   // 40 - 4F
+        O, O, O, O, O, O, O, O, O, O, O, S, O, S, O, O,   // 50 - 5F
+        O, H, H, H, H, H, H, O, O, O, O, O, O, O, O, O,   // 60 - 6F
+        O, O, O, O, O, O, O, O, O, O, O, S, O, S, O, O,   // 70 - 7F
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // 80 - 8F
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // 90 - 9F
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // A0 - AF
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // B0 - BF
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // C0 - CF
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // D0 - DF
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // E0 - EF
+        O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,   // F0 - FF
+    };
+
+#undef N
+#undef W
+#undef S
+#undef D
+#undef H
+#undef O
+
+static bool GetIsWhitespace(char c)
+{
+    return (_charClass[static_cast<unsigned char>(c)] & CharClass_Whitespace) != 0;
+}
+
+static bool GetIsSymbol(char c)
+{
+    return (_charClass[static_cast<unsigned char>(c)] & CharClass_Symbol) != 0;
+}
+
+static bool GetIsDigit(char c)
+{
+    return (_charClass[static_cast<unsigned char>(c)] & CharClass_Digit) != 0;
+}
+
+static bool GetIsHexDigit(char c)
+{
+    return (_charClass[static_cast<unsigned char>(c)] & CharClass_HexDigit) != 0;
+}
+
+/** Returns true if the character is a valid token separator at the end of a number or identifier token */
 static bool GetIsNumberSeparator(char c)
 {
-    return c == 0 || isspace(c) || GetIsSymbol(c);
+    return (_charClass[static_cast<unsigned char>(c)] & CharClass_Separator) != 0;
+}
+
+#if HLSL_TOKENIZER_SIMD
+
+static int CountBits(unsigned int mask)
+{
+    mask = mask - ((mask >> 1) & 0x55555555);
+    mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+    return (((mask + (mask >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+/** Returns the index of the lowest set bit. The mask must be non-zero. */
+static int GetFirstBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
 }
 
+#if HLSL_TOKENIZER_SSE2
+
+typedef __m128i Block;
+
+static Block LoadBlock(const char* p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+/** Returns a 16 bit mask with a bit set for each byte in the block equal to c. */
+static unsigned int GetMatchMask(Block block, char c)
+{
+    return static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c))));
+}
+
+/** Returns a 16 bit mask with a bit set for each whitespace byte in the block. */
+static unsigned int GetWhitespaceMask(Block block)
+{
+    // '\t', '\n', '\v', '\f' and '\r' are the range 9 to 13.
+    __m128i offset = _mm_sub_epi8(block, _mm_set1_epi8(9));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(4)), offset);
+    __m128i space = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+    return static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(control, space)));
+}
+
+#else
+
+typedef uint8x16_t Block;
+
+static Block LoadBlock(const char* p)
+{
+    return vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+}
+
+static unsigned int GetByteMask(uint8x16_t compare)
+{
+    static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t masked = vandq_u8(compare, vld1q_u8(bits));
+    return vaddv_u8(vget_low_u8(masked)) | (vaddv_u8(vget_high_u8(masked)) << 8);
+}
+
+static unsigned int GetMatchMask(Block block, char c)
+{
+    return GetByteMask(vceqq_u8(block, vdupq_n_u8(static_cast<uint8_t>(c))));
+}
+
+static unsigned int GetWhitespaceMask(Block block)
+{
+    uint8x16_t control = vcleq_u8(vsubq_u8(block, vdupq_n_u8(9)), vdupq_n_u8(4));
+    uint8x16_t space = vceqq_u8(block, vdupq_n_u8(' '));
+    return GetByteMask(vorrq_u8(control, space));
+}
+
+#endif
+
+#endif
+
 HLSLTokenizer::HLSLTokenizer(const char* fileName, const char* buffer, size_t length)
 {
+    m_bufferStart       = buffer;
     m_buffer            = buffer;
+    m_tokenStart        = buffer;
     m_bufferEnd         = buffer + length;
     m_fileName          = fileName;
     m_lineNumber        = 1;
     m_tokenLineNumber   = 1;
     m_error             = false;
+    m_fileNameChanges   = 0;
+    m_tokenBuffer       = NULL;
+    m_tokenIndex        = 0;
+    m_fileNameIndex     = 0;
+#ifdef DEBUG
+    static const bool reservedWordsValid = CheckReservedWordTokens();
+    ASSERT(reservedWordsValid);
+#endif
     Next();
 }
 
+HLSLTokenBuffer::HLSLTokenBuffer(Allocator* allocator) :
+    m_token(allocator),
+    m_offset(allocator),
+    m_length(allocator),
+    m_line(allocator),
+    m_value(allocator),
+    m_fileName(allocator),
+    m_stringPool(allocator)
+{
+}
+
+int HLSLTokenBuffer::GetNumTokens() const
+{
+    return m_token.GetSize();
+}
+
 void HLSLTokenizer::Next()
 {
 
+    if (m_tokenBuffer != NULL)
+    {
+        // Stay on the final end of stream token.
+        if (m_tokenIndex + 1 < m_tokenBuffer->GetNumTokens())
+        {
+            LoadToken(m_tokenIndex + 1);
+        }
+        return;
+    }
+
     while (SkipWhitespace() || SkipComment() || ScanLineDirective())
     {
     }
 
     if (m_error)
     {
-        m_token = HLSLToken_EndOfStream;
+        m_token      = HLSLToken_EndOfStream;
+        m_tokenStart = m_buffer;
         return;
     }
 
     m_tokenLineNumber = m_lineNumber;
+    m_tokenStart      = m_buffer;
 
     if (m_buffer >= m_bufferEnd)
     {
@@ -208,42 +503,113 @@ void HLSLTokenizer::Next()
 
     // Must be an identifier or a reserved word.
 
-    while (m_buffer < m_bufferEnd && m_buffer[0] != 0 && !GetIsSymbol(m_buffer[0]) && !isspace(m_buffer[0]))
+    while (m_buffer < m_bufferEnd && !GetIsNumberSeparator(m_buffer[0]))
     {
         ++m_buffer;
     }
 
-    size_t length = m_buffer - start;
-    memcpy(m_identifier, start, length);
-    m_identifier[length] = 0;
+    // The text of identifiers isn't copied; it's accessed through the span.
+    m_token = GetReservedWordToken(start, m_buffer - start);
 
-    const int numReservedWords = sizeof(_reservedWords) / sizeof(const char*);
-    for (int i = 0; i < numReservedWords; ++i)
+}
+
+bool HLSLTokenizer::SkipWhitespace()
+{
+    const char* start = m_buffer;
+#if HLSL_TOKENIZER_SIMD
+    while (m_bufferEnd - m_buffer >= 16)
     {
-        if (strcmp(_reservedWords[i], m_identifier) == 0)
+        Block block = LoadBlock(m_buffer);
+        unsigned int whitespace = GetWhitespaceMask(block);
+        unsigned int newLines   = GetMatchMask(block, '\n');
+        if (whitespace != 0xFFFF)
         {
-            m_token = 256 + i;
-            return;
+            // Only count the new lines before the first non-whitespace character.
+            int length = GetFirstBit(~whitespace);
+            m_lineNumber += CountBits(newLines & ((1u << length) - 1));
+            m_buffer += length;
+            return m_buffer != start;
         }
+        m_lineNumber += CountBits(newLines);
+        m_buffer += 16;
     }
+#endif
+    while (m_buffer < m_bufferEnd && GetIsWhitespace(m_buffer[0]))
+    {
+        if (m_buffer[0] == '\n')
+        {
+            ++m_lineNumber;
+        }
+        ++m_buffer;
+    }
+    return m_buffer != start;
+}
 
-    m_token = HLSLToken_Identifier;
-
+void HLSLTokenizer::SkipLineCommentBody()
+{
+#if HLSL_TOKENIZER_SIMD
+    while (m_bufferEnd - m_buffer >= 16)
+    {
+        unsigned int newLines = GetMatchMask(LoadBlock(m_buffer), '\n');
+        if (newLines != 0)
+        {
+            m_buffer += GetFirstBit(newLines) + 1;
+            ++m_lineNumber;
+            return;
+        }
+        m_buffer += 16;
+    }
+#endif
+    while (m_buffer < m_bufferEnd)
+    {
+        if (*(m_buffer++) == '\n')
+        {
+            ++m_lineNumber;
+            break;
+        }
+    }
 }
 
-bool HLSLTokenizer::SkipWhitespace()
+void HLSLTokenizer::SkipBlockCommentBody()
 {
-    bool result = false;
-    while (m_buffer < m_bufferEnd && isspace(m_buffer[0]))
+    while (m_buffer < m_bufferEnd)
     {
-        result = true;
+#if HLSL_TOKENIZER_SIMD
+        // Skip ahead to the next '*' which could end the comment.
+        while (m_bufferEnd - m_buffer >= 16)
+        {
+            Block block = LoadBlock(m_buffer);
+            unsigned int stars    = GetMatchMask(block, '*');
+            unsigned int newLines = GetMatchMask(block, '\n');
+            if (stars != 0)
+            {
+                int length = GetFirstBit(stars);
+                m_lineNumber += CountBits(newLines & ((1u << length) - 1));
+                m_buffer += length;
+                break;
+            }
+            m_lineNumber += CountBits(newLines);
+            m_buffer += 16;
+        }
+        if (m_buffer >= m_bufferEnd)
+        {
+            break;
+        }
+#endif
         if (m_buffer[0] == '\n')
         {
             ++m_lineNumber;
         }
+        if (m_buffer[0] == '*' && m_buffer[1] == '/')
+        {
+            break;
+        }
         ++m_buffer;
     }
-    return result;
+    if (m_buffer < m_bufferEnd)
+    {
+        m_buffer += 2;
+    }
 }
 
 bool HLSLTokenizer::SkipComment()
@@ -256,36 +622,14 @@ bool HLSLTokenizer::SkipComment()
             // Single line comment.
             result = true;
             m_buffer += 2;
-            while (m_buffer < m_bufferEnd)
-            {
-                if (*(m_buffer++) == '\n')
-                {
-                    ++m_lineNumber;
-                    break;
-                }
-            }
+            SkipLineCommentBody();
         }
         else if (m_buffer[1] == '*')
         {
             // Multi-line comment.
             result = true;
             m_buffer += 2;
-            while (m_buffer < m_bufferEnd)
-            {
-                if (m_buffer[0] == '\n')
-                {
-                    ++m_lineNumber;
-                }
-                if (m_buffer[0] == '*' && m_buffer[1] == '/')
-                {
-                    break;
-                }
-                ++m_buffer;
-            }
-            if (m_buffer < m_bufferEnd)
-            {
-                m_buffer += 2;
-            }
+            SkipBlockCommentBody();
         }
     }
     return result;
@@ -294,57 +638,159 @@ bool HLSLTokenizer::SkipComment()
 bool HLSLTokenizer::ScanNumber()
 {
 
-    // Don't treat the + or - as part of the number.
-    if (m_buffer[0] == '+' || m_buffer[0] == '-')
+    // Numbers start with a digit or a decimal point followed by a digit. Note that
+    // the + or - is not treated as part of the number.
+    const char* buffer = m_buffer;
+    if (!GetIsDigit(buffer[0]) && !(buffer[0] == '.' && buffer + 1 < m_bufferEnd && GetIsDigit(buffer[1])))
     {
         return false;
     }
 
-    char* fEnd = NULL;
-    double fValue = String_ToDouble(m_buffer, &fEnd);
+    if (buffer[0] == '0' && buffer + 1 < m_bufferEnd && (buffer[1] == 'x' || buffer[1] == 'X'))
+    {
+        // Hexadecimal integer.
+        buffer += 2;
+        const char* digitsStart = buffer;
+        unsigned int value = 0;
+        while (buffer < m_bufferEnd && GetIsHexDigit(buffer[0]))
+        {
+            int digit = GetIsDigit(buffer[0]) ? buffer[0] - '0' : (buffer[0] | 0x20) - 'a' + 10;
+            value = (value > (INT_MAX >> 4)) ? INT_MAX : std::min<unsigned int>(value * 16 + digit, INT_MAX);
+            ++buffer;
+        }
+        if (buffer == digitsStart)
+        {
+            return false;
+        }
+        if (buffer < m_bufferEnd && (buffer[0] == 'u' || buffer[0] == 'U'))
+        {
+            ++buffer;
+        }
+        if (buffer < m_bufferEnd && !GetIsNumberSeparator(buffer[0]))
+        {
+            return false;
+        }
+        m_buffer = buffer;
+        m_token  = HLSLToken_IntLiteral;
+        m_iValue = static_cast<int>(value);
+        return true;
+    }
 
-    if (fEnd == m_buffer)
+    // Classify and accumulate the literal in a single pass. Only the significant
+    // digits are stored; the position of the decimal point and the exponent are
+    // folded into a single power of ten.
+    char digits[s_maxNumberDigits];
+    int  numDigits = 0;
+    int  exponent  = 0;
+    bool truncated = false;
+    bool isFloat   = false;
+    bool isOctal   = buffer[0] == '0';
+
+    for (int part = 0; part < 2; ++part)
     {
-        return false;
+        while (buffer < m_bufferEnd && GetIsDigit(buffer[0]))
+        {
+            if (numDigits == 0 && buffer[0] == '0')
+            {
+                // Leading zeros only move the decimal point.
+            }
+            else if (numDigits < s_maxNumberDigits)
+            {
+                digits[numDigits++] = buffer[0];
+            }
+            else
+            {
+                truncated |= (buffer[0] != '0');
+                ++exponent;
+            }
+            if (part == 1)
+            {
+                --exponent;
+            }
+            isOctal &= (buffer[0] < '8');
+            ++buffer;
+        }
+        if (part == 1 || buffer >= m_bufferEnd || buffer[0] != '.')
+        {
+            break;
+        }
+        isFloat = true;
+        ++buffer;
     }
 
-    char*  iEnd = NULL;
-    int    iValue = String_ToInteger(m_buffer, &iEnd);
+    if (buffer < m_bufferEnd && (buffer[0] == 'e' || buffer[0] == 'E'))
+    {
+        ++buffer;
+        bool negative = false;
+        if (buffer < m_bufferEnd && (buffer[0] == '+' || buffer[0] == '-'))
+        {
+            negative = buffer[0] == '-';
+            ++buffer;
+        }
+        if (buffer >= m_bufferEnd || !GetIsDigit(buffer[0]))
+        {
+            return false;
+        }
+        int power = 0;
+        while (buffer < m_bufferEnd && GetIsDigit(buffer[0]))
+        {
+            // Clamped well past the range of a float so that it can't overflow.
+            power = std::min(power * 10 + (buffer[0] - '0'), 100000);
+            ++buffer;
+        }
+        exponent += negative ? -power : power;
+        isFloat = true;
+    }
+
+    // An f or h suffix makes the number a float (to handle 1.0f syntax), and
+    // integers can be marked as unsigned with a u.
+    if (buffer < m_bufferEnd && (buffer[0] == 'f' || buffer[0] == 'F' || buffer[0] == 'h' || buffer[0] == 'H'))
+    {
+        isFloat = true;
+        ++buffer;
+    }
+    else if (!isFloat && buffer < m_bufferEnd && (buffer[0] == 'u' || buffer[0] == 'U'))
+    {
+        ++buffer;
+    }
 
-    // If the character after the number is an f then the f is treated as part
-    // of the number (to handle 1.0f syntax).
-    if (fEnd[0] == 'f' && fEnd < m_bufferEnd)
+    if (buffer < m_bufferEnd && !GetIsNumberSeparator(buffer[0]))
     {
-        ++fEnd;
+        return false;
     }
 
-    if (fEnd > iEnd && GetIsNumberSeparator(fEnd[0]))
+    m_buffer = buffer;
+    if (isFloat)
     {
-        m_buffer = fEnd;
         m_token  = HLSLToken_FloatLiteral;
-        m_fValue = static_cast<float>(fValue);
-        return true;
+        m_fValue = String_DecimalToFloat(digits, numDigits, exponent, truncated);
     }
-    else if (iEnd > m_buffer && GetIsNumberSeparator(iEnd[0]))
+    else
     {
-        m_buffer = iEnd;
+        // Integers which don't fit are clamped, and a leading 0 means octal.
+        unsigned int base  = isOctal ? 8 : 10;
+        unsigned int value = 0;
+        for (int i = 0; i < numDigits + exponent; ++i)
+        {
+            unsigned int digit = (i < numDigits) ? digits[i] - '0' : 0;
+            value = (value > (INT_MAX - digit) / base) ? INT_MAX : value * base + digit;
+        }
         m_token  = HLSLToken_IntLiteral;
-        m_iValue = iValue;
-        return true;
+        m_iValue = static_cast<int>(value);
     }
+    return true;
 
-    return false;
 }
 
 bool HLSLTokenizer::ScanLineDirective()
 {
     
-    if (m_bufferEnd - m_buffer > 5 && strncmp(m_buffer, "#line", 5) == 0 && isspace(m_buffer[5]))
+    if (m_bufferEnd - m_buffer > 5 && strncmp(m_buffer, "#line", 5) == 0 && GetIsWhitespace(m_buffer[5]))
     {
 
         m_buffer += 5;
         
-        while (m_buffer < m_bufferEnd && isspace(m_buffer[0]))
+        while (m_buffer < m_bufferEnd && GetIsWhitespace(m_buffer[0]))
         {
             if (m_buffer[0] == '\n')
             {
@@ -357,14 +803,14 @@ bool HLSLTokenizer::ScanLineDirective()
         char* iEnd = NULL;
         int lineNumber = String_ToInteger(m_buffer, &iEnd);
 
-        if (!isspace(*iEnd))
+        if (!GetIsWhitespace(*iEnd))
         {
             Error("Syntax error: expected line number after #line");
             return false;
         }
 
         m_buffer = iEnd;
-        while (m_buffer < m_bufferEnd && isspace(m_buffer[0]))
+        while (m_buffer < m_bufferEnd && GetIsWhitespace(m_buffer[0]))
         {
             char c = m_buffer[0];
             ++m_buffer;
@@ -422,7 +868,7 @@ bool HLSLTokenizer::ScanLineDirective()
         
         while (m_buffer < m_bufferEnd && m_buffer[0] != '\n')
         {
-            if (!isspace(m_buffer[0]))
+            if (!GetIsWhitespace(m_buffer[0]))
             {
                 Error("Syntax error: unexpected input after file name near #line");
                 return false;
@@ -435,6 +881,7 @@ bool HLSLTokenizer::ScanLineDirective()
 
         m_lineNumber = lineNumber;
         m_fileName = m_lineDirectiveFileName;
+        ++m_fileNameChanges;
 
         return true;
 
@@ -444,6 +891,114 @@ bool HLSLTokenizer::ScanLineDirective()
 
 }
 
+bool HLSLTokenizer::Tokenize(HLSLTokenBuffer* tokenBuffer)
+{
+    ASSERT(m_tokenBuffer == NULL);
+
+    int lastFileNameChanges = -1;
+    const char* lastFileName = NULL;
+
+    while (true)
+    {
+        int tokenIndex = tokenBuffer->m_token.GetSize();
+
+        // File names set by #line directives are stored in a buffer which is
+        // reused, so they need to be copied.
+        if (m_fileName != lastFileName || m_fileNameChanges != lastFileNameChanges)
+        {
+            HLSLTokenBuffer::FileName& fileName = tokenBuffer->m_fileName.PushBackNew();
+            fileName.firstToken = tokenIndex;
+            fileName.fileName   = (m_fileName != NULL) ? tokenBuffer->m_stringPool.AddString(m_fileName) : NULL;
+            lastFileName        = m_fileName;
+            lastFileNameChanges = m_fileNameChanges;
+        }
+
+        HLSLTokenSpan span = GetSpan();
+        HLSLTokenBuffer::Value value;
+        if (m_token == HLSLToken_FloatLiteral)
+        {
+            value.fValue = m_fValue;
+        }
+        else
+        {
+            value.iValue = m_iValue;
+        }
+
+        tokenBuffer->m_token.PushBack(static_cast<unsigned short>(m_token));
+        tokenBuffer->m_offset.PushBack(span.offset);
+        tokenBuffer->m_length.PushBack(span.length);
+        tokenBuffer->m_line.PushBack(span.line);
+        tokenBuffer->m_value.PushBack(value);
+
+        if (m_token == HLSLToken_EndOfStream)
+        {
+            break;
+        }
+        Next();
+    }
+
+    m_tokenBuffer   = tokenBuffer;
+    m_fileNameIndex = 0;
+    LoadToken(0);
+
+    return !m_error;
+}
+
+void HLSLTokenizer::LoadToken(int tokenIndex)
+{
+    const HLSLTokenBuffer* tokenBuffer = m_tokenBuffer;
+
+    m_tokenIndex        = tokenIndex;
+    m_token             = tokenBuffer->m_token[tokenIndex];
+    m_tokenStart        = m_bufferStart + tokenBuffer->m_offset[tokenIndex];
+    m_buffer            = m_tokenStart + tokenBuffer->m_length[tokenIndex];
+    m_tokenLineNumber   = tokenBuffer->m_line[tokenIndex];
+    m_lineNumber        = m_tokenLineNumber;
+    m_fValue            = tokenBuffer->m_value[tokenIndex].fValue;
+    m_iValue            = tokenBuffer->m_value[tokenIndex].iValue;
+
+    // Find the file name in effect for the token.
+    const Array<HLSLTokenBuffer::FileName>& fileNames = tokenBuffer->m_fileName;
+    while (m_fileNameIndex > 0 && fileNames[m_fileNameIndex].firstToken > tokenIndex)
+    {
+        --m_fileNameIndex;
+    }
+    while (m_fileNameIndex + 1 < fileNames.GetSize() && fileNames[m_fileNameIndex + 1].firstToken <= tokenIndex)
+    {
+        ++m_fileNameIndex;
+    }
+    m_fileName = fileNames[m_fileNameIndex].fileName;
+}
+
+int HLSLTokenizer::PeekToken(int offset) const
+{
+    if (m_tokenBuffer == NULL)
+    {
+        ASSERT(offset == 0);
+        return m_token;
+    }
+    int tokenIndex = m_tokenIndex + offset;
+    int lastToken  = m_tokenBuffer->GetNumTokens() - 1;
+    if (tokenIndex > lastToken)
+    {
+        tokenIndex = lastToken;
+    }
+    return m_tokenBuffer->m_token[tokenIndex];
+}
+
+int HLSLTokenizer::GetTokenIndex() const
+{
+    ASSERT(m_tokenBuffer != NULL);
+    return m_tokenIndex;
+}
+
+void HLSLTokenizer::SetTokenIndex(int tokenIndex)
+{
+    ASSERT(m_tokenBuffer != NULL);
+    ASSERT(tokenIndex >= 0 && tokenIndex < m_tokenBuffer->GetNumTokens());
+    LoadToken(tokenIndex);
+}
+
 int HLSLTokenizer::GetToken() const
 {
     return m_token;
@@ -459,9 +1014,18 @@ int HLSLTokenizer::GetInt() const
     return m_iValue;
 }
 
-const char* HLSLTokenizer::GetIdentifier() const
+HLSLTokenSpan HLSLTokenizer::GetSpan() const
+{
+    HLSLTokenSpan span;
+    span.offset = static_cast<int>(m_tokenStart - m_bufferStart);
+    span.length = static_cast<int>(m_buffer - m_tokenStart);
+    span.line   = m_tokenLineNumber;
+    return span;
+}
+
+const char* HLSLTokenizer::GetSpanText(const HLSLTokenSpan& span) const
 {
-    return m_identifier;
+    return m_bufferStart + span.offset;
 }
 
 int HLSLTokenizer::GetLineNumber() const
@@ -507,7 +1071,13 @@ void HLSLTokenizer::GetTokenName(char buffer[s_maxIdentifier]) const
     }
     else if (m_token == HLSLToken_Identifier)
     {
-        strcpy(buffer, m_identifier);
+        size_t length = m_buffer - m_tokenStart;
+        if (length > s_maxIdentifier - 1)
+        {
+            length = s_maxIdentifier - 1;
+        }
+        memcpy(buffer, m_tokenStart, length);
+        buffer[length] = 0;
     }
     else
     {
@@ -1,6 +1,11 @@
 #ifndef HLSL_TOKENIZER_H
 #define HLSL_TOKENIZER_H
 
+#include "Engine/Array.h"
+#include "Engine/StringPool.h"
+
+#include <stddef.h>
+
 namespace M4
 {
 
@@ -80,20 +85,92 @@ enum HLSLToken
     HLSLToken_EndOfStream,
 };
 
+/** Location of a token in the buffer passed to the tokenizer. */
+struct HLSLTokenSpan
+{
+    int                 offset;     // Offset of the first character from the start of the buffer.
+    int                 length;     // Number of characters in the token.
+    int                 line;       // Line number where the token began.
+};
+
+/**
+ * Storage for all of the tokens in a buffer, filled in by HLSLTokenizer::Tokenize.
+ * The tokens are stored as a structure of arrays so that walking them is a
+ * sequential read of a few small arrays.
+ */
+class HLSLTokenBuffer
+{
+
+public:
+
+    explicit HLSLTokenBuffer(Allocator* allocator);
+
+    /** Returns the number of tokens, including the final end of stream token. */
+    int GetNumTokens() const;
+
+private:
+
+    friend class HLSLTokenizer;
+
+    union Value
+    {
+        float           fValue;
+        int             iValue;
+    };
+
+    /** Records the file name in effect starting at a token (from #line directives). */
+    struct FileName
+    {
+        int             firstToken;
+        const char*     fileName;
+    };
+
+    Array<unsigned short>   m_token;
+    Array<int>              m_offset;
+    Array<int>              m_length;
+    Array<int>              m_line;
+    Array<Value>            m_value;
+    Array<FileName>         m_fileName;
+    StringPool              m_stringPool;
+
+};
+
 class HLSLTokenizer
 {
 
 public:
 
-    /// Maximum string length of an identifier.
+    /// Maximum string length of a token name or #line file name. Identifiers
+    /// themselves are not limited in length, but are truncated by GetTokenName.
     static const int s_maxIdentifier = 255 + 1;
 
+    /// Maximum number of significant digits kept for a numeric literal.
+    static const int s_maxNumberDigits = 128;
+
     /** The file name is only used for error reporting. */
     HLSLTokenizer(const char* fileName, const char* buffer, size_t length);
 
     /** Advances to the next token in the stream. */
     void Next();
 
+    /**
+     * Scans all of the remaining tokens into the token buffer. Afterwards the
+     * tokenizer walks the stored tokens instead of scanning the source, which
+     * allows look ahead with PeekToken and backtracking with SetTokenIndex. The
+     * buffer must remain valid for the lifetime of the tokenizer. Returns false
+     * if there was an error.
+     */
+    bool Tokenize(HLSLTokenBuffer* tokenBuffer);
+
+    /** Returns the token the specified number of tokens ahead of the current one.
+    Only an offset of 0 is supported unless the source has been tokenized. */
+    int PeekToken(int offset) const;
+
+    /** Gets or sets the index of the current token for backtracking. Only
+    supported once the source has been tokenized. */
+    int  GetTokenIndex() const;
+    void SetTokenIndex(int tokenIndex);
+
     /** Returns the current token in the stream. */
     int GetToken() const;
 
@@ -101,8 +178,12 @@ public:
     float GetFloat() const;
     int   GetInt() const;
 
-    /** Returns the identifier for the current token. */
-    const char* GetIdentifier() const;
+    /** Returns the location of the current token in the buffer. */
+    HLSLTokenSpan GetSpan() const;
+
+    /** Returns the characters for a span in the buffer. The text is not null
+    terminated; the length is given by the span. */
+    const char* GetSpanText(const HLSLTokenSpan& span) const;
 
     /** Returns the line number where the current token began. */
     int GetLineNumber() const;
@@ -124,12 +205,16 @@ private:
 
     bool SkipWhitespace();
     bool SkipComment();
+    void SkipLineCommentBody();
+    void SkipBlockCommentBody();
     bool ScanNumber();
     bool ScanLineDirective();
+    void LoadToken(int tokenIndex);
 
 private:
 
     const char*         m_fileName;
+    const char*         m_bufferStart;
     const char*         m_buffer;
     const char*         m_bufferEnd;
     int                 m_lineNumber;
@@ -138,9 +223,14 @@ private:
     int                 m_token;
     float               m_fValue;
     int                 m_iValue;
-    char                m_identifier[s_maxIdentifier];
+    const char*         m_tokenStart;
     char                m_lineDirectiveFileName[s_maxIdentifier];
     int                 m_tokenLineNumber;
+    int                 m_fileNameChanges;
+
+    HLSLTokenBuffer*    m_tokenBuffer;      // Non-NULL once the source has been tokenized.
+    int                 m_tokenIndex;
+    int                 m_fileNameIndex;
 
 };
 
@@ -6,15 +6,26 @@
 namespace M4
 {
 
-HLSLTree::HLSLTree(Allocator* allocator) :
+HLSLTree::HLSLTree(Allocator* allocator, size_t initialCapacity) :
     m_allocator(allocator), m_stringPool(allocator)
 {
-    m_firstPage         = m_allocator->New<NodePage>();
-    m_firstPage->next   = NULL;
-
-    m_currentPage       = m_firstPage;
+    m_firstPage         = NULL;
+    m_currentPage       = NULL;
     m_currentPageOffset = 0;
 
+    m_numPages          = 0;
+    m_bytesReserved     = 0;
+    m_bytesUsed         = 0;
+    m_bytesWasted       = 0;
+    m_frozen            = false;
+
+    for (int i = 0; i < HLSLNodeType_Count; ++i)
+    {
+        m_numNodes[i] = 0;
+    }
+
+    AllocatePage(initialCapacity);
+
     m_root              = AddNode<HLSLRoot>(NULL, 1);
 }
 
@@ -24,43 +35,148 @@ HLSLTree::~HLSLTree()
     while (page != NULL)
     {
         NodePage* next = page->next;
-        m_allocator->Delete(page);
+        m_allocator->Free(page, s_pageHeaderSize + page->size);
         page = next;
     }
 }
 
-void HLSLTree::AllocatePage()
+size_t HLSLTree::GetCapacityEstimate(size_t sourceLength)
+{
+    // Typical shaders use 10 to 20 bytes of nodes per byte of source code. This
+    // errs on the low side since comments don't produce any nodes, and the pages
+    // grow quickly if it isn't enough.
+    size_t capacity = sourceLength * 8;
+    if (capacity < s_defaultPageSize)
+    {
+        return s_defaultPageSize;
+    }
+    return capacity;
+}
+
+HLSLTreeMemoryStats HLSLTree::GetMemoryStats() const
+{
+    HLSLTreeMemoryStats stats;
+    stats.numPages      = m_numPages;
+    stats.bytesReserved = m_bytesReserved;
+    stats.bytesUsed     = m_bytesUsed;
+    stats.bytesWasted   = m_bytesWasted;
+    return stats;
+}
+
+int HLSLTree::GetNumNodes(HLSLNodeType nodeType) const
 {
-    NodePage* newPage    = m_allocator->New<NodePage>();
-    newPage->next        = NULL;
-    m_currentPage->next  = newPage;
-    m_currentPageOffset  = 0;
-    m_currentPage        = newPage;
+    return m_numNodes[nodeType];
+}
+
+int HLSLTree::GetNumStrings() const
+{
+    return m_stringPool.GetNumStrings();
+}
+
+void HLSLTree::AllocatePage(size_t minSize)
+{
+    // Grow the pages geometrically so that large shaders need few of them.
+    size_t size = s_defaultPageSize;
+    if (m_currentPage != NULL)
+    {
+        size = m_currentPage->size * 2;
+        if (size > s_maxPageSize)
+        {
+            size = s_maxPageSize;
+        }
+    }
+    if (size < minSize)
+    {
+        size = minSize;
+    }
+
+    NodePage* newPage = static_cast<NodePage*>(m_allocator->Allocate(s_pageHeaderSize + size, Allocator::s_defaultAlignment));
+    newPage->next     = NULL;
+    newPage->size     = size;
+
+    if (m_currentPage != NULL)
+    {
+        m_bytesWasted      += m_currentPage->size - m_currentPageOffset;
+        m_currentPage->next = newPage;
+    }
+    else
+    {
+        m_firstPage = newPage;
+    }
+    m_currentPage       = newPage;
+    m_currentPageOffset = 0;
+
+    ++m_numPages;
+    m_bytesReserved += size;
 }
 
 const char* HLSLTree::AddString(const char* string)
-{   
+{
+    ASSERT(!m_frozen);
     return m_stringPool.AddString(string);
 }
 
+const char* HLSLTree::AddString(const char* string, size_t length)
+{
+    ASSERT(!m_frozen);
+    return m_stringPool.AddString(string, length);
+}
+
+const char* HLSLTree::AddString(const char* string, size_t length, unsigned int hash)
+{
+    ASSERT(!m_frozen);
+    return m_stringPool.AddString(string, length, hash);
+}
+
 bool HLSLTree::GetContainsString(const char* string) const
 {
     return m_stringPool.GetContainsString(string);
 }
 
+bool HLSLTree::GetContainsString(const char* string, size_t length) const
+{
+    return m_stringPool.GetContainsString(string, length);
+}
+
+bool HLSLTree::GetContainsString(const char* string, size_t length, unsigned int hash) const
+{
+    return m_stringPool.GetContainsString(string, length, hash);
+}
+
 HLSLRoot* HLSLTree::GetRoot() const
 {
     return m_root;
 }
 
-void* HLSLTree::AllocateMemory(size_t size)
+void HLSLTree::Freeze()
+{
+    m_frozen = true;
+}
+
+bool HLSLTree::GetIsFrozen() const
 {
-    if (m_currentPageOffset + size > s_nodePageSize)
+    return m_frozen;
+}
+
+void* HLSLTree::AllocateMemory(size_t size, size_t alignment)
+{
+    // The page data starts at a multiple of the default alignment, so aligning the
+    // offset aligns the address.
+    ASSERT(!m_frozen);
+    ASSERT(alignment <= Allocator::s_defaultAlignment);
+
+    size_t offset = (m_currentPageOffset + alignment - 1) & ~(alignment - 1);
+    if (offset + size > m_currentPage->size)
     {
-        AllocatePage();
+        AllocatePage(size);
+        offset = 0;
     }
-    void* buffer = m_currentPage->buffer + m_currentPageOffset;
-    m_currentPageOffset += size;
+
+    m_bytesWasted += offset - m_currentPageOffset;
+    m_bytesUsed   += size;
+
+    void* buffer = reinterpret_cast<char*>(m_currentPage) + s_pageHeaderSize + offset;
+    m_currentPageOffset = offset + size;
     return buffer;
 }
 
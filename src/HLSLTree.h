@@ -1,8 +1,11 @@
 #ifndef HLSL_TREE_H
 #define HLSL_TREE_H
 
+#include "Engine/Allocator.h"
 #include "Engine/StringPool.h"
 
+#include <new>
+
 namespace M4
 {
 
@@ -34,6 +37,7 @@ enum HLSLNodeType
     HLSLNodeType_MemberAccess,
     HLSLNodeType_ArrayAccess,
     HLSLNodeType_FunctionCall,
+    HLSLNodeType_Count
 };
 
 enum HLSLBaseType
@@ -487,6 +491,15 @@ struct HLSLFunctionCall : public HLSLExpression
     HLSLExpression*     argument;
 };
 
+/** Memory used by the nodes of a tree. */
+struct HLSLTreeMemoryStats
+{
+    int     numPages;
+    size_t  bytesReserved;      // Total size of the pages.
+    size_t  bytesUsed;          // Bytes used by nodes.
+    size_t  bytesWasted;        // Alignment padding and unused space at the end of full pages.
+};
+
 /**
  * Abstract syntax tree for parsed HLSL code.
  */
@@ -495,52 +508,94 @@ class HLSLTree
 
 public:
 
-    explicit HLSLTree(Allocator* allocator);
+    static const size_t s_defaultPageSize = 1024 * 4;
+
+    /** The initial capacity is the size of the first node page. Subsequent pages
+    double in size, so a good estimate avoids allocating many small pages. */
+    explicit HLSLTree(Allocator* allocator, size_t initialCapacity = s_defaultPageSize);
     ~HLSLTree();
 
+    /** Returns an estimate of the node memory needed for source code of the
+    specified length, for use as the initial capacity. */
+    static size_t GetCapacityEstimate(size_t sourceLength);
+
+    /** Returns the memory used by the nodes. */
+    HLSLTreeMemoryStats GetMemoryStats() const;
+
+    /** Returns the number of nodes of the specified type. */
+    int GetNumNodes(HLSLNodeType nodeType) const;
+
+    /** Returns the number of strings in the string pool. */
+    int GetNumStrings() const;
+
     /** Adds a string to the string pool used by the tree. */
     const char* AddString(const char* string);
+    const char* AddString(const char* string, size_t length);
+    const char* AddString(const char* string, size_t length, unsigned int hash);
 
     /** Returns true if the string is contained within the tree. */
     bool GetContainsString(const char* string) const;
+    bool GetContainsString(const char* string, size_t length) const;
+    bool GetContainsString(const char* string, size_t length, unsigned int hash) const;
 
     /** Returns the root block in the tree */
     HLSLRoot* GetRoot() const;
 
+    /**
+     * Marks the tree as complete; no more nodes or strings can be added. A frozen
+     * tree is only read, so code for any number of entry points and targets can be
+     * generated from it, including by several threads at once.
+     */
+    void Freeze();
+    bool GetIsFrozen() const;
+
     /** Adds a new node to the tree with the specified type. */
     template <class T>
     T* AddNode(const char* fileName, int line)
     {
-        HLSLNode* node = new (AllocateMemory(sizeof(T))) T();
+        HLSLNode* node = new (AllocateMemory(sizeof(T), AlignOf<T>::value)) T();
         node->nodeType  = T::s_type;
         node->fileName  = fileName;
         node->line      = line;
+        ++m_numNodes[T::s_type];
         return static_cast<T*>(node);
     }
 
 private:
 
-    void* AllocateMemory(size_t size);
-    void  AllocatePage();
+    void* AllocateMemory(size_t size, size_t alignment);
+    void  AllocatePage(size_t minSize);
 
 private:
 
-    static const size_t s_nodePageSize = 1024 * 4;
+    static const size_t s_maxPageSize = 1024 * 256;
 
+    /** Header at the start of each page, followed by the nodes. */
     struct NodePage
     {
         NodePage*   next;
-        char        buffer[s_nodePageSize];
+        size_t      size;
     };
 
+    // Padded so that the node data is aligned for any node type.
+    static const size_t s_pageHeaderSize = (sizeof(NodePage) + Allocator::s_defaultAlignment - 1) & ~(Allocator::s_defaultAlignment - 1);
+
     Allocator*      m_allocator;
     StringPool      m_stringPool;
     HLSLRoot*       m_root;
+    bool            m_frozen;
 
     NodePage*       m_firstPage;
     NodePage*       m_currentPage;
     size_t          m_currentPageOffset;
 
+    int             m_numPages;
+    size_t          m_bytesReserved;
+    size_t          m_bytesUsed;
+    size_t          m_bytesWasted;
+
+    int             m_numNodes[HLSLNodeType_Count];
+
 };
 
 }
@@ -0,0 +1,281 @@
+#ifndef HLSL_TREE_ACCESSOR_H
+#define HLSL_TREE_ACCESSOR_H
+
+#include "HLSLCompactTree.h"
+#include "HLSLTree.h"
+
+#include <string.h>
+
+namespace M4
+{
+
+/**
+ * Read only access to the nodes of an HLSLTree, with the same interface as
+ * HLSLCompactTreeAccessor so that the generators can walk either layout.
+ *
+ * A Node refers to a node, and is false for no node. The accessors are named
+ * after the node type they read, since the fields are in different places in
+ * each type; the caller checks the node type first. Intrinsic functions and
+ * their arguments aren't part of the tree and don't have their node type set,
+ * so they're only reached through GetCalledFunction.
+ */
+class HLSLTreeAccessor
+{
+
+public:
+
+    typedef const HLSLNode*     Node;
+    typedef HLSLType            Type;
+
+    explicit HLSLTreeAccessor(const HLSLTree* tree) : m_tree(tree) { }
+
+    bool GetContainsString(const char* string) const    { return m_tree->GetContainsString(string); }
+
+    HLSLNodeType GetNodeType(Node node) const           { return node->nodeType; }
+    const char* GetFileName(Node node) const            { return node->fileName; }
+    int GetLine(Node node) const                        { return node->line; }
+
+    Node GetNextStatement(Node node) const              { return static_cast<const HLSLStatement*>(node)->nextStatement; }
+    Node GetNextExpression(Node node) const             { return Expression(node)->nextExpression; }
+    Node GetNextStructField(Node node) const            { return static_cast<const HLSLStructField*>(node)->nextField; }
+    Node GetNextBufferField(Node node) const            { return static_cast<const HLSLBufferField*>(node)->nextField; }
+    Node GetNextArgument(Node node) const               { return static_cast<const HLSLArgument*>(node)->nextArgument; }
+
+    Node GetRootStatements() const                      { return m_tree->GetRoot()->statement; }
+
+    const char* GetDeclarationName(Node node) const     { return Declaration(node)->name; }
+    const Type& GetDeclarationType(Node node) const     { return Declaration(node)->type; }
+    const char* GetDeclarationRegister(Node node) const { return Declaration(node)->registerName; }
+    Node GetDeclarationAssignment(Node node) const      { return Declaration(node)->assignment; }
+
+    const char* GetStructName(Node node) const          { return static_cast<const HLSLStruct*>(node)->name; }
+    Node GetStructFields(Node node) const               { return static_cast<const HLSLStruct*>(node)->field; }
+
+    const char* GetStructFieldName(Node node) const     { return static_cast<const HLSLStructField*>(node)->name; }
+    const Type& GetStructFieldType(Node node) const     { return static_cast<const HLSLStructField*>(node)->type; }
+    const char* GetStructFieldSemantic(Node node) const { return static_cast<const HLSLStructField*>(node)->semantic; }
+
+    const char* GetBufferName(Node node) const          { return static_cast<const HLSLBuffer*>(node)->name; }
+    const char* GetBufferRegister(Node node) const      { return static_cast<const HLSLBuffer*>(node)->registerName; }
+    Node GetBufferFields(Node node) const               { return static_cast<const HLSLBuffer*>(node)->field; }
+
+    const char* GetBufferFieldName(Node node) const     { return static_cast<const HLSLBufferField*>(node)->name; }
+    const Type& GetBufferFieldType(Node node) const     { return static_cast<const HLSLBufferField*>(node)->type; }
+
+    const char* GetFunctionName(Node node) const        { return Function(node)->name; }
+    const Type& GetFunctionReturnType(Node node) const  { return Function(node)->returnType; }
+    const char* GetFunctionSemantic(Node node) const    { return Function(node)->semantic; }
+    Node GetFunctionArguments(Node node) const          { return Function(node)->argument; }
+    Node GetFunctionStatements(Node node) const         { return Function(node)->statement; }
+
+    const char* GetArgumentName(Node node) const        { return Argument(node)->name; }
+    HLSLArgumentModifier GetArgumentModifier(Node node) const { return Argument(node)->modifier; }
+    const Type& GetArgumentType(Node node) const        { return Argument(node)->type; }
+    const char* GetArgumentSemantic(Node node) const    { return Argument(node)->semantic; }
+
+    Node GetExpressionStatementExpression(Node node) const { return static_cast<const HLSLExpressionStatement*>(node)->expression; }
+    Node GetReturnExpression(Node node) const           { return static_cast<const HLSLReturnStatement*>(node)->expression; }
+
+    Node GetIfCondition(Node node) const                { return static_cast<const HLSLIfStatement*>(node)->condition; }
+    Node GetIfStatements(Node node) const               { return static_cast<const HLSLIfStatement*>(node)->statement; }
+    Node GetElseStatements(Node node) const             { return static_cast<const HLSLIfStatement*>(node)->elseStatement; }
+
+    Node GetForInitialization(Node node) const          { return static_cast<const HLSLForStatement*>(node)->initialization; }
+    Node GetForCondition(Node node) const               { return static_cast<const HLSLForStatement*>(node)->condition; }
+    Node GetForIncrement(Node node) const               { return static_cast<const HLSLForStatement*>(node)->increment; }
+    Node GetForStatements(Node node) const              { return static_cast<const HLSLForStatement*>(node)->statement; }
+
+    const Type& GetExpressionType(Node node) const      { return Expression(node)->expressionType; }
+
+    HLSLUnaryOp GetUnaryOp(Node node) const             { return static_cast<const HLSLUnaryExpression*>(node)->unaryOp; }
+    Node GetUnaryOperand(Node node) const               { return static_cast<const HLSLUnaryExpression*>(node)->expression; }
+
+    HLSLBinaryOp GetBinaryOp(Node node) const           { return static_cast<const HLSLBinaryExpression*>(node)->binaryOp; }
+    Node GetBinaryOperand1(Node node) const             { return static_cast<const HLSLBinaryExpression*>(node)->expression1; }
+    Node GetBinaryOperand2(Node node) const             { return static_cast<const HLSLBinaryExpression*>(node)->expression2; }
+
+    Node GetConditionalCondition(Node node) const       { return static_cast<const HLSLConditionalExpression*>(node)->condition; }
+    Node GetConditionalTrue(Node node) const            { return static_cast<const HLSLConditionalExpression*>(node)->trueExpression; }
+    Node GetConditionalFalse(Node node) const           { return static_cast<const HLSLConditionalExpression*>(node)->falseExpression; }
+
+    const Type& GetCastType(Node node) const            { return static_cast<const HLSLCastingExpression*>(node)->type; }
+    Node GetCastOperand(Node node) const                { return static_cast<const HLSLCastingExpression*>(node)->expression; }
+
+    HLSLBaseType GetLiteralType(Node node) const        { return Literal(node)->type; }
+    float GetLiteralFloat(Node node) const              { return Literal(node)->fValue; }
+    int GetLiteralInt(Node node) const                  { return Literal(node)->iValue; }
+    bool GetLiteralBool(Node node) const                { return Literal(node)->bValue; }
+
+    const char* GetIdentifierName(Node node) const      { return static_cast<const HLSLIdentifierExpression*>(node)->name; }
+    bool GetIdentifierGlobal(Node node) const           { return static_cast<const HLSLIdentifierExpression*>(node)->global; }
+
+    const Type& GetConstructorType(Node node) const     { return static_cast<const HLSLConstructorExpression*>(node)->type; }
+    Node GetConstructorArguments(Node node) const       { return static_cast<const HLSLConstructorExpression*>(node)->argument; }
+
+    Node GetMemberObject(Node node) const               { return static_cast<const HLSLMemberAccess*>(node)->object; }
+    const char* GetMemberField(Node node) const         { return static_cast<const HLSLMemberAccess*>(node)->field; }
+
+    Node GetArrayAccessArray(Node node) const           { return static_cast<const HLSLArrayAccess*>(node)->array; }
+    Node GetArrayAccessIndex(Node node) const           { return static_cast<const HLSLArrayAccess*>(node)->index; }
+
+    Node GetCalledFunction(Node node) const             { return static_cast<const HLSLFunctionCall*>(node)->function; }
+    Node GetCallArguments(Node node) const              { return static_cast<const HLSLFunctionCall*>(node)->argument; }
+
+private:
+
+    static const HLSLDeclaration* Declaration(Node node){ return static_cast<const HLSLDeclaration*>(node); }
+    static const HLSLFunction* Function(Node node)      { return static_cast<const HLSLFunction*>(node); }
+    static const HLSLArgument* Argument(Node node)      { return static_cast<const HLSLArgument*>(node); }
+    static const HLSLExpression* Expression(Node node)  { return static_cast<const HLSLExpression*>(node); }
+    static const HLSLLiteralExpression* Literal(Node node) { return static_cast<const HLSLLiteralExpression*>(node); }
+
+    const HLSLTree*     m_tree;
+
+};
+
+/**
+ * Read only access to the nodes of an HLSLCompactTree, with the same interface
+ * as HLSLTreeAccessor. A Node is a node index, and a Type is built from the
+ * interned type with its name looked up.
+ */
+class HLSLCompactTreeAccessor
+{
+
+public:
+
+    typedef HLSLNodeIndex       Node;
+
+    struct Type
+    {
+        explicit Type(HLSLBaseType _baseType = HLSLBaseType_Unknown)
+        {
+            baseType    = _baseType;
+            typeName    = NULL;
+            array       = false;
+            arraySize   = 0;
+            constant    = false;
+        }
+        HLSLBaseType        baseType;
+        const char*         typeName;
+        bool                array;
+        Node                arraySize;
+        bool                constant;
+    };
+
+    explicit HLSLCompactTreeAccessor(const HLSLCompactTree* tree) : m_tree(tree) { }
+
+    bool GetContainsString(const char* string) const    { return m_tree->GetContainsString(string); }
+
+    HLSLNodeType GetNodeType(Node node) const           { return static_cast<HLSLNodeType>(Get(node).nodeType); }
+    const char* GetFileName(Node node) const            { return m_tree->GetFileName(Get(node)); }
+    int GetLine(Node node) const                        { return Get(node).line; }
+
+    Node GetNextStatement(Node node) const              { return Get(node).next; }
+    Node GetNextExpression(Node node) const             { return Get(node).next; }
+    Node GetNextStructField(Node node) const            { return Get(node).next; }
+    Node GetNextBufferField(Node node) const            { return Get(node).next; }
+    Node GetNextArgument(Node node) const               { return Get(node).next; }
+
+    Node GetRootStatements() const                      { return Get(m_tree->GetRoot()).operand[0]; }
+
+    const char* GetDeclarationName(Node node) const     { return String(node, 0); }
+    Type GetDeclarationType(Node node) const            { return GetType(Get(node).type); }
+    const char* GetDeclarationRegister(Node node) const { return String(node, 1); }
+    Node GetDeclarationAssignment(Node node) const      { return Get(node).operand[3]; }
+
+    const char* GetStructName(Node node) const          { return String(node, 0); }
+    Node GetStructFields(Node node) const               { return Get(node).operand[1]; }
+
+    const char* GetStructFieldName(Node node) const     { return String(node, 0); }
+    Type GetStructFieldType(Node node) const            { return GetType(Get(node).type); }
+    const char* GetStructFieldSemantic(Node node) const { return String(node, 1); }
+
+    const char* GetBufferName(Node node) const          { return String(node, 0); }
+    const char* GetBufferRegister(Node node) const      { return String(node, 1); }
+    Node GetBufferFields(Node node) const               { return Get(node).operand[2]; }
+
+    const char* GetBufferFieldName(Node node) const     { return String(node, 0); }
+    Type GetBufferFieldType(Node node) const            { return GetType(Get(node).type); }
+
+    const char* GetFunctionName(Node node) const        { return String(node, 0); }
+    Type GetFunctionReturnType(Node node) const         { return GetType(Get(node).type); }
+    const char* GetFunctionSemantic(Node node) const    { return String(node, 1); }
+    Node GetFunctionArguments(Node node) const          { return Get(node).operand[2]; }
+    Node GetFunctionStatements(Node node) const         { return Get(node).operand[3]; }
+
+    const char* GetArgumentName(Node node) const        { return String(node, 0); }
+    HLSLArgumentModifier GetArgumentModifier(Node node) const { return static_cast<HLSLArgumentModifier>(Get(node).operand[1]); }
+    Type GetArgumentType(Node node) const               { return GetType(Get(node).type); }
+    const char* GetArgumentSemantic(Node node) const    { return String(node, 2); }
+
+    Node GetExpressionStatementExpression(Node node) const { return Get(node).operand[0]; }
+    Node GetReturnExpression(Node node) const           { return Get(node).operand[0]; }
+
+    Node GetIfCondition(Node node) const                { return Get(node).operand[0]; }
+    Node GetIfStatements(Node node) const               { return Get(node).operand[1]; }
+    Node GetElseStatements(Node node) const             { return Get(node).operand[2]; }
+
+    Node GetForInitialization(Node node) const          { return Get(node).operand[0]; }
+    Node GetForCondition(Node node) const               { return Get(node).operand[1]; }
+    Node GetForIncrement(Node node) const               { return Get(node).operand[2]; }
+    Node GetForStatements(Node node) const              { return Get(node).operand[3]; }
+
+    Type GetExpressionType(Node node) const             { return GetType(Get(node).type); }
+
+    HLSLUnaryOp GetUnaryOp(Node node) const             { return static_cast<HLSLUnaryOp>(Get(node).operand[0]); }
+    Node GetUnaryOperand(Node node) const               { return Get(node).operand[1]; }
+
+    HLSLBinaryOp GetBinaryOp(Node node) const           { return static_cast<HLSLBinaryOp>(Get(node).operand[0]); }
+    Node GetBinaryOperand1(Node node) const             { return Get(node).operand[1]; }
+    Node GetBinaryOperand2(Node node) const             { return Get(node).operand[2]; }
+
+    Node GetConditionalCondition(Node node) const       { return Get(node).operand[0]; }
+    Node GetConditionalTrue(Node node) const            { return Get(node).operand[1]; }
+    Node GetConditionalFalse(Node node) const           { return Get(node).operand[2]; }
+
+    Type GetCastType(Node node) const                   { return GetType(Get(node).operand[0]); }
+    Node GetCastOperand(Node node) const                { return Get(node).operand[1]; }
+
+    HLSLBaseType GetLiteralType(Node node) const        { return static_cast<HLSLBaseType>(Get(node).operand[0]); }
+    float GetLiteralFloat(Node node) const              { float value; memcpy(&value, &Get(node).operand[1], sizeof(value)); return value; }
+    int GetLiteralInt(Node node) const                  { return static_cast<int>(Get(node).operand[1]); }
+    bool GetLiteralBool(Node node) const                { return Get(node).operand[1] != 0; }
+
+    const char* GetIdentifierName(Node node) const      { return String(node, 0); }
+    bool GetIdentifierGlobal(Node node) const           { return Get(node).operand[1] != 0; }
+
+    Type GetConstructorType(Node node) const            { return GetType(Get(node).operand[0]); }
+    Node GetConstructorArguments(Node node) const       { return Get(node).operand[1]; }
+
+    Node GetMemberObject(Node node) const               { return Get(node).operand[0]; }
+    const char* GetMemberField(Node node) const         { return String(node, 1); }
+
+    Node GetArrayAccessArray(Node node) const           { return Get(node).operand[0]; }
+    Node GetArrayAccessIndex(Node node) const           { return Get(node).operand[1]; }
+
+    Node GetCalledFunction(Node node) const             { return Get(node).operand[0]; }
+    Node GetCallArguments(Node node) const              { return Get(node).operand[2]; }
+
+private:
+
+    const HLSLCompactNode& Get(Node node) const         { return m_tree->GetNode(node); }
+    const char* String(Node node, int operand) const    { return m_tree->GetString(Get(node).operand[operand]); }
+
+    Type GetType(HLSLTypeId typeId) const
+    {
+        const HLSLCompactType& compact = m_tree->GetType(typeId);
+        Type type(compact.baseType);
+        type.typeName   = m_tree->GetString(compact.typeName);
+        type.array      = compact.array;
+        type.arraySize  = compact.arraySize;
+        type.constant   = compact.constant;
+        return type;
+    }
+
+    const HLSLCompactTree*  m_tree;
+
+};
+
+}
+
+#endif
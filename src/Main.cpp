@@ -1,36 +1,54 @@
 #include "Engine/Allocator.h"
+#include "Engine/File.h"
 #include "Engine/Log.h"
 #include "Engine/String.h"
+#include "Engine/Trace.h"
 
+#include "BatchCompiler.h"
 #include "HLSLParser.h"
 #include "GLSLGenerator.h"
+#include "HLSLInstrumentation.h"
+#include "TranslationCache.h"
 
-#include <fstream>
-#include <sstream>
 #include <iostream>
-
-std::string ReadFile(const char* fileName)
-{
-    std::ifstream ifs(fileName);
-    std::stringstream buffer;
-    buffer << ifs.rdbuf();
-    return buffer.str();
-}
+#include <stdlib.h>
 
 void PrintUsage()
 {
-    std::cerr << "usage: hlslparser [-h] [-fs | -vs] FILENAME ENTRYNAME\n"
+    std::cerr << "usage: hlslparser [-h] [-fs | -vs] [-cache DIRECTORY] [--stats] [-trace TRACE] FILENAME ENTRYNAME\n"
+              << "       hlslparser [-h] [-j THREADS] [-trace TRACE] -batch MANIFEST\n"
               << "\n"
               << "Translate HLSL shader to GLSL shader.\n"
               << "\n"
               << "positional arguments:\n"
-              << " FILENAME    input file name\n"
+              << " FILENAME    input file name, or - to read standard input\n"
               << " ENTRYNAME   entry point of the shader\n"
               << "\n"
               << "optional arguments:\n"
               << " -h, --help  show this help message and exit\n"
               << " -fs         generate fragment shader (default)\n"
-              << " -vs         generate vertex shader\n";
+              << " -vs         generate vertex shader\n"
+              << " -cache      reuse the output of identical earlier translations stored in\n"
+              << "             DIRECTORY, and store the output there\n"
+              << " --stats     print the time spent in each phase, counts and memory use\n"
+              << "             to stderr\n"
+              << " -trace      write a timeline of the reads, parses and translations to TRACE\n"
+              << "             in the Chrome trace format, viewable in chrome://tracing or\n"
+              << "             Perfetto\n"
+              << " -batch      translate each job listed in MANIFEST, one per line as:\n"
+              << "             [-fs | -vs] FILENAME ENTRYNAME OUTPUTNAME\n"
+              << " -j          number of threads for -batch (default one per processor)\n";
+}
+
+/** Writes the trace if one was requested. Returns false if it couldn't be written. */
+bool SaveTrace(M4::TraceWriter* trace, const char* fileName)
+{
+    if (trace != NULL && !trace->Save(fileName))
+    {
+        M4::Log_Error("Couldn't write trace '%s'", fileName);
+        return false;
+    }
+    return true;
 }
 
 int main(int argc, char* argv[])
@@ -40,6 +58,11 @@ int main(int argc, char* argv[])
     // Parse arguments
     const char* fileName = NULL;
     const char* entryName = NULL;
+    const char* manifestName = NULL;
+    const char* cacheName = NULL;
+    const char* traceName = NULL;
+    int numThreads = 0;
+    bool printStats = false;
     GLSLGenerator::Target target = GLSLGenerator::Target_FragmentShader;
 
     for (int argn = 1; argn < argc; ++argn)
@@ -59,6 +82,26 @@ int main(int argc, char* argv[])
         {
             target = GLSLGenerator::Target_VertexShader;
         }
+        else if (String_Equal(arg, "-batch") && argn + 1 < argc)
+        {
+            manifestName = argv[++argn];
+        }
+        else if (String_Equal(arg, "-cache") && argn + 1 < argc)
+        {
+            cacheName = argv[++argn];
+        }
+        else if (String_Equal(arg, "-trace") && argn + 1 < argc)
+        {
+            traceName = argv[++argn];
+        }
+        else if (String_Equal(arg, "-stats") || String_Equal(arg, "--stats"))
+        {
+            printStats = true;
+        }
+        else if (String_Equal(arg, "-j") && argn + 1 < argc)
+        {
+            numThreads = atoi(argv[++argn]);
+        }
         else if (fileName == NULL)
         {
             fileName = arg;
@@ -75,6 +118,45 @@ int main(int argc, char* argv[])
         }
     }
 
+    // The trace has its own allocator since it's used from several threads.
+    HeapAllocator traceAllocator;
+    TraceWriter traceWriter(&traceAllocator);
+    TraceWriter* trace = NULL;
+    if (traceName != NULL)
+    {
+        trace = &traceWriter;
+        trace->SetThreadName("main");
+    }
+
+    if (manifestName != NULL)
+    {
+        if (fileName != NULL)
+        {
+            Log_Error("Too many arguments");
+            PrintUsage();
+            return 1;
+        }
+
+        HeapAllocator allocator;
+        BatchCompiler compiler(&allocator);
+        compiler.SetTrace(trace);
+        if (!compiler.LoadManifest(manifestName))
+        {
+            return 1;
+        }
+        int numFailed = compiler.Run(numThreads);
+        if (!SaveTrace(trace, traceName))
+        {
+            return 1;
+        }
+        if (numFailed > 0)
+        {
+            Log_Error("%d of %d jobs failed", numFailed, compiler.GetNumJobs());
+            return 1;
+        }
+        return 0;
+    }
+
     if (fileName == NULL || entryName == NULL)
     {
         Log_Error("Missing arguments");
@@ -82,23 +164,92 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    // Read input file
-    const std::string source = ReadFile(fileName);
+    // Read input file. It's mapped rather than copied where possible.
+    ArenaAllocator allocator;
+    FileView view;
+    bool read = false;
+    {
+        TraceScope scope(trace, "read");
+        scope.AddArg("file", fileName);
+        read = File_Map(&allocator, fileName, view);
+    }
+    if (!read)
+    {
+        Log_Error("Couldn't read '%s'", fileName);
+        return 1;
+    }
+    const char* source = view.contents;
+    size_t length = view.length;
+
+    const char* targetName = (target == GLSLGenerator::Target_VertexShader) ? "vs" : "fs";
+
+    if (cacheName != NULL)
+    {
+        TranslationCache cache(&allocator, cacheName);
+        const char* result = NULL;
+        {
+            TraceScope scope(trace, "translate");
+            scope.AddArg("file", fileName);
+            scope.AddArg("entry", entryName);
+            scope.AddArg("target", targetName);
+            result = cache.TranslateGLSL(fileName, source, length, target, entryName);
+        }
+        if (result == NULL)
+        {
+            Log_Error("Translation failed, aborting");
+            SaveTrace(trace, traceName);
+            return 1;
+        }
+        std::cout << result;
+
+        // Only a new entry can put the cache over its size limit.
+        if (cache.GetNumMisses() > 0)
+        {
+            cache.Trim();
+        }
+        return SaveTrace(trace, traceName) ? 0 : 1;
+    }
+
+    // The instrumentation is only passed in when it's wanted, since it isn't free.
+    HLSLStats stats;
+    HLSLInstrumentation* instrumentation = printStats ? &stats : NULL;
 
-    // Parse input file
-    Allocator allocator;
-    HLSLParser parser(&allocator, fileName, source.data(), source.size());
-    HLSLTree tree(&allocator);
-    if (!parser.Parse(&tree))
+    // Parse input file. With stats the source is tokenized up front, so that
+    // the tokenizer is timed separately from the parser.
+    HLSLParser parser(&allocator, fileName, source, length);
+    parser.SetInstrumentation(instrumentation);
+    HLSLTree tree(&allocator, HLSLTree::GetCapacityEstimate(length));
+    bool parsed = false;
+    {
+        TraceScope scope(trace, "parse");
+        scope.AddArg("file", fileName);
+        parsed = (!printStats || parser.Tokenize()) && parser.Parse(&tree);
+    }
+    if (!parsed)
     {
         Log_Error("Parsing failed, aborting");
+        SaveTrace(trace, traceName);
         return 1;
     }
 
     // Generate output
+    FileCodeSink sink(stdout);
     GLSLGenerator generator(&allocator);
-    generator.Generate(&tree, target, entryName);
-    std::cout << generator.GetResult();
+    generator.SetSink(&sink);
+    generator.SetInstrumentation(instrumentation);
+    {
+        TraceScope scope(trace, "generate");
+        scope.AddArg("file", fileName);
+        scope.AddArg("entry", entryName);
+        scope.AddArg("target", targetName);
+        generator.Generate(&tree, target, entryName);
+    }
+
+    if (printStats)
+    {
+        fflush(stdout);
+        stats.Print(stderr, &allocator);
+    }
 
-    return 0;
+    return SaveTrace(trace, traceName) ? 0 : 1;
 }
@@ -0,0 +1,291 @@
+#include "Engine/Allocator.h"
+#include "Engine/Array.h"
+#include "Engine/File.h"
+#include "Engine/Log.h"
+#include "Engine/String.h"
+
+#include "TranslationCache.h"
+#include "HLSLParser.h"
+#include "HLSLTree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace M4
+{
+
+// Each entry starts with a line identifying the format and giving the length
+// of the translated code which follows.
+static const char* _entryHeader = "hlslparser-cache";
+
+namespace
+{
+
+struct CacheEntry
+{
+    char        name[64];
+    uint64_t    size;
+    int64_t     modifiedTime;
+};
+
+struct CompareEntryTimes
+{
+    bool operator()(const CacheEntry& entry1, const CacheEntry& entry2) const
+    {
+        return entry1.modifiedTime < entry2.modifiedTime;
+    }
+};
+
+}
+
+static bool GetIsEntryName(const char* name)
+{
+    // Entries are named with 32 hex digits; anything else (like the temporary
+    // files written while storing) isn't ours to evict.
+    int length = 0;
+    for (; name[length] != 0; ++length)
+    {
+        char c = name[length];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+        {
+            return false;
+        }
+    }
+    return length == 32;
+}
+
+static void AddCacheEntry(const FileInfo& info, void* data)
+{
+    if (GetIsEntryName(info.name))
+    {
+        CacheEntry& entry = static_cast<Array<CacheEntry>*>(data)->PushBackNew();
+        strcpy(entry.name, info.name);
+        entry.size          = info.size;
+        entry.modifiedTime  = info.modifiedTime;
+    }
+}
+
+TranslationCache::TranslationCache(Allocator* allocator, const char* directoryName, uint64_t maxSize)
+{
+    m_allocator     = allocator;
+    m_directoryName = directoryName;
+    m_maxSize       = maxSize;
+    m_result        = NULL;
+    m_resultSize    = 0;
+    m_numHits       = 0;
+    m_numMisses     = 0;
+
+    if (!File_CreateDirectory(directoryName))
+    {
+        // Translation still works, the results just aren't stored.
+        Log_Error("Couldn't create cache directory '%s'", directoryName);
+    }
+}
+
+TranslationCache::~TranslationCache()
+{
+    SetResult(NULL, 0);
+}
+
+const char* TranslationCache::TranslateGLSL(const char* fileName, const char* source, size_t length,
+    GLSLGenerator::Target target, const char* entryName)
+{
+    char name[1024];
+    GetEntryName(GetKey(fileName, source, length, Generator_GLSL, target, entryName, false), name, sizeof(name));
+    if (Load(name))
+    {
+        return m_result;
+    }
+
+    HLSLParser parser(m_allocator, fileName, source, length);
+    HLSLTree tree(m_allocator, HLSLTree::GetCapacityEstimate(length));
+    if (!parser.Parse(&tree))
+    {
+        return NULL;
+    }
+
+    GLSLGenerator generator(m_allocator);
+    if (!generator.Generate(&tree, target, entryName))
+    {
+        return NULL;
+    }
+
+    Store(name, generator.GetResult());
+    return m_result;
+}
+
+const char* TranslationCache::TranslateHLSL(const char* fileName, const char* source, size_t length,
+    HLSLGenerator::Target target, const char* entryName, bool legacy)
+{
+    char name[1024];
+    GetEntryName(GetKey(fileName, source, length, Generator_HLSL, target, entryName, legacy), name, sizeof(name));
+    if (Load(name))
+    {
+        return m_result;
+    }
+
+    HLSLParser parser(m_allocator, fileName, source, length);
+    HLSLTree tree(m_allocator, HLSLTree::GetCapacityEstimate(length));
+    if (!parser.Parse(&tree))
+    {
+        return NULL;
+    }
+
+    HLSLGenerator generator(m_allocator);
+    if (!generator.Generate(&tree, target, entryName, legacy))
+    {
+        return NULL;
+    }
+
+    Store(name, generator.GetResult());
+    return m_result;
+}
+
+int TranslationCache::GetNumHits() const
+{
+    return m_numHits;
+}
+
+int TranslationCache::GetNumMisses() const
+{
+    return m_numMisses;
+}
+
+void TranslationCache::Trim()
+{
+    Array<CacheEntry> entries(m_allocator);
+    if (!File_ListDirectory(m_directoryName, AddCacheEntry, &entries))
+    {
+        return;
+    }
+
+    uint64_t totalSize = 0;
+    for (int i = 0; i < entries.GetSize(); ++i)
+    {
+        totalSize += entries[i].size;
+    }
+    if (totalSize <= m_maxSize)
+    {
+        return;
+    }
+
+    // Entries are touched when they're used, so the oldest were used least recently.
+    std::sort(&entries[0], &entries[0] + entries.GetSize(), CompareEntryTimes());
+
+    for (int i = 0; i < entries.GetSize() && totalSize > m_maxSize; ++i)
+    {
+        char path[1024];
+        String_Printf(path, sizeof(path), "%s/%s", m_directoryName, entries[i].name);
+        if (File_Delete(path))
+        {
+            totalSize -= entries[i].size;
+        }
+    }
+}
+
+Hash128 TranslationCache::GetKey(const char* fileName, const char* source, size_t length,
+    Generator generator, int target, const char* entryName, bool legacy) const
+{
+    // The source is hashed on its own, then combined with the rest of the key.
+    Hash128 sourceHash = Hash_Compute128(source, length);
+
+    char key[2048];
+    int keyLength = String_Printf(key, sizeof(key), "%d %d %d %d %016llx%016llx %s %s", s_version, generator, target, legacy ? 1 : 0,
+        static_cast<unsigned long long>(sourceHash.high), static_cast<unsigned long long>(sourceHash.low), entryName, fileName);
+    if (keyLength < 0 || keyLength >= static_cast<int>(sizeof(key)))
+    {
+        // Names that long are hashed separately too.
+        Hash128 nameHash = Hash_Compute128(fileName, strlen(fileName), Hash_Compute128(entryName, strlen(entryName)).low);
+        keyLength = String_Printf(key, sizeof(key), "%d %d %d %d %016llx%016llx %016llx%016llx", s_version, generator, target, legacy ? 1 : 0,
+            static_cast<unsigned long long>(sourceHash.high), static_cast<unsigned long long>(sourceHash.low),
+            static_cast<unsigned long long>(nameHash.high), static_cast<unsigned long long>(nameHash.low));
+    }
+
+    return Hash_Compute128(key, keyLength);
+}
+
+void TranslationCache::GetEntryName(const Hash128& key, char* buffer, size_t bufferSize) const
+{
+    char hash[33];
+    Hash_ToString(key, hash);
+    String_Printf(buffer, static_cast<int>(bufferSize), "%s/%s", m_directoryName, hash);
+}
+
+bool TranslationCache::Load(const char* entryName)
+{
+    size_t length = 0;
+    char* contents = File_Read(m_allocator, entryName, length);
+    if (contents == NULL)
+    {
+        ++m_numMisses;
+        return false;
+    }
+
+    // Check the header, in case the entry is from a different version or was
+    // damaged some other way.
+    bool valid = false;
+    size_t headerLength = strlen(_entryHeader);
+    if (length > headerLength && strncmp(contents, _entryHeader, headerLength) == 0 && contents[headerLength] == ' ')
+    {
+        char* end = NULL;
+        unsigned long resultLength = strtoul(contents + headerLength + 1, &end, 10);
+        if (end != NULL && *end == '\n' && static_cast<size_t>(end + 1 - contents) + resultLength == length)
+        {
+            SetResult(end + 1, resultLength);
+            valid = true;
+        }
+    }
+
+    File_Free(m_allocator, contents, length);
+
+    if (!valid)
+    {
+        ++m_numMisses;
+        return false;
+    }
+
+    // Mark the entry as recently used so that Trim keeps it.
+    File_Touch(entryName);
+    ++m_numHits;
+    return true;
+}
+
+void TranslationCache::Store(const char* entryName, const char* result)
+{
+    size_t resultLength = strlen(result);
+    SetResult(result, resultLength);
+
+    char header[64];
+    int headerLength = String_Printf(header, sizeof(header), "%s %lu\n", _entryHeader, static_cast<unsigned long>(resultLength));
+
+    size_t length = headerLength + resultLength;
+    char* contents = static_cast<char*>(m_allocator->Allocate(length, 1));
+    memcpy(contents, header, headerLength);
+    memcpy(contents + headerLength, result, resultLength);
+
+    // Failing to store isn't an error; the shader will just be translated again.
+    File_WriteAtomic(entryName, contents, length);
+
+    m_allocator->Free(contents, length);
+}
+
+void TranslationCache::SetResult(const char* result, size_t length)
+{
+    if (m_result != NULL)
+    {
+        m_allocator->Free(m_result, m_resultSize);
+        m_result     = NULL;
+        m_resultSize = 0;
+    }
+    if (result != NULL)
+    {
+        m_resultSize = length + 1;
+        m_result     = static_cast<char*>(m_allocator->Allocate(m_resultSize, 1));
+        memcpy(m_result, result, length);
+        m_result[length] = 0;
+    }
+}
+
+}
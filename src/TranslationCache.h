@@ -0,0 +1,94 @@
+#ifndef TRANSLATION_CACHE_H
+#define TRANSLATION_CACHE_H
+
+#include "Engine/Hash.h"
+
+#include "GLSLGenerator.h"
+#include "HLSLGenerator.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace M4
+{
+
+class Allocator;
+
+/**
+ * Parses and translates shaders, keeping the results in a directory so that
+ * translating the same shader again skips parsing and generation. Entries are
+ * keyed by a hash of everything which affects the output: the source, file
+ * name, generator, target, options, entry point and translator version.
+ *
+ * Only successful translations are stored; those don't produce any diagnostics,
+ * and failed translations are repeated so their errors are reported again.
+ * Entries are written atomically, so several processes can share a directory.
+ */
+class TranslationCache
+{
+
+public:
+
+    static const uint64_t s_defaultMaxSize = 256 * 1024 * 1024;
+
+    /** The directory is created if it doesn't exist. The name must remain valid
+    while the cache is used. */
+    TranslationCache(Allocator* allocator, const char* directoryName, uint64_t maxSize = s_defaultMaxSize);
+    ~TranslationCache();
+
+    /**
+     * Returns the translated code, or NULL if there was an error (which is logged).
+     * The result is valid until the next translation.
+     */
+    const char* TranslateGLSL(const char* fileName, const char* source, size_t length,
+        GLSLGenerator::Target target, const char* entryName);
+    const char* TranslateHLSL(const char* fileName, const char* source, size_t length,
+        HLSLGenerator::Target target, const char* entryName, bool legacy);
+
+    /** Number of translations found in the cache and not found. */
+    int GetNumHits() const;
+    int GetNumMisses() const;
+
+    /** Deletes the least recently used entries until the total size is under the maximum. */
+    void Trim();
+
+private:
+
+    enum Generator
+    {
+        Generator_GLSL,
+        Generator_HLSL,
+    };
+
+    /** Increment this when a change to the parser or generators changes the output. */
+    static const int s_version = 2;
+
+    Hash128 GetKey(const char* fileName, const char* source, size_t length,
+        Generator generator, int target, const char* entryName, bool legacy) const;
+    void GetEntryName(const Hash128& key, char* buffer, size_t bufferSize) const;
+
+    bool Load(const char* entryName);
+    void Store(const char* entryName, const char* result);
+    void SetResult(const char* result, size_t length);
+
+    // Not copyable.
+    TranslationCache(const TranslationCache&);
+    TranslationCache& operator=(const TranslationCache&);
+
+private:
+
+    Allocator*      m_allocator;
+    const char*     m_directoryName;
+    uint64_t        m_maxSize;
+
+    char*           m_result;
+    size_t          m_resultSize;
+
+    int             m_numHits;
+    int             m_numMisses;
+
+};
+
+}
+
+#endif